@@ -0,0 +1,220 @@
+#ifndef DASYNQ_AFFINITY_H_INCLUDED
+#define DASYNQ_AFFINITY_H_INCLUDED
+
+// Processor affinity for event loops: cpu_affinity, a set of processors (which can be built from a NUMA
+// node's processors), and loop_placement, which restricts the threads running a loop to such a set.
+
+#include <atomic>
+#include <cerrno>
+#include <system_error>
+
+#include "dasynq-config.h"
+
+#if DASYNQ_HAVE_PTHREAD_SETAFFINITY
+#include <cstdio>
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+namespace dasynq {
+
+#if DASYNQ_HAVE_PTHREAD_SETAFFINITY
+
+// A set of processors to which the threads running an event loop are restricted (see
+// event_loop(const cpu_affinity &)). A default-constructed cpu_affinity is empty, which means that threads
+// are not restricted.
+class cpu_affinity
+{
+    cpu_set_t cpus;
+
+    // Add the processors from a processor list as found in sysfs (eg "0-3,8,10-11"). Returns false if
+    // the list is malformed.
+    bool add_cpu_list(const char *list) noexcept
+    {
+        const char *p = list;
+        while (*p != 0 && *p != '\n') {
+            char *endp;
+            unsigned long first = strtoul(p, &endp, 10);
+            if (endp == p) return false;
+            unsigned long last = first;
+            p = endp;
+            if (*p == '-') {
+                last = strtoul(p + 1, &endp, 10);
+                if (endp == p + 1 || last < first) return false;
+                p = endp;
+            }
+            if (last >= CPU_SETSIZE) return false;
+            for (unsigned long cpu = first; cpu <= last; cpu++) {
+                CPU_SET(cpu, &cpus);
+            }
+            if (*p == ',') p++;
+        }
+        return true;
+    }
+
+    public:
+    cpu_affinity() noexcept
+    {
+        CPU_ZERO(&cpus);
+    }
+
+    explicit cpu_affinity(const cpu_set_t &cpus_p) noexcept : cpus(cpus_p)
+    {
+    }
+
+    // The set containing a single processor. Throws std::system_error (EINVAL) if the processor number
+    // is out of range.
+    static cpu_affinity for_cpu(unsigned cpu)
+    {
+        cpu_affinity r;
+        r.add(cpu);
+        return r;
+    }
+
+    // The set of processors belonging to a NUMA node (as listed by the kernel in
+    // /sys/devices/system/node/node<N>/cpulist). Throws std::system_error if the node does not exist
+    // or its processors can't be determined.
+    static cpu_affinity for_numa_node(unsigned node)
+    {
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", node);
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            throw std::system_error(errno, std::system_category());
+        }
+
+        char buf[1024];
+        ssize_t r = read(fd, buf, sizeof(buf) - 1);
+        int err = errno;
+        close(fd);
+        if (r == -1) {
+            throw std::system_error(err, std::system_category());
+        }
+        buf[r] = 0;
+
+        cpu_affinity result;
+        if (! result.add_cpu_list(buf) || result.empty()) {
+            throw std::system_error(EINVAL, std::system_category());
+        }
+        return result;
+    }
+
+    // Add a processor to the set. Throws std::system_error (EINVAL) if the processor number is out of
+    // range.
+    void add(unsigned cpu)
+    {
+        if (cpu >= CPU_SETSIZE) {
+            throw std::system_error(EINVAL, std::system_category());
+        }
+        CPU_SET(cpu, &cpus);
+    }
+
+    bool contains(unsigned cpu) const noexcept
+    {
+        return cpu < CPU_SETSIZE && CPU_ISSET(cpu, &cpus);
+    }
+
+    bool empty() const noexcept
+    {
+        return CPU_COUNT(&cpus) == 0;
+    }
+
+    const cpu_set_t &get_cpus() const noexcept
+    {
+        return cpus;
+    }
+
+    // Restrict the calling thread to the processors in the set (if the set is empty, do nothing).
+    // Returns 0 on success or an error number.
+    int apply_nothrow() const noexcept
+    {
+        if (empty()) return 0;
+        return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+
+    // As for apply_nothrow(), but throws std::system_error on failure.
+    void apply() const
+    {
+        int r = apply_nothrow();
+        if (r != 0) {
+            throw std::system_error(r, std::system_category());
+        }
+    }
+};
+
+#endif
+
+namespace dprivate {
+
+#if DASYNQ_HAVE_PTHREAD_SETAFFINITY
+
+// The placement of an event loop: the processors to which threads running the loop are restricted. The
+// thread constructing a loop with an affinity is restricted immediately, before the loop allocates its
+// internal structures (so that, with the usual "first touch" policy, they are allocated in memory local
+// to those processors); each thread that then runs the loop is restricted when it first does so.
+class loop_placement
+{
+    cpu_affinity affinity;
+    unsigned long id = 0; // unique id; 0 if no affinity
+
+    static unsigned long next_id() noexcept
+    {
+        static std::atomic<unsigned long> last_id {0};
+        return last_id.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    public:
+    loop_placement() noexcept
+    {
+    }
+
+    // Throws std::system_error if the calling thread can't be restricted to the processors.
+    explicit loop_placement(const cpu_affinity &affinity_p) : affinity(affinity_p)
+    {
+        if (! affinity.empty()) {
+            affinity.apply();
+            id = next_id();
+        }
+    }
+
+    const cpu_affinity &get_affinity() const noexcept
+    {
+        return affinity;
+    }
+
+    // Restrict the calling thread (about to run the loop), unless the last loop it ran (with an
+    // affinity) was this one. Failure is ignored.
+    void enter() noexcept
+    {
+        if (id == 0) return;
+        static thread_local unsigned long entered_id = 0;
+        if (entered_id != id) {
+            affinity.apply_nothrow();
+            entered_id = id;
+        }
+    }
+};
+
+#else
+
+class loop_placement
+{
+    public:
+    void enter() noexcept
+    {
+    }
+
+    DASYNQ_EMPTY_BODY
+};
+
+#endif
+
+} // namespace dprivate
+
+} // namespace dasynq
+
+#endif /* DASYNQ_AFFINITY_H_INCLUDED */
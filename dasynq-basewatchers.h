@@ -6,6 +6,10 @@
 // In general access to the members of the basewatcher should be protected by a mutex. The
 // event_dispatch lock is used for this purpose.
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <type_traits>
 
 namespace dasynq {
@@ -33,6 +37,49 @@ template <typename T_Mutex> class default_traits
     template <typename Base> using backend_t = dasynq::loop_t<Base>;
     using backend_traits_t = dasynq::loop_traits_t;
 
+    // The timer queue type: timer_queue_t (a heap, precise) or timer_wheel_queue_t<G> (a timing
+    // wheel with granularity G; O(1) timer arm/re-arm/stop).
+    using timer_queue_t = dasynq::timer_queue_t;
+
+    // The allocator used for the loop's internal data structures: the event queue, the timer queues,
+    // the child process map and (with the epoll and io_uring backends) the backend's signal and file
+    // descriptor tables. It is rebound to the required types and default-constructed as needed, so it
+    // should be stateless; an allocator which allocates from a particular NUMA node can be used to keep
+    // these structures local to the processors running the loop (see event_loop(const cpu_affinity &)).
+    using allocator_t = std::allocator<char>;
+
+    // Whether multiple threads may poll the backend for events concurrently (requires a thread-safe
+    // loop and backend support; currently epoll only). If false, only one thread polls at a time,
+    // while other threads running the loop process events already received.
+    constexpr static bool concurrent_polling = false;
+
+    // The maximum number of queued events dispatched as a batch: all the events in a batch are taken
+    // from the queue together, their callbacks are run without re-acquiring the loop's internal lock in
+    // between, and the results (re-arming etc) are then processed together. This reduces the number of
+    // times the lock is acquired (per event), but means that a callback may run even though its
+    // watcher was deregistered (or disabled) by an earlier callback in the same batch (watch_removed()
+    // is still deferred until after its callback returns). A value of 1 disables batching.
+    constexpr static int dispatch_batch = 1;
+
+    // Whether all watchers are treated as having the same priority (priorities set on watchers are
+    // ignored). Queued events are then dispatched in the order in which they were queued, and the
+    // event queue is a simple FIFO queue, which is faster than the priority queue.
+    constexpr static bool single_priority = false;
+
+    // Tasks posted to the loop (see event_loop::post) whose callable is no larger than post_inline_size
+    // bytes are stored in blocks from a pool of post_pool_size blocks, allocated when the loop is
+    // constructed, rather than being individually allocated. If the pool is exhausted, or the callable
+    // is larger, the task is allocated with operator new. A pool size of 0 disables the pool.
+    constexpr static unsigned post_pool_size = 32;
+    constexpr static std::size_t post_inline_size = 48;
+
+    // The number of events retrieved from the backend by each call (currently used by the epoll
+    // backend only, for epoll_wait). If max_event_batch is larger than event_batch, the batch size is
+    // doubled (up to max_event_batch) each time a full batch is returned, so that a large number of
+    // ready descriptors can be drained with few calls; set them equal for a fixed batch size.
+    constexpr static int event_batch = 16;
+    constexpr static int max_event_batch = 1024;
+
     // Alter the current thread signal mask using the correct function
     // (sigprocmask or pthread_sigmask):
     static void sigmaskf(int how, const sigset_t *set, sigset_t *oset)
@@ -45,6 +92,25 @@ template <typename T_Mutex> class default_traits
 template <typename T_Mutex, typename Traits = default_traits<T_Mutex>>
 class event_loop;
 
+/**
+ * Values for rearm/disarm return from event handlers
+ */
+enum class rearm
+{
+    /** Re-arm the event watcher so that it receives further events */
+    REARM,
+    /** Disarm the event watcher so that it receives no further events, until it is re-armed explicitly */
+    DISARM,
+    /** Leave in current armed/disarmed state */
+    NOOP,
+    /** Remove the event watcher (and call "removed" callback) */
+    REMOVE,
+    /** The watcher has been removed - don't touch it! */
+    REMOVED,
+    /** RE-queue the watcher to have its notification called again */
+    REQUEUE
+};
+
 inline namespace {
     constexpr int DEFAULT_PRIORITY = 50;
 }
@@ -59,9 +125,22 @@ namespace dprivate {
         DASYNQ_EMPTY_BODY
     };
 
-    // heap_def decides the queue implementation that we use. It must be stable:
-    template <typename A, typename B, typename C> using dary_heap_def = dary_heap<A,B,C>;
-    template <typename A, typename B> using heap_def = stable_heap<dary_heap_def,A,B>;
+    // heap_def decides the queue implementation that we use. It must be stable, and its handle type
+    // must not depend on the allocator. By default it is a d-ary heap, stabilised with a 32-bit
+    // sequence number (compact_stable_heap), with a fan-out of DASYNQ_EVENT_QUEUE_FANOUT; a bucket
+    // queue, which is naturally stable, can be selected via DASYNQ_BUCKET_EVENT_QUEUE:
+#if DASYNQ_BUCKET_EVENT_QUEUE
+    template <typename A, typename B, typename Allocator = std::allocator<char>>
+    using heap_def = bucket_queue<A,B,std::less<B>,Allocator>;
+#else
+    template <typename Allocator> struct dary_heap_def
+    {
+        template <typename A, typename B, typename C>
+        using heap = dary_heap<A,B,C,DASYNQ_EVENT_QUEUE_FANOUT,Allocator>;
+    };
+    template <typename A, typename B, typename Allocator = std::allocator<char>>
+    using heap_def = compact_stable_heap<dary_heap_def<Allocator>::template heap,A,B>;
+#endif
 
     namespace {
         // use empty handles (not containing basewatcher *) if the handles returned from the
@@ -74,22 +153,33 @@ namespace dprivate {
         using node_type = std::conditional<use_empty_node, empty_node, base_watcher *>::type;
     }
 
-    using prio_queue = heap_def<node_type, int>;
+    // The event queue type (using the given allocator):
+    template <typename Allocator> using basic_prio_queue = heap_def<node_type, int, Allocator>;
 
-    using prio_queue_emptynode = heap_def<empty_node, int>;
-    using prio_queue_bwnode = heap_def<base_watcher *, int>;
+    using prio_queue = basic_prio_queue<std::allocator<char>>;
+
+    // The event queue type for loops whose traits specify single_priority; it must have the same
+    // handle type as prio_queue. The bucket queue is already a FIFO queue when all elements have the
+    // same priority; otherwise, we use a fifo_queue:
+#if DASYNQ_BUCKET_EVENT_QUEUE
+    template <typename Allocator> using basic_fifo_queue = basic_prio_queue<Allocator>;
+#else
+    template <typename Allocator> using basic_fifo_queue = fifo_queue<node_type, int, Allocator>;
+#endif
 
     template <typename T_Loop> class fd_watcher;
     template <typename T_Loop> class bidi_fd_watcher;
     template <typename T_Loop> class signal_watcher;
     template <typename T_Loop> class child_proc_watcher;
     template <typename T_Loop> class timer;
+    template <typename T_Loop> class notifier;
 
     template <typename, typename> class fd_watcher_impl;
     template <typename, typename> class bidi_fd_watcher_impl;
     template <typename, typename> class signal_watcher_impl;
     template <typename, typename> class child_proc_watcher_impl;
     template <typename, typename> class timer_impl;
+    template <typename, typename> class notifier_impl;
 
     enum class watch_type_t
     {
@@ -97,7 +187,9 @@ namespace dprivate {
         FD,
         CHILD,
         SECONDARYFD,
-        TIMER
+        TIMER,
+        NOTIFIER,
+        TASK
     };
 
     template <typename Traits, typename LoopTraits> class event_dispatch;
@@ -117,10 +209,14 @@ namespace dprivate {
         int emulatefd : 1; // emulate file watch (by re-queueing)
         int emulate_enabled : 1;   // whether an emulated watch is enabled
         int child_termd : 1;  // child process has terminated
+        int edge_disarmed : 1; // edge-triggered fd watch is disabled in the backend
 
         prio_queue::handle_t heap_handle;
         int priority;
 
+        // Next watcher in the loop's list of watchers pending deregistration (see deregister_async):
+        base_watcher *next_dereg;
+
         static void set_priority(base_watcher &p, int prio)
         {
             p.priority = prio;
@@ -134,6 +230,7 @@ namespace dprivate {
             emulatefd = false;
             emulate_enabled = false;
             child_termd = false;
+            edge_disarmed = false;
             prio_queue::init_handle(heap_handle);
             priority = DEFAULT_PRIORITY;
         }
@@ -150,6 +247,17 @@ namespace dprivate {
         // watcher (i.e. the output watcher):
         virtual void dispatch_second(void *loop_ptr) noexcept { }
 
+        // For batched dispatch (see default_traits::dispatch_batch), dispatch is split into phases:
+        // dispatch_prepare is called with the loop's internal lock held, and returns a value to pass
+        // to dispatch_callback, which is called without the lock held and runs the callback; then
+        // dispatch_complete (unless the callback returned rearm::REMOVED) is called with the lock held
+        // again. The secondary watcher of a bi-directional watch has no prepare phase.
+        virtual int dispatch_prepare(void *loop_ptr) noexcept { return 0; }
+        virtual rearm dispatch_callback(void *loop_ptr, int arg) noexcept { return rearm::NOOP; }
+        virtual void dispatch_complete(void *loop_ptr, rearm rearm_type) noexcept { }
+        virtual rearm dispatch_second_callback(void *loop_ptr) noexcept { return rearm::NOOP; }
+        virtual void dispatch_second_complete(void *loop_ptr, rearm rearm_type) noexcept { }
+
         virtual ~base_watcher() noexcept { }
 
         // Called when the watcher has been removed.
@@ -163,8 +271,10 @@ namespace dprivate {
         }
     };
 
-    // Retrieve watcher from queue handle:
-    inline base_watcher * get_watcher(prio_queue_emptynode &q, prio_queue_emptynode::handle_t &n)
+    // Retrieve watcher from queue handle (the third argument selects the implementation according to
+    // whether queue nodes are empty nodes):
+    template <typename Q>
+    inline base_watcher * get_watcher(Q &q, typename Q::handle_t &n, std::true_type)
     {
         uintptr_t bptr = (uintptr_t)&n;
         _Pragma ("GCC diagnostic push")
@@ -174,22 +284,37 @@ namespace dprivate {
         return (base_watcher *)bptr;
     }
 
-    inline dprivate::base_watcher * get_watcher(prio_queue_bwnode &q, prio_queue_bwnode::handle_t &n)
+    template <typename Q>
+    inline base_watcher * get_watcher(Q &q, typename Q::handle_t &n, std::false_type)
     {
         return q.node_data(n);
     }
 
+    template <typename Q>
+    inline base_watcher * get_watcher(Q &q, typename Q::handle_t &n)
+    {
+        return get_watcher(q, n, std::integral_constant<bool, use_empty_node>());
+    }
+
     // Allocate queue handle:
-    inline void allocate_handle(prio_queue_emptynode &q, prio_queue_emptynode::handle_t &n, base_watcher *bw)
+    template <typename Q>
+    inline void allocate_handle(Q &q, typename Q::handle_t &n, base_watcher *bw, std::true_type)
     {
         q.allocate(n);
     }
 
-    inline void allocate_handle(prio_queue_bwnode &q, prio_queue_bwnode::handle_t &n, base_watcher *bw)
+    template <typename Q>
+    inline void allocate_handle(Q &q, typename Q::handle_t &n, base_watcher *bw, std::false_type)
     {
         q.allocate(n, bw);
     }
 
+    template <typename Q>
+    inline void allocate_handle(Q &q, typename Q::handle_t &n, base_watcher *bw)
+    {
+        allocate_handle(q, n, bw, std::integral_constant<bool, use_empty_node>());
+    }
+
     // Base signal event - not part of public API
     template <typename T_Sigdata>
     class base_signal_watcher : public base_watcher
@@ -274,5 +399,132 @@ namespace dprivate {
             init_timer_handle(timer_handle);
         }
     };
+
+    class base_notifier : public base_watcher
+    {
+        template <typename, typename> friend class event_dispatch;
+        template <typename, typename> friend class dasynq::event_loop;
+
+        protected:
+        // Set by notify() (which then pushes the notifier onto the loop's notify list, if the flag
+        // was previously clear); cleared when the notification is dispatched.
+        std::atomic<bool> is_notified {false};
+
+        // Link in the loop's notify list:
+        base_notifier *next_notified = nullptr;
+
+        // These are protected by the loop's internal lock:
+        bool enabled = true;
+        bool pending = false;  // notification received while disabled or active
+
+        base_notifier() : base_watcher(watch_type_t::NOTIFIER) { }
+    };
+
+    // A closure posted to an event loop (see event_loop::post).
+    class base_posted_task : public base_watcher
+    {
+        template <typename, typename> friend class event_dispatch;
+        template <typename, typename> friend class dasynq::event_loop;
+
+        protected:
+        // Link in the loop's post list:
+        base_posted_task *next_posted = nullptr;
+
+        base_posted_task() : base_watcher(watch_type_t::TASK) { }
+    };
+
+    // A pool of fixed-size blocks, allocated when the pool is constructed, from which small posted
+    // tasks are allocated so that posting them doesn't require a heap allocation. Free blocks are kept
+    // in a lock-free stack (blocks may be taken by any thread); the head of the stack is tagged with a
+    // count of changes, so that a block being taken and returned between another thread reading the
+    // head and updating it is detected (the "ABA" problem).
+    template <typename Allocator, std::size_t BlockSize, unsigned Count>
+    class post_pool
+    {
+        static_assert(Count < 0xFFFFFFFFu, "post pool size must fit in 32 bits");
+
+        union block
+        {
+            alignas(std::max_align_t) char data[BlockSize];
+        };
+
+        using block_alloc_t = typename std::allocator_traits<Allocator>::template rebind_alloc<block>;
+        using link_alloc_t =
+                typename std::allocator_traits<Allocator>::template rebind_alloc<std::atomic<uint32_t>>;
+
+        block *blocks = nullptr;
+        std::atomic<uint32_t> *links = nullptr; // index of next free block, per block (Count = none)
+
+        // (tag << 32) | index of first free block (Count if there are none):
+        std::atomic<uint64_t> free_head {Count};
+
+        public:
+        constexpr static std::size_t block_size = BlockSize;
+
+        post_pool()
+        {
+            if (Count == 0) return;
+
+            blocks = block_alloc_t().allocate(Count);
+            try {
+                links = link_alloc_t().allocate(Count);
+            }
+            catch (...) {
+                block_alloc_t().deallocate(blocks, Count);
+                throw;
+            }
+
+            for (unsigned i = 0; i < Count; i++) {
+                new (&links[i]) std::atomic<uint32_t>(i + 1);
+            }
+            free_head.store(0, std::memory_order_relaxed);
+        }
+
+        post_pool(const post_pool &) = delete;
+
+        ~post_pool()
+        {
+            if (blocks != nullptr) {
+                link_alloc_t().deallocate(links, Count);
+                block_alloc_t().deallocate(blocks, Count);
+            }
+        }
+
+        // Take a free block; returns nullptr if there are none. May be called from any thread.
+        void *acquire() noexcept
+        {
+            uint64_t head = free_head.load(std::memory_order_acquire);
+            while ((uint32_t)head != Count) {
+                uint32_t index = (uint32_t)head;
+                uint64_t next = (((head >> 32) + 1) << 32) | links[index].load(std::memory_order_relaxed);
+                if (free_head.compare_exchange_weak(head, next, std::memory_order_acquire,
+                        std::memory_order_acquire)) {
+                    return &blocks[index];
+                }
+            }
+            return nullptr;
+        }
+
+        // Return a block (previously taken via acquire()) to the pool. May be called from any thread.
+        void release(void *p) noexcept
+        {
+            uint32_t index = (uint32_t)(static_cast<block *>(p) - blocks);
+            uint64_t head = free_head.load(std::memory_order_relaxed);
+            uint64_t next;
+            do {
+                links[index].store((uint32_t)head, std::memory_order_relaxed);
+                next = (((head >> 32) + 1) << 32) | index;
+            } while (! free_head.compare_exchange_weak(head, next, std::memory_order_release,
+                    std::memory_order_relaxed));
+        }
+
+        // Check whether an object was allocated from the pool.
+        bool contains(const void *p) const noexcept
+        {
+            uintptr_t pv = reinterpret_cast<uintptr_t>(p);
+            uintptr_t bv = reinterpret_cast<uintptr_t>(blocks);
+            return pv >= bv && pv < bv + Count * sizeof(block);
+        }
+    };
 } // dprivate
 } // dasynq
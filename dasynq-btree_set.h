@@ -2,27 +2,26 @@
 #define DASYNQ_BTREE_SET_H
 
 #include <functional>
+#include <memory>
+#include <new>
 #include <utility>
 
 namespace dasynq {
 
-// A sorted set based on a B-Tree data structure, supporting pre-allocation of nodes.
+namespace dprivate {
 
-template <typename T, typename P, typename Compare = std::less<P>, int N = 8>
-class btree_set
+// The node types of a btree_set; these do not depend on the comparison or allocator type, so that
+// the handle type (heapnode) doesn't either.
+template <typename T, typename P, int N>
+class btree_set_nodes
 {
-    struct heapnode;
-
     public:
-    using handle_t = heapnode;
-    using handle_t_r = heapnode &;
-
-    private:
+    struct heapnode;
 
     struct septnode
     {
         P prio[N];
-        handle_t * hn_p[N];  // pointer to handle
+        heapnode * hn_p[N];  // pointer to handle
         septnode * children[N + 1];
         septnode * parent;
 
@@ -101,6 +100,29 @@ class btree_set
 
         }
     };
+};
+
+}
+
+// A sorted set based on a B-Tree data structure, supporting pre-allocation of nodes.
+//
+// Tree nodes are obtained from the Allocator (rebound as required; it must be default-constructible).
+
+template <typename T, typename P, typename Compare = std::less<P>, int N = 8,
+        typename Allocator = std::allocator<char>>
+class btree_set
+{
+    using septnode = typename dprivate::btree_set_nodes<T,P,N>::septnode;
+    using heapnode = typename dprivate::btree_set_nodes<T,P,N>::heapnode;
+
+    using sept_alloc_t = typename std::allocator_traits<Allocator>::template rebind_alloc<septnode>;
+    using sept_alloc_traits = std::allocator_traits<sept_alloc_t>;
+
+    public:
+    using handle_t = heapnode;
+    using handle_t_r = heapnode &;
+
+    private:
 
     septnode * root_sept = nullptr; // root of the B-Tree
     septnode * left_sept = nullptr; // leftmost child (cache)
@@ -126,7 +148,7 @@ class btree_set
         if (__builtin_expect(num_alloced == next_sept, 0)) {
             if (++num_septs_needed > num_septs) {
                 try {
-                    septnode *new_res = new septnode();
+                    septnode *new_res = new_sept();
                     new_res->parent = sn_reserve;
                     sn_reserve = new_res;
                     num_septs++;
@@ -141,6 +163,21 @@ class btree_set
         }
     }
 
+    // Allocate a new sept node (for the reserve). Throws std::bad_alloc on failure.
+    static septnode * new_sept()
+    {
+        sept_alloc_t alloc;
+        septnode *r = sept_alloc_traits::allocate(alloc, 1);
+        return new (r) septnode();
+    }
+
+    static void delete_sept(septnode *s) noexcept
+    {
+        s->~septnode();
+        sept_alloc_t alloc;
+        sept_alloc_traits::deallocate(alloc, s, 1);
+    }
+
     septnode * alloc_sept()
     {
         septnode * r = sn_reserve;
@@ -316,7 +353,7 @@ class btree_set
                 // Note the "-1" margin is to alleviate bouncing allocation/deallocation
                 septnode * r = sn_reserve;
                 sn_reserve = r->parent;
-                delete r;
+                delete_sept(r);
                 num_septs--;
             }
         }
@@ -582,7 +619,7 @@ class btree_set
 
         while (sn_reserve != nullptr) {
             auto *next = sn_reserve->parent;
-            delete sn_reserve;
+            delete_sept(sn_reserve);
             sn_reserve = next;
         }
     }
@@ -0,0 +1,294 @@
+#ifndef DASYNQ_BUCKETQUEUE_H_INCLUDED
+#define DASYNQ_BUCKETQUEUE_H_INCLUDED
+
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <new>
+#include <utility>
+
+#include "dasynq-svec.h"
+
+namespace dasynq {
+
+namespace dprivate {
+
+// Handle to an element in a bucket_queue; also contains the data associated with the element, and
+// links to the adjacent elements (with the same priority) in the queue.
+template <typename T, typename P>
+struct bucket_queue_handle
+{
+    union hd_u_t {
+        // The data member is kept in a union so it doesn't get constructed/destructed
+        // automatically, and we can construct it lazily.
+        public:
+        hd_u_t() { }
+        ~hd_u_t() { }
+        T hd;
+    } hd_u;
+
+    bucket_queue_handle * next;
+    bucket_queue_handle * prev;
+    P prio;
+    bool queued;
+
+    bucket_queue_handle(const bucket_queue_handle &) = delete;
+    void operator=(const bucket_queue_handle &) = delete;
+
+    bucket_queue_handle() { }
+};
+
+}
+
+/**
+ * Priority queue implementation based on "buckets": each distinct priority value has a FIFO list of
+ * elements (linked through the element handles), and the buckets are kept in an array sorted by
+ * priority. Elements with the same priority are therefore dequeued in the order they were inserted
+ * (the queue is naturally stable, with no need for a sequence number), and inserting, removing or
+ * dequeuing an element is O(1) apart from locating its bucket, which is a binary search amongst the
+ * buckets (O(log B) for B distinct priorities).
+ *
+ * This suits a queue in which only a few distinct priorities are used (such as the event queue, where
+ * most watchers have the default priority). Inserting an element with a priority for which there is no
+ * bucket requires adding a bucket to the array, which is O(B); buckets which have become empty are
+ * retained until then (so that a priority which is repeatedly used doesn't repeatedly require a new
+ * bucket), and are discarded when a bucket is added.
+ *
+ * Storage for buckets is reserved when handles are allocated, so that insertion cannot fail.
+ *
+ * Parameters:
+ *
+ * T : node data type
+ * P : priority type (eg int)
+ * Compare : functional object type to compare priorities
+ * Allocator : allocator for the bucket array (rebound as required; must be default-constructible)
+ */
+template <typename T, typename P, typename Compare = std::less<P>, typename Allocator = std::allocator<char>>
+class bucket_queue
+{
+    public:
+    using handle_t = dprivate::bucket_queue_handle<T, P>;
+    using handle_t_r = handle_t &;
+
+    private:
+
+    struct bucket
+    {
+        P prio;
+        handle_t * head;
+        handle_t * tail;
+
+        bucket(const P &prio_p) : prio(prio_p), head(nullptr), tail(nullptr)
+        {
+        }
+
+        bucket() { }
+    };
+
+    svector<bucket, Allocator> buckets;
+
+    // index of first non-empty bucket, or buckets.size() if there are none:
+    std::size_t first_bucket = 0;
+
+    std::size_t num_alloced = 0;
+
+    // Find the bucket for the specified priority, or the position where such a bucket should be
+    // inserted.
+    std::size_t find_bucket(const P &p) noexcept
+    {
+        Compare lt;
+        std::size_t lo = 0;
+        std::size_t hi = buckets.size();
+        while (lo < hi) {
+            std::size_t mid = (lo + hi) / 2;
+            if (lt(buckets[mid].prio, p)) {
+                lo = mid + 1;
+            }
+            else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    bool is_bucket_for(std::size_t index, const P &p) noexcept
+    {
+        Compare lt;
+        return index < buckets.size() && ! lt(p, buckets[index].prio);
+    }
+
+    // Add a bucket for the specified priority (discarding empty buckets), returning its index.
+    // There must be no existing bucket for the priority.
+    std::size_t add_bucket(const P &p) noexcept
+    {
+        std::size_t j = 0;
+        for (std::size_t i = 0; i < buckets.size(); i++) {
+            if (buckets[i].head != nullptr) {
+                if (i != j) buckets[j] = buckets[i];
+                j++;
+            }
+        }
+        while (buckets.size() > j) {
+            buckets.pop_back();
+        }
+
+        // There is now at most one bucket per queued element, and the element being inserted is
+        // allocated but not queued, so the reserved capacity is sufficient:
+        std::size_t index = find_bucket(p);
+        buckets.emplace_back(p);
+        for (std::size_t i = buckets.size() - 1; i > index; i--) {
+            buckets[i] = buckets[i - 1];
+        }
+        buckets[index] = bucket(p);
+        first_bucket = 0;
+        return index;
+    }
+
+    void unlink(bucket &b, handle_t &hnd) noexcept
+    {
+        if (hnd.prev == nullptr) {
+            b.head = hnd.next;
+        }
+        else {
+            hnd.prev->next = hnd.next;
+        }
+
+        if (hnd.next == nullptr) {
+            b.tail = hnd.prev;
+        }
+        else {
+            hnd.next->prev = hnd.prev;
+        }
+
+        hnd.queued = false;
+    }
+
+    // Advance first_bucket past any empty buckets.
+    void skip_empty_buckets() noexcept
+    {
+        while (first_bucket < buckets.size() && buckets[first_bucket].head == nullptr) {
+            first_bucket++;
+        }
+    }
+
+    public:
+
+    T & node_data(handle_t & hnd) noexcept
+    {
+        return hnd.hd_u.hd;
+    }
+
+    static void init_handle(handle_t &hnd) noexcept
+    {
+        // nothing to do
+    }
+
+    // Allocate a slot, but do not incorporate into the queue:
+    //  u... : parameters for data constructor T::T(...)
+    template <typename ...U> void allocate(handle_t & hnd, U&&... u)
+    {
+        if (__builtin_expect(buckets.capacity() <= num_alloced, 0)) {
+            constexpr std::size_t max_allowed = (std::numeric_limits<ptrdiff_t>::max() - 1) / sizeof(bucket);
+            if (num_alloced >= max_allowed) {
+                throw std::bad_alloc();
+            }
+            try {
+                buckets.reserve(num_alloced < max_allowed / 2 ? (num_alloced + 1) * 2 : max_allowed);
+            }
+            catch (std::bad_alloc &e) {
+                buckets.reserve(num_alloced + 1);
+            }
+        }
+
+        new (& hnd.hd_u.hd) T(std::forward<U>(u)...);
+        hnd.queued = false;
+        num_alloced++;
+    }
+
+    // Deallocate a slot
+    void deallocate(handle_t & hnd) noexcept
+    {
+        num_alloced--;
+        hnd.hd_u.hd.~T();
+
+        // shrink the bucket array if it is sufficiently larger than required:
+        if (num_alloced < buckets.capacity() / 4 && buckets.size() <= num_alloced * 2) {
+            buckets.shrink_to(num_alloced * 2);
+        }
+    }
+
+    // Insert an allocated slot into the queue (after other elements with the same priority).
+    // Return true if it becomes the root.
+    bool insert(handle_t & hnd, const P &pval = P()) noexcept
+    {
+        std::size_t index = find_bucket(pval);
+        if (! is_bucket_for(index, pval)) {
+            index = add_bucket(pval);
+        }
+
+        bucket &b = buckets[index];
+        hnd.prio = pval;
+        hnd.next = nullptr;
+        hnd.prev = b.tail;
+        hnd.queued = true;
+        if (b.tail == nullptr) {
+            b.head = &hnd;
+        }
+        else {
+            b.tail->next = &hnd;
+        }
+        b.tail = &hnd;
+
+        if (index <= first_bucket) {
+            first_bucket = index;
+            return b.head == &hnd;
+        }
+        return false;
+    }
+
+    // Get the root node handle. The queue must not be empty.
+    handle_t & get_root() noexcept
+    {
+        return * buckets[first_bucket].head;
+    }
+
+    P &get_root_priority() noexcept
+    {
+        return buckets[first_bucket].prio;
+    }
+
+    void pull_root() noexcept
+    {
+        bucket &b = buckets[first_bucket];
+        unlink(b, *b.head);
+        skip_empty_buckets();
+    }
+
+    void remove(handle_t & hnd) noexcept
+    {
+        std::size_t index = find_bucket(hnd.prio);
+        unlink(buckets[index], hnd);
+        if (index == first_bucket) {
+            skip_empty_buckets();
+        }
+    }
+
+    bool empty() noexcept
+    {
+        return first_bucket == buckets.size();
+    }
+
+    bool is_queued(handle_t & hnd) noexcept
+    {
+        return hnd.queued;
+    }
+
+    bucket_queue() { }
+
+    bucket_queue(const bucket_queue &) = delete;
+};
+
+}
+
+#endif
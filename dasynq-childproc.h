@@ -2,6 +2,9 @@
 #include <sys/wait.h>
 
 #include <signal.h>
+#include <errno.h>
+
+#include <system_error>
 
 #include "dasynq-btree_set.h"
 
@@ -10,14 +13,16 @@ namespace dasynq {
 namespace dprivate {
 
 // Map of pid_t to void *, with possibility of reserving entries so that mappings can
-// be later added with no danger of allocator exhaustion (bad_alloc).
+// be later added with no danger of allocator exhaustion (bad_alloc). Nodes are allocated using
+// the specified allocator (the handle type does not depend on it).
+template <typename Allocator = std::allocator<char>>
 class pid_map
 {
-    using bmap_t = btree_set<void *, pid_t>;
+    using bmap_t = btree_set<void *, pid_t, std::less<pid_t>, 8, Allocator>;
     bmap_t b_map;
     
     public:
-    using pid_handle_t = bmap_t::handle_t;
+    using pid_handle_t = typename bmap_t::handle_t;
     
     // Map entry: present (bool), data (void *)
     using entry = std::pair<bool, void *>;
@@ -84,7 +89,7 @@ inline void sigchld_handler(int signum)
 
 } // dprivate namespace
 
-using pid_watch_handle_t = dprivate::pid_map::pid_handle_t;
+using pid_watch_handle_t = dprivate::pid_map<>::pid_handle_t;
 
 template <class Base> class child_proc_events : public Base
 {
@@ -98,8 +103,9 @@ template <class Base> class child_proc_events : public Base
     };
 
     private:
-    dprivate::pid_map child_waiters;
+    dprivate::pid_map<typename Base::allocator_t> child_waiters;
     reaper_mutex_t reaper_lock; // used to prevent reaping while trying to signal a process
+    bool child_watch_disabled = false;
     
     protected:
     using sigdata_t = typename traits_t::sigdata_t;
@@ -128,6 +134,9 @@ template <class Base> class child_proc_events : public Base
     public:
     void reserve_child_watch_nolock(pid_watch_handle_t &handle)
     {
+        if (child_watch_disabled) {
+            throw std::system_error(ENOTSUP, std::system_category());
+        }
         child_waiters.reserve(handle);
     }
     
@@ -144,8 +153,17 @@ template <class Base> class child_proc_events : public Base
 
     void add_child_watch_nolock(pid_watch_handle_t &handle, pid_t child, void *val)
     {
+        if (child_watch_disabled) {
+            throw std::system_error(ENOTSUP, std::system_category());
+        }
         child_waiters.add(handle, child, val);
     }
+
+    // Disallow further child watches (the caller must also remove the SIGCHLD watch):
+    void disable_child_watch_nolock() noexcept
+    {
+        child_watch_disabled = true;
+    }
     
     void add_reserved_child_watch(pid_watch_handle_t &handle, pid_t child, void *val) noexcept
     {
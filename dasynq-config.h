@@ -24,12 +24,44 @@
 // If the epoll family of system calls are available:
 //     #define DASYNQ_HAVE_EPOLL 1
 //
+// If the io_uring system calls are available (Linux 5.13 or later) and should be used instead of
+// epoll. This is not enabled by default, since io_uring may be unavailable or restricted (eg. by a
+// seccomp policy) at run time even if the kernel headers are present:
+//     #define DASYNQ_HAVE_IO_URING 1
+//
 // If the pipe2 system call is available:
 //     #define HAVE_PIPE2 1
 //
+// If eventfd is available (used instead of a pipe to interrupt a waiting thread):
+//     #define DASYNQ_HAVE_EVENTFD 1
+//
 // If the pselect system call is available:
 //     #define HAVE_PSELECT 1
 //
+// If pthread_setaffinity_np and sched_getaffinity are available (used to pin the threads of a
+// loop_group to processors, and to restrict the threads of a loop constructed with a cpu_affinity):
+//     #define DASYNQ_HAVE_PTHREAD_SETAFFINITY 1
+//
+// If the (Linux) futex system call is available (used to wait for the internal locks of a thread-safe
+// event loop, rather than using a condition variable); define as 0 to disable:
+//     #define DASYNQ_HAVE_FUTEX 1
+//
+// To use a bucket queue (see dasynq-bucketqueue.h) rather than a heap for the queue of pending events;
+// this is faster if only a few distinct watcher priorities are used, but slower if many are:
+//     #define DASYNQ_BUCKET_EVENT_QUEUE 1
+//
+// The fan-out (number of children per node) of the heap used for the queue of pending events, if it is
+// not a bucket queue (default 4):
+//     #define DASYNQ_EVENT_QUEUE_FANOUT 8
+//
+// To use SIMD instructions for the child search in soa_dary_heap (see dasynq-soaheap.h), when the fan-out
+// is a multiple of 4: SSE2 for int priorities, or AVX2 (which implies SSE2) also for 64-bit keys and timer
+// expiry times. The compiler must be generating code for a processor with the instructions (eg. with
+// GCC's -mavx2 for AVX2; SSE2 is always available on x86-64). These are not enabled by default (see the
+// results in extra/heaptest/README.md):
+//     #define DASYNQ_HEAP_SSE2 1
+//     #define DASYNQ_HEAP_AVX2 1
+//
 // A tag to include at the end of a class body for a class which is allowed to have zero size.
 // Normally, C++ mandates that all objects (except empty base subobjects) have non-zero size, but on some
 // compilers (at least GCC and LLVM-Clang) there are tricks to get around this awkward limitation. Note that
@@ -41,6 +73,10 @@
 // A statement to tell the compiler that the current line of code is unreachable, that is, it will never be
 // the case that program execution flow reaches this statement:
 //     #define DASYNQ_UNREACHABLE /* compiler specific! */
+//
+// A statement to hint to the processor that the current thread is spinning (busy-waiting), such as the x86
+// "pause" instruction; this is used by adaptive_mutex (see dasynq-mutex.h), and may be empty:
+//     #define DASYNQ_CPU_RELAX /* compiler and processor specific! */
 
 // ---------------------------------------------------------------------------------------------------------
 // Part 2: Automatic configuration begins here; you should not need to edit beyond this point.
@@ -80,6 +116,34 @@
 #define DASYNQ_HAVE_PIPE2 1
 #endif
 
+#if defined(__linux__) && ! defined(DASYNQ_HAVE_EVENTFD)
+#define DASYNQ_HAVE_EVENTFD 1
+#endif
+
+#if defined(__linux__) && ! defined(DASYNQ_HAVE_PTHREAD_SETAFFINITY)
+#define DASYNQ_HAVE_PTHREAD_SETAFFINITY 1
+#endif
+
+#if defined(__linux__) && ! defined(DASYNQ_HAVE_FUTEX)
+#define DASYNQ_HAVE_FUTEX 1
+#endif
+
+#if ! defined(DASYNQ_BUCKET_EVENT_QUEUE)
+#define DASYNQ_BUCKET_EVENT_QUEUE 0
+#endif
+
+#if ! defined(DASYNQ_EVENT_QUEUE_FANOUT)
+#define DASYNQ_EVENT_QUEUE_FANOUT 4
+#endif
+
+
+#if ! defined(DASYNQ_HEAP_AVX2)
+#define DASYNQ_HEAP_AVX2 0
+#endif
+
+#if ! defined(DASYNQ_HEAP_SSE2)
+#define DASYNQ_HEAP_SSE2 0
+#endif
 
 // Allow optimisation of empty classes by including this in the body:
 // May be included as the last entry for a class which is only
@@ -95,6 +159,18 @@
 #if ! defined(DASYNQ_UNREACHABLE)
 #define DASYNQ_UNREACHABLE          __builtin_unreachable()
 #endif
+
+#if ! defined(DASYNQ_CPU_RELAX)
+#if defined(__i386__) || defined(__x86_64__)
+#define DASYNQ_CPU_RELAX            __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define DASYNQ_CPU_RELAX            __asm__ __volatile__ ("yield")
+#endif
+#endif
 #endif /* __GNUC__ */
 
+#if ! defined(DASYNQ_CPU_RELAX)
+#define DASYNQ_CPU_RELAX            do { } while (0)
+#endif
+
 #endif
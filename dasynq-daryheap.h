@@ -1,16 +1,47 @@
 #ifndef DASYNQ_DARYHEAP_H_INCLUDED
 #define DASYNQ_DARYHEAP_H_INCLUDED
 
+#include <algorithm>
+#include <cstddef>
 #include <type_traits>
 #include <functional>
 #include <utility>
 #include <limits>
+#include <memory>
 
 #include "dasynq-svec.h"
 
 
 namespace dasynq {
 
+namespace dprivate {
+
+// Handle to an element in a priority queue (such as dary_heap); also contains the data associated
+// with the element. The index locates the element within the queue's own storage. (Alternative
+// implementation would be to store the data in a separate container, and have the handle be an
+// index into that container).
+template <typename T, typename I>
+struct queue_handle
+{
+    union hd_u_t {
+        // The data member is kept in a union so it doesn't get constructed/destructed
+        // automatically, and we can construct it lazily.
+        public:
+        hd_u_t() { }
+        ~hd_u_t() { }
+        T hd;
+    } hd_u;
+
+    I heap_index;
+
+    queue_handle(const queue_handle &) = delete;
+    void operator=(const queue_handle &) = delete;
+
+    queue_handle() { }
+};
+
+}
+
 /**
  * Priority queue implementation based on a heap with parameterised fan-out. All nodes are stored
  * in a vector, with the root at position 0, and each node has N child nodes, at positions
@@ -41,14 +72,19 @@ namespace dasynq {
  * P : priority type (eg int)
  * Compare : functional object type to compare priorities
  * N : fan out factor (number of child nodes per node)
+ * Allocator : allocator for the heap storage (rebound as required; must be default-constructible)
  */
-template <typename T, typename P, typename Compare = std::less<P>, int N = 4>
+template <typename T, typename P, typename Compare = std::less<P>, int N = 4,
+        typename Allocator = std::allocator<char>>
 class dary_heap
 {
     public:
-    struct handle_t;
+    using handle_t = dprivate::queue_handle<T, std::size_t>;
     using handle_t_r = handle_t &;
 
+    // The same heap type, but using a different allocator (the handle type is unchanged):
+    template <typename A> using rebind_alloc = dary_heap<T, P, Compare, N, A>;
+
     private:
 
     static_assert(std::is_nothrow_move_assignable<P>::value, "P must be no-except move assignable");
@@ -69,7 +105,7 @@ class dary_heap
         heap_node() { }
     };
 
-    svector<heap_node> hvec;
+    svector<heap_node, Allocator> hvec;
 
     using hindex_t = typename decltype(hvec)::size_type;
 
@@ -77,28 +113,6 @@ class dary_heap
 
     public:
 
-    // Handle to an element on the heap in the node buffer; also contains the data associated
-    // with the node. (Alternative implementation would be to store the heap data in a
-    // separate container, and have the handle be an index into that container).
-    struct handle_t
-    {
-        union hd_u_t {
-            // The data member is kept in a union so it doesn't get constructed/destructed
-            // automatically, and we can construct it lazily.
-            public:
-            hd_u_t() { }
-            ~hd_u_t() { }
-            T hd;
-        } hd_u;
-
-        hindex_t heap_index;
-
-        handle_t(const handle_t &) = delete;
-        void operator=(const handle_t &) = delete;
-
-        handle_t() { }
-    };
-
     // Initialise a handle (if it does not have a suitable constructor). Need not do anything
     // but may store a sentinel value to mark the handle as inactive. It should not be
     // necessary to call this, really.
@@ -146,19 +160,17 @@ class dary_heap
 
     void bubble_up(hindex_t pos, handle_t &h, const P &p) noexcept
     {
-        hindex_t rmax = hvec.size() - 1;
-        if (rmax == 0) {
-            return;
-        }
-
+        hindex_t size = hvec.size();
         Compare lt;
-        hindex_t max = (rmax - 1) / N;
 
-        while (pos <= max) {
+        while (true) {
             // Find (select) the smallest child node
             hindex_t lchild = pos * N + 1;
+            if (lchild >= size) {
+                break;
+            }
             hindex_t selchild = lchild;
-            hindex_t rchild = std::min(lchild + N, rmax);
+            hindex_t rchild = std::min(lchild + N, size);
             for (hindex_t i = lchild + 1; i < rchild; i++) {
                 if (lt(hvec[i].prio, hvec[selchild].prio)) {
                     selchild = i;
@@ -183,8 +195,18 @@ class dary_heap
     {
         hvec[hidx].hnd->heap_index = -1;
         if (hvec.size() != hidx + 1) {
-            bubble_up(hidx, *(hvec.back().hnd), hvec.back().prio);
+            // Move the last node into the vacated position; it may need to move in either direction.
+            handle_t *lhnd = hvec.back().hnd;
+            P lprio = std::move(hvec.back().prio);
             hvec.pop_back();
+
+            Compare lt;
+            if (hidx > 0 && lt(lprio, hvec[(hidx - 1) / N].prio)) {
+                bubble_down(hidx, lhnd, lprio);
+            }
+            else {
+                bubble_up(hidx, *lhnd, lprio);
+            }
         }
         else {
             hvec.pop_back();
@@ -307,6 +329,21 @@ class dary_heap
         }
     }
 
+    // Sort the nodes into priority order (which is also a valid heap), then call f(prio, i) for
+    // each node in turn (with i from 0), which may alter the priority provided that it does not change
+    // the order of the nodes (i.e. f must be order-preserving).
+    template <typename F> void sort_nodes(F f) noexcept
+    {
+        Compare lt;
+        std::sort(hvec.begin(), hvec.end(), [&lt](const heap_node &a, const heap_node &b) {
+            return lt(a.prio, b.prio);
+        });
+        for (hindex_t i = 0; i < hvec.size(); i++) {
+            hvec[i].hnd->heap_index = i;
+            f(hvec[i].prio, i);
+        }
+    }
+
     dary_heap() { }
 
     dary_heap(const dary_heap &) = delete;
@@ -1,10 +1,17 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <system_error>
 #include <mutex>
+#include <new>
 #include <type_traits>
 #include <unordered_map>
 #include <vector>
 
 #include <sys/epoll.h>
+#include <sys/ioctl.h>
 #include <sys/signalfd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -16,6 +23,22 @@ namespace dasynq {
 
 template <class Base> class epoll_loop;
 
+namespace dprivate {
+
+// Parameters for the ioctl (EPIOCSPARAMS, Linux 6.9 onwards) which sets busy-poll parameters for an
+// epoll instance. These are defined here since older system headers do not provide them.
+struct epoll_busy_params
+{
+    uint32_t busy_poll_usecs;
+    uint16_t busy_poll_budget;
+    uint8_t prefer_busy_poll;
+    uint8_t pad;
+};
+
+constexpr unsigned long epoll_set_params_req = _IOW(0x8A, 0x01, epoll_busy_params);
+
+} // namespace dprivate
+
 class epoll_traits
 {
     template <class Base> friend class epoll_loop;
@@ -89,16 +112,55 @@ class epoll_traits
     constexpr static bool interrupt_after_fd_add = false;
     constexpr static bool interrupt_after_signal_add = false;
     constexpr static bool supports_non_oneshot_fd = true;
+    constexpr static bool supports_edge_triggered = true;
+
+    // Several threads may wait in epoll_wait on the same epoll set at once (the kernel wakes only one
+    // of them for each event):
+    constexpr static bool supports_concurrent_polling = true;
 };
 
 
 template <class Base> class epoll_loop : public Base
 {
+    // Allocator for internal tables (from the loop traits), rebound to a given type:
+    template <typename T> using alloc_t =
+            typename std::allocator_traits<typename Base::allocator_t>::template rebind_alloc<T>;
+
     int epfd; // epoll fd
     int sigfd; // signalfd fd; -1 if not initialised
     sigset_t sigmask;
 
-    std::unordered_map<int, void *> sigdataMap;
+    std::unordered_map<int, void *, std::hash<int>, std::equal_to<int>,
+            alloc_t<std::pair<const int, void *>>> sigdataMap;
+
+    // Changes to fd watches (enable/disable) made while no thread is waiting in epoll_wait are not
+    // applied immediately; instead they are recorded and applied just before the next epoll_wait.
+    // Multiple changes to the same fd are coalesced, and a change which leaves the watch in the state
+    // it already has in the epoll set (eg. disable followed by re-enable) is elided altogether. Since
+    // events are only retrieved via epoll_wait, deferring the changes this way is not observable.
+    //
+    // Per-fd record:
+    struct fd_rec
+    {
+        void *userdata = nullptr;
+        int kflags = 0;        // flags (IN_EVENTS|OUT_EVENTS|ONE_SHOT|EDGE_TRIGGERED) as set in the epoll set; 0 if disarmed
+        int pflags = 0;        // flags to apply (if pending)
+        bool pending = false;  // change pending?
+        bool linked = false;   // in pending list? (may remain so after the change is cancelled)
+        int next_pending = -1; // next fd in pending list
+    };
+
+    std::vector<fd_rec, alloc_t<fd_rec>> fd_recs;
+    int pending_head = -1;  // first fd in pending list
+
+    // The number of threads currently in epoll_wait (which may be more than one if the event loop
+    // allows concurrent polling); if non-zero, changes must be applied immediately.
+    int waiters = 0;
+
+    // Buffer for events retrieved by epoll_wait; its size is the current batch size. Used by one
+    // polling thread at a time; others (if polling concurrently) use a local buffer.
+    std::vector<epoll_event, alloc_t<epoll_event>> event_buf;
+    std::atomic<bool> event_buf_busy {false};
 
     // Base contains:
     //   lock - a lock that can be used to protect internal structure.
@@ -139,12 +201,128 @@ template <class Base> class epoll_loop : public Base
                 (events[i].events & EPOLLOUT) && (flags |= OUT_EVENTS);
                 (events[i].events & EPOLLERR) && (flags |= IN_EVENTS | OUT_EVENTS | ERR_EVENTS);
                 auto r = Base::receive_fd_event(*this, fd_r(), ptr, flags);
+                int fd = fd_r().get_fd(std::get<1>(r));
+                fd_rec &rec = fd_recs[fd];
+                if (rec.kflags & ONE_SHOT) {
+                    // The watch has been disarmed by delivery of the event
+                    rec.kflags = 0;
+                }
                 if (std::get<0>(r) != 0) {
-                    enable_fd_watch_nolock(fd_r().get_fd(std::get<1>(r)), ptr, std::get<0>(r));
+                    enable_fd_watch_nolock(fd, ptr, std::get<0>(r));
                 }
             }            
         }
     }
+
+    static uint32_t to_epoll_events(int flags) noexcept
+    {
+        uint32_t events = 0;
+        if (flags & ONE_SHOT) {
+            events = EPOLLONESHOT;
+        }
+        if (flags & IN_EVENTS) {
+            events |= EPOLLIN;
+        }
+        if (flags & OUT_EVENTS) {
+            events |= EPOLLOUT;
+        }
+        if (flags & EDGE_TRIGGERED) {
+            events |= EPOLLET;
+        }
+        return events;
+    }
+
+    // Apply a watch change to the epoll set, unless it would have no effect. Call with lock held.
+    void apply_fd_flags(int fd, fd_rec &rec, int flags) noexcept
+    {
+        if ((flags & IO_EVENTS) == 0) {
+            // disable:
+            if (rec.kflags == 0) {
+                return;
+            }
+
+            struct epoll_event epevent;
+            // epevent.data.fd = fd;
+            epevent.data.ptr = nullptr;
+            epevent.events = 0;
+
+            // Epoll documentation says that hangup will still be reported, need to check
+            // whether this is really the case. Suspect it is really only the case if
+            // EPOLLIN is set.
+            if (epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &epevent) == -1) {
+                // Let's assume that this can't fail.
+                // throw new std::system_error(errno, std::system_category());
+            }
+            rec.kflags = 0;
+        }
+        else {
+            if (rec.kflags == flags) {
+                return;
+            }
+
+            struct epoll_event epevent;
+            // epevent.data.fd = fd;
+            epevent.data.ptr = rec.userdata;
+            epevent.events = to_epoll_events(flags);
+
+            if (epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &epevent) == -1) {
+                // Shouldn't be able to fail
+                // throw new std::system_error(errno, std::system_category());
+            }
+            rec.kflags = flags;
+        }
+    }
+
+    // Record (or, if a thread is waiting in epoll_wait, apply) a watch change. Call with lock held.
+    void queue_fd_flags(int fd, int flags) noexcept
+    {
+        fd_rec &rec = fd_recs[fd];
+        if (waiters != 0) {
+            rec.pending = false;
+            apply_fd_flags(fd, rec, flags);
+            return;
+        }
+
+        rec.pflags = flags;
+        rec.pending = true;
+        if (! rec.linked) {
+            rec.linked = true;
+            rec.next_pending = pending_head;
+            pending_head = fd;
+        }
+    }
+
+    // Apply all pending watch changes. Call with lock held.
+    void flush_fd_flags() noexcept
+    {
+        int fd = pending_head;
+        while (fd != -1) {
+            fd_rec &rec = fd_recs[fd];
+            rec.linked = false;
+            if (rec.pending) {
+                rec.pending = false;
+                apply_fd_flags(fd, rec, rec.pflags);
+            }
+            fd = rec.next_pending;
+        }
+        pending_head = -1;
+    }
+
+    // Apply pending changes and wait for events (mark the wait as in progress while waiting).
+    int wait_events(epoll_event *events, int maxevents, int timeout) noexcept
+    {
+        {
+            std::lock_guard<decltype(Base::lock)> guard(Base::lock);
+            flush_fd_flags();
+            waiters++;
+        }
+
+        int r = epoll_wait(epfd, events, maxevents, timeout);
+
+        std::lock_guard<decltype(Base::lock)> guard(Base::lock);
+        waiters--;
+        return r;
+    }
     
     public:
     
@@ -153,7 +331,7 @@ template <class Base> class epoll_loop : public Base
      *
      * Throws std::system_error or std::bad_alloc if the event loop cannot be initialised.
      */
-    epoll_loop() : sigfd(-1)
+    epoll_loop() : sigfd(-1), event_buf(Base::event_batch)
     {
         epfd = epoll_create1(EPOLL_CLOEXEC);
         if (epfd == -1) {
@@ -170,30 +348,50 @@ template <class Base> class epoll_loop : public Base
             close(sigfd);
         }
     }
+
+    // Get the current number of events retrieved per epoll_wait call (which may have grown from the
+    // initial size; see default_traits::max_event_batch). Should not be called while another thread
+    // is polling.
+    int get_event_batch_size() noexcept
+    {
+        return (int)event_buf.size();
+    }
+
+    // Enable (or with usecs = 0, disable) kernel busy polling for this epoll instance: while waiting
+    // for events, the kernel busy-polls the network device queues of watched sockets (as for the
+    // SO_BUSY_POLL socket option) for up to the specified number of microseconds, processing up to
+    // budget packets per poll, before sleeping. If prefer is true, the kernel prefers busy polling to
+    // interrupt-driven processing (see the kernel's napi documentation). Requires Linux 6.9 or later;
+    // throws std::system_error (ENOTTY on older kernels, EPERM if the budget exceeds what an
+    // unprivileged process may set).
+    void set_busy_poll(unsigned usecs, unsigned budget = 8, bool prefer = false)
+    {
+        dprivate::epoll_busy_params params = {};
+        params.busy_poll_usecs = usecs;
+        params.busy_poll_budget = budget;
+        params.prefer_busy_poll = prefer ? 1 : 0;
+        if (ioctl(epfd, dprivate::epoll_set_params_req, &params) == -1) {
+            throw std::system_error(errno, std::system_category());
+        }
+    }
     
     //        fd:  file descriptor to watch
     //  userdata:  data to associate with descriptor
-    //     flags:  IN_EVENTS | OUT_EVENTS | ONE_SHOT
+    //     flags:  IN_EVENTS | OUT_EVENTS | ONE_SHOT | EDGE_TRIGGERED
     // soft_fail:  true if unsupported file descriptors should fail by returning false instead
     //             of throwing an exception
     // returns: true on success; false if file descriptor type isn't supported and soft_fail == true
     // throws:  std::system_error or std::bad_alloc on failure
     bool add_fd_watch(int fd, void *userdata, int flags, bool enabled = true, bool soft_fail = false)
     {
+        if ((size_t)fd >= fd_recs.size()) {
+            fd_recs.resize(fd + 1);
+        }
+
         struct epoll_event epevent;
         // epevent.data.fd = fd;
         epevent.data.ptr = userdata;
-        epevent.events = 0;
-        
-        if (flags & ONE_SHOT) {
-            epevent.events = EPOLLONESHOT;
-        }
-        if ((flags & IN_EVENTS) && enabled) {
-            epevent.events |= EPOLLIN;
-        }
-        if ((flags & OUT_EVENTS) && enabled) {
-            epevent.events |= EPOLLOUT;
-        }
+        epevent.events = to_epoll_events(enabled ? flags : (flags & ONE_SHOT));
 
         if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &epevent) == -1) {
             if (soft_fail && errno == EPERM) {
@@ -201,6 +399,11 @@ template <class Base> class epoll_loop : public Base
             }
             throw new std::system_error(errno, std::system_category());        
         }
+
+        fd_rec &rec = fd_recs[fd];
+        rec.userdata = userdata;
+        rec.kflags = (enabled && (flags & IO_EVENTS)) ? flags : 0;
+        rec.pending = false;
         return true;
     }
     
@@ -214,12 +417,14 @@ template <class Base> class epoll_loop : public Base
     // separate read/write watches.
     void remove_fd_watch(int fd, int flags) noexcept
     {
-        epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr);
+        std::lock_guard<decltype(Base::lock)> guard(Base::lock);
+        remove_fd_watch_nolock(fd, flags);
     }
     
     void remove_fd_watch_nolock(int fd, int flags) noexcept
     {
-        remove_fd_watch(fd, flags);
+        epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr);
+        fd_recs[fd].pending = false;
     }
     
     void remove_bidi_fd_watch(int fd) noexcept
@@ -232,51 +437,30 @@ template <class Base> class epoll_loop : public Base
     // it can enable *or disable* read/write events.
     void enable_fd_watch(int fd, void *userdata, int flags) noexcept
     {
-        struct epoll_event epevent;
-        // epevent.data.fd = fd;
-        epevent.data.ptr = userdata;
-        epevent.events = 0;
-        
-        if (flags & ONE_SHOT) {
-            epevent.events = EPOLLONESHOT;
-        }
-        if (flags & IN_EVENTS) {
-            epevent.events |= EPOLLIN;
-        }
-        if (flags & OUT_EVENTS) {
-            epevent.events |= EPOLLOUT;
-        }
-        
-        if (epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &epevent) == -1) {
-            // Shouldn't be able to fail
-            // throw new std::system_error(errno, std::system_category());
-        }
+        std::lock_guard<decltype(Base::lock)> guard(Base::lock);
+        enable_fd_watch_nolock(fd, userdata, flags);
     }
     
-    void enable_fd_watch_nolock(int fd, void *userdata, int flags)
+    void enable_fd_watch_nolock(int fd, void *userdata, int flags) noexcept
     {
-        enable_fd_watch(fd, userdata, flags);
+        fd_rec &rec = fd_recs[fd];
+        if (rec.userdata != userdata) {
+            // (the recorded state is only valid for the same user data)
+            rec.userdata = userdata;
+            rec.kflags = -1;
+        }
+        queue_fd_flags(fd, flags);
     }
     
     void disable_fd_watch(int fd, int flags) noexcept
     {
-        struct epoll_event epevent;
-        // epevent.data.fd = fd;
-        epevent.data.ptr = nullptr;
-        epevent.events = 0;
-        
-        // Epoll documentation says that hangup will still be reported, need to check
-        // whether this is really the case. Suspect it is really only the case if
-        // EPOLLIN is set.
-        if (epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &epevent) == -1) {
-            // Let's assume that this can't fail.
-            // throw new std::system_error(errno, std::system_category());
-        }
+        std::lock_guard<decltype(Base::lock)> guard(Base::lock);
+        disable_fd_watch_nolock(fd, flags);
     }
     
     void disable_fd_watch_nolock(int fd, int flags) noexcept
     {
-        disable_fd_watch(fd, flags);
+        queue_fd_flags(fd, 0);
     }
 
     // Note signal should be masked before call.
@@ -345,17 +529,41 @@ template <class Base> class epoll_loop : public Base
     //            pending.
     void pull_events(bool do_wait)
     {
-        epoll_event events[16];
-        int r = epoll_wait(epfd, events, 16, do_wait ? -1 : 0);
+        if (event_buf_busy.exchange(true, std::memory_order_acquire)) {
+            // Another thread is polling concurrently, and using the event buffer:
+            epoll_event local_buf[Base::event_batch];
+            int r = wait_events(local_buf, Base::event_batch, do_wait ? -1 : 0);
+            while (r > 0) {
+                process_events(local_buf, r);
+                r = wait_events(local_buf, Base::event_batch, 0);
+            }
+            return;
+        }
+
+        int batch = (int)event_buf.size();
+        int r = wait_events(event_buf.data(), batch, do_wait ? -1 : 0);
         if (r == -1 || r == 0) {
             // signal or no events
+            event_buf_busy.store(false, std::memory_order_release);
             return;
         }
     
         do {
-            process_events(events, r);
-            r = epoll_wait(epfd, events, 16, 0);
+            process_events(event_buf.data(), r);
+            if (r == batch && batch < Base::max_event_batch) {
+                // Full batch: there may be many more events ready, so grow the buffer.
+                batch = std::min(batch * 2, (int)Base::max_event_batch);
+                try {
+                    event_buf.resize(batch);
+                }
+                catch (std::bad_alloc &) {
+                    batch = (int)event_buf.size();
+                }
+            }
+            r = wait_events(event_buf.data(), batch, 0);
         } while (r > 0);
+
+        event_buf_busy.store(false, std::memory_order_release);
     }
 };
 
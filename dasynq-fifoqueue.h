@@ -0,0 +1,189 @@
+#ifndef DASYNQ_FIFOQUEUE_H_INCLUDED
+#define DASYNQ_FIFOQUEUE_H_INCLUDED
+
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <new>
+#include <utility>
+
+#include "dasynq-svec.h"
+#include "dasynq-daryheap.h"
+
+namespace dasynq {
+
+/**
+ * A first-in, first-out queue with the same interface (and handle type) as the priority queues, for
+ * use where all elements have the same priority: priorities passed to insert() are ignored. Queued
+ * elements are held (as pointers to their handles) in an array; each handle records its position, so
+ * that an element can be removed from anywhere in the queue in O(1) time by clearing its slot. Insert
+ * and pull are also O(1) (amortised): cleared slots at the front of the queue are skipped when the root
+ * is pulled, and the array is compacted when it fills.
+ *
+ * Storage is reserved when handles are allocated (at least twice the number of allocated handles, so that
+ * compaction always frees at least half of the array), so that insertion cannot fail.
+ *
+ * Parameters:
+ *
+ * T : node data type
+ * P : priority type (eg int); all elements are given the same (default-constructed) priority
+ * Allocator : allocator for the queue storage (rebound as required; must be default-constructible)
+ */
+template <typename T, typename P, typename Allocator = std::allocator<char>>
+class fifo_queue
+{
+    public:
+    using handle_t = dprivate::queue_handle<T, std::size_t>;
+    using handle_t_r = handle_t &;
+
+    // The same queue type, but using a different allocator (the handle type is unchanged):
+    template <typename A> using rebind_alloc = fifo_queue<T,P,A>;
+
+    private:
+    using slot_alloc_t = typename std::allocator_traits<Allocator>::template rebind_alloc<handle_t *>;
+
+    // Queued elements are in slots [head, slots.size()); a null slot is an element that was removed.
+    svector<handle_t *, slot_alloc_t> slots;
+    std::size_t head = 0;
+
+    std::size_t num_queued = 0;
+    std::size_t num_alloced = 0;
+
+    P prio = P();
+
+    // Skip past removed elements at the front of the queue, and discard the slots if it is empty.
+    void skip_removed() noexcept
+    {
+        if (num_queued == 0) {
+            while (! slots.empty()) {
+                slots.pop_back();
+            }
+            head = 0;
+            return;
+        }
+
+        while (slots[head] == nullptr) {
+            head++;
+        }
+    }
+
+    // Move the queued elements to the start of the array, discarding removed elements.
+    void compact() noexcept
+    {
+        std::size_t j = 0;
+        for (std::size_t i = head; i < slots.size(); i++) {
+            if (slots[i] != nullptr) {
+                slots[j] = slots[i];
+                slots[j]->heap_index = j;
+                j++;
+            }
+        }
+        while (slots.size() > j) {
+            slots.pop_back();
+        }
+        head = 0;
+    }
+
+    public:
+
+    T & node_data(handle_t & hnd) noexcept
+    {
+        return hnd.hd_u.hd;
+    }
+
+    static void init_handle(handle_t &hnd) noexcept
+    {
+        // nothing to do
+    }
+
+    // Allocate a slot, but do not incorporate into the queue:
+    //  u... : parameters for data constructor T::T(...)
+    template <typename ...U> void allocate(handle_t & hnd, U&&... u)
+    {
+        constexpr std::size_t max_allowed = (std::numeric_limits<ptrdiff_t>::max() - 1) / sizeof(handle_t *);
+        if (num_alloced >= max_allowed / 4) {
+            throw std::bad_alloc();
+        }
+
+        if (__builtin_expect(slots.capacity() < (num_alloced + 1) * 2, 0)) {
+            slots.reserve((num_alloced + 1) * 4);
+        }
+
+        new (& hnd.hd_u.hd) T(std::forward<U>(u)...);
+        hnd.heap_index = -1;
+        num_alloced++;
+    }
+
+    // Deallocate a slot
+    void deallocate(handle_t & hnd) noexcept
+    {
+        num_alloced--;
+        hnd.hd_u.hd.~T();
+
+        // shrink the array if it is sufficiently larger than required:
+        if (num_alloced < slots.capacity() / 8 && slots.size() <= num_alloced * 4) {
+            slots.shrink_to(num_alloced * 4);
+        }
+    }
+
+    // Insert an allocated slot at the back of the queue (the priority is ignored). Return true if it
+    // becomes the root (i.e. the queue was empty).
+    bool insert(handle_t & hnd, const P &pval = P()) noexcept
+    {
+        if (slots.size() == slots.capacity()) {
+            // There are fewer queued elements than allocated handles, and the capacity is at least
+            // twice the number of handles, so this leaves at least half of the array free:
+            compact();
+        }
+
+        hnd.heap_index = slots.size();
+        slots.push_back(&hnd);
+        return ++num_queued == 1;
+    }
+
+    // Get the root node handle. The queue must not be empty.
+    handle_t & get_root() noexcept
+    {
+        return * slots[head];
+    }
+
+    P &get_root_priority() noexcept
+    {
+        return prio;
+    }
+
+    void pull_root() noexcept
+    {
+        slots[head]->heap_index = -1;
+        slots[head] = nullptr;
+        num_queued--;
+        head++;
+        skip_removed();
+    }
+
+    void remove(handle_t & hnd) noexcept
+    {
+        slots[hnd.heap_index] = nullptr;
+        hnd.heap_index = -1;
+        num_queued--;
+        skip_removed();
+    }
+
+    bool empty() noexcept
+    {
+        return num_queued == 0;
+    }
+
+    bool is_queued(handle_t & hnd) noexcept
+    {
+        return hnd.heap_index != (std::size_t) -1;
+    }
+
+    fifo_queue() { }
+
+    fifo_queue(const fifo_queue &) = delete;
+};
+
+}
+
+#endif
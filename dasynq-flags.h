@@ -10,6 +10,12 @@ constexpr unsigned int ERR_EVENTS = 4;
 
 constexpr unsigned int ONE_SHOT = 8;
 
+// Edge-triggered fd watch: the watch remains armed after an event is reported, and further events are
+// reported only when the descriptor becomes newly ready. The watcher's handler must perform I/O until
+// it fails with EAGAIN/EWOULDBLOCK (or otherwise consume all readiness), since readiness that remains
+// after the handler returns will not be reported again.
+constexpr unsigned int EDGE_TRIGGERED = 16;
+
 // Masks:
 constexpr unsigned int IO_EVENTS = IN_EVENTS | OUT_EVENTS;
 
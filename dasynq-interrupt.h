@@ -1,6 +1,9 @@
 #ifndef DASYNQ_INTERRUPT_H_INCLUDED
 #define DASYNQ_INTERRUPT_H_INCLUDED
 
+#include <atomic>
+#include <cstdint>
+
 #include <unistd.h>
 #include <fcntl.h>
 
@@ -8,6 +11,10 @@
 #include "dasynq-mutex.h"
 #include "dasynq-util.h"
 
+#if DASYNQ_HAVE_EVENTFD
+#include <sys/eventfd.h>
+#endif
+
 /*
  * Mechanism for interrupting an event loop wait.
  */
@@ -26,55 +33,95 @@ template <typename Base> class interrupt_channel<Base, null_mutex> : public Base
     }
 };
 
+// The interrupt channel is an eventfd where available, otherwise a pipe. For an eventfd, the read
+// and write ends are the same file descriptor.
 template <typename Base, typename Mutex> class interrupt_channel : public Base
 {
-    static inline int create_pipe(int filedes[2])
+#if DASYNQ_HAVE_EVENTFD
+    static inline int create_channel(int filedes[2])
+    {
+        filedes[0] = filedes[1] = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        return filedes[0];
+    }
+#else
+    static inline int create_channel(int filedes[2])
     {
         return pipe2(filedes, O_CLOEXEC | O_NONBLOCK);
     }
+#endif
 
-    int pipe_r_fd;
-    int pipe_w_fd;
+    int intr_r_fd = -1;
+    int intr_w_fd = -1;
+
+    // Set when an interrupt has been issued and not yet received; further interrupts issued in the
+    // meantime need not write to the channel.
+    std::atomic<bool> wakeup_pending {false};
+
+    void close_channel()
+    {
+        close(intr_r_fd);
+        if (intr_w_fd != intr_r_fd) {
+            close(intr_w_fd);
+        }
+    }
 
     public:
 
     template <typename T> void init(T *loop_mech)
     {
-        int pipedes[2];
-        if (create_pipe(pipedes) == -1) {
+        int filedes[2];
+        if (create_channel(filedes) == -1) {
             throw std::system_error(errno, std::system_category());
         }
 
-        pipe_r_fd = pipedes[0];
-        pipe_w_fd = pipedes[1];
+        intr_r_fd = filedes[0];
+        intr_w_fd = filedes[1];
 
         try {
-            loop_mech->add_fd_watch(pipe_r_fd, &pipe_r_fd, IN_EVENTS);
+            loop_mech->add_fd_watch(intr_r_fd, &intr_r_fd, IN_EVENTS);
         }
         catch (...) {
-            close (pipe_r_fd);
-            close (pipe_w_fd);
+            close_channel();
+            intr_r_fd = intr_w_fd = -1;
             throw;
         }
 
         Base::init(loop_mech);
     }
 
+    ~interrupt_channel()
+    {
+        if (intr_r_fd != -1) {
+            close_channel();
+        }
+    }
+
     template <typename T>
     std::tuple<int, typename Base::traits_t::fd_s>
     receive_fd_event(T &loop_mech, typename Base::traits_t::fd_r fd_r_a, void * userdata, int flags)
     {
-        if (userdata == &pipe_r_fd) {
-            // try to clear the pipe
+        if (userdata == &intr_r_fd) {
+#if DASYNQ_HAVE_EVENTFD
+            uint64_t val;
+            read(intr_r_fd, &val, sizeof(val));
+#else
+            // try to clear the pipe (fully, since some backends report readiness only on change)
             char buf[64];
-            read(pipe_r_fd, buf, 64);
+            while (read(intr_r_fd, buf, 64) == 64) { }
+#endif
+            // Clear the pending flag only after clearing the channel: if it were cleared first, an
+            // interrupt issued in between would write to the channel, have its write consumed here,
+            // and leave the flag set, so that no further interrupt would write. An interrupt issued
+            // after the channel is cleared but before the flag is, which doesn't write, is still
+            // seen: the notify and post lists are drained after the backend events are processed.
+            wakeup_pending.store(false, std::memory_order_seq_cst);
             if (Base::traits_t::supports_non_oneshot_fd) {
                 // If the loop mechanism actually persists none-oneshot marked watches, we don't need
                 // to re-enable:
-                return std::make_tuple(0, typename Base::traits_t::fd_s(pipe_r_fd));
+                return std::make_tuple(0, typename Base::traits_t::fd_s(intr_r_fd));
             }
             else {
-                return std::make_tuple(IN_EVENTS, typename Base::traits_t::fd_s(pipe_r_fd));
+                return std::make_tuple(IN_EVENTS, typename Base::traits_t::fd_s(intr_r_fd));
             }
         }
         else {
@@ -84,8 +131,17 @@ template <typename Base, typename Mutex> class interrupt_channel : public Base
 
     void interrupt_wait()
     {
+        if (wakeup_pending.exchange(true)) {
+            // A wakeup is already pending
+            return;
+        }
+#if DASYNQ_HAVE_EVENTFD
+        uint64_t val = 1;
+        write(intr_w_fd, &val, sizeof(val));
+#else
         char buf[1] = { 0 };
-        write(pipe_w_fd, buf, 1);
+        write(intr_w_fd, buf, 1);
+#endif
     }
 };
 
@@ -0,0 +1,715 @@
+#ifndef DASYNQ_IOURING_H_INCLUDED
+#define DASYNQ_IOURING_H_INCLUDED
+
+#include <system_error>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include <tuple>
+#include <cstring>
+#include <cstdint>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/signalfd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <endian.h>
+#include <poll.h>
+#include <unistd.h>
+#include <signal.h>
+
+#include "dasynq-config.h"
+
+// "io_uring"-based event loop mechanism (Linux 5.13+).
+//
+// File descriptors are watched via IORING_OP_POLL_ADD requests. Watches which are not marked ONE_SHOT
+// (i.e. those used internally for the interrupt channel, timerfds and signalfd) are added as multishot
+// polls, and so stay armed across events. ONE_SHOT watches are added as single-shot polls; re-arming
+// such a watch just places a request in the submission queue, which is submitted (together with any
+// other pending requests) by the same io_uring_enter call that waits for events. This means that, for
+// the polling thread, re-arming an fd watch does not require a system call of its own.
+//
+// We use the raw system calls rather than liburing, to avoid an external dependency.
+//
+// Each watched file descriptor has a record (indexed by fd) holding the user data and a generation
+// count. The user_data of each poll request encodes the fd and the generation at the time the request
+// was issued; when a watch is disabled, removed or re-armed with different flags the generation is
+// bumped, so that completions for stale requests (which may already be sitting in the completion
+// queue) can be recognised and discarded. This is important since a watcher may be deleted once it
+// has been removed.
+
+namespace dasynq {
+
+template <class Base> class io_uring_loop;
+
+class io_uring_traits
+{
+    template <class Base> friend class io_uring_loop;
+
+    public:
+
+    class sigdata_t
+    {
+        template <class Base> friend class io_uring_loop;
+
+        struct signalfd_siginfo info;
+
+        public:
+        // mandatory:
+        int get_signo() { return info.ssi_signo; }
+        int get_sicode() { return info.ssi_code; }
+        pid_t get_sipid() { return info.ssi_pid; }
+        uid_t get_siuid() { return info.ssi_uid; }
+        void * get_siaddr() { return reinterpret_cast<void *>(info.ssi_addr); }
+        int get_sistatus() { return info.ssi_status; }
+        int get_sival_int() { return info.ssi_int; }
+        void * get_sival_ptr() { return reinterpret_cast<void *>(info.ssi_ptr); }
+
+        // XSI
+        int get_sierrno() { return info.ssi_errno; }
+
+        // XSR (streams) OB (obselete)
+        int get_siband() { return info.ssi_band; }
+
+        // Linux:
+        int32_t get_sifd() { return info.ssi_fd; }
+        uint32_t get_sittimerid() { return info.ssi_tid; }
+        uint32_t get_sioverrun() { return info.ssi_overrun; }
+        uint32_t get_sitrapno() { return info.ssi_trapno; }
+        uint32_t get_siutime() { return info.ssi_utime; }
+        uint32_t get_sistime() { return info.ssi_stime; }
+
+        void set_signo(int signo) { info.ssi_signo = signo; }
+    };
+
+    class fd_r;
+
+    // File descriptor optional storage. If the mechanism can return the file descriptor, this
+    // class will be empty, otherwise it can hold a file descriptor.
+    class fd_s {
+        public:
+        fd_s(int) noexcept { }
+
+        DASYNQ_EMPTY_BODY
+    };
+
+    // File descriptor reference (passed to event callback). If the mechanism can return the
+    // file descriptor, this class holds the file descriptor. Otherwise, the file descriptor
+    // must be stored in an fd_s instance.
+    class fd_r {
+        int fd;
+
+        public:
+        int get_fd(fd_s ss)
+        {
+            return fd;
+        }
+
+        fd_r(int nfd) noexcept : fd(nfd) { }
+    };
+
+    constexpr static bool has_bidi_fd_watch = true;
+    constexpr static bool has_separate_rw_fd_watches = false;
+    constexpr static bool interrupt_after_fd_add = false;
+    constexpr static bool interrupt_after_signal_add = false;
+    constexpr static bool supports_non_oneshot_fd = true;
+    constexpr static bool supports_concurrent_polling = false;
+    constexpr static bool supports_edge_triggered = false;
+};
+
+
+template <class Base> class io_uring_loop : public Base
+{
+    using sigdata_t = io_uring_traits::sigdata_t;
+    using fd_r = typename io_uring_traits::fd_r;
+
+    // Allocator for internal tables (from the loop traits), rebound to a given type:
+    template <typename T> using alloc_t =
+            typename std::allocator_traits<typename Base::allocator_t>::template rebind_alloc<T>;
+
+    // Number of submission queue entries requested from the kernel. The completion queue is
+    // (by default) twice this size.
+    static constexpr unsigned RING_ENTRIES = 256;
+
+    // Per-fd watch record.
+    struct fd_rec
+    {
+        void *userdata = nullptr;
+        uint32_t gen = 0;   // generation of current poll request
+        int flags = 0;      // flags of currently armed request (0 if not armed)
+        bool persistent = false; // watch not ONE_SHOT?
+        bool multishot = false;  // current request is a multishot poll?
+    };
+
+    int ring_fd;
+    int sigfd; // signalfd fd; -1 if not initialised
+    sigset_t sigmask;
+
+    // Submission queue:
+    void *sq_ring_ptr;
+    size_t sq_ring_sz;
+    io_uring_sqe *sqes;
+    size_t sqes_sz;
+    unsigned *sq_khead;
+    unsigned *sq_ktail;
+    unsigned *sq_array;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned sq_tail; // local tail (published to kernel via sq_ktail)
+
+    // Completion queue:
+    void *cq_ring_ptr;
+    size_t cq_ring_sz;
+    io_uring_cqe *cqes;
+    unsigned *cq_khead;
+    unsigned *cq_ktail;
+    unsigned cq_mask;
+
+    std::vector<fd_rec, alloc_t<fd_rec>> fd_recs;
+    std::unordered_map<int, void *, std::hash<int>, std::equal_to<int>,
+            alloc_t<std::pair<const int, void *>>> sigdataMap;
+
+    // Whether a thread is waiting for completions in io_uring_enter. If so, newly queued requests
+    // must be submitted immediately, rather than being left for the next poll.
+    bool in_wait = false;
+
+    // Whether multishot polls are supported (assume so until we find otherwise).
+    bool have_multishot = true;
+
+    // Base contains:
+    //   lock - a lock that can be used to protect internal structure.
+    //          receive*() methods will be called with lock held.
+    //   receive_signal(sigdata_t &, user *) noexcept
+    //   receive_fd_event(fd_r, user *, int flags) noexcept
+
+    static int sys_io_uring_setup(unsigned entries, io_uring_params *p) noexcept
+    {
+        return (int) syscall(__NR_io_uring_setup, entries, p);
+    }
+
+    static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) noexcept
+    {
+        return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, _NSIG / 8);
+    }
+
+    static uint64_t make_user_data(int fd, uint32_t gen) noexcept
+    {
+        return ((uint64_t)gen << 32) | (uint32_t)fd;
+    }
+
+    static unsigned to_poll_mask(int flags) noexcept
+    {
+        unsigned mask = 0;
+        if (flags & IN_EVENTS) mask |= POLLIN;
+        if (flags & OUT_EVENTS) mask |= POLLOUT;
+#if __BYTE_ORDER == __BIG_ENDIAN
+        mask = (mask << 16) | (mask >> 16);
+#endif
+        return mask;
+    }
+
+    void unmap_rings() noexcept
+    {
+        munmap(sqes, sqes_sz);
+        if (cq_ring_ptr != sq_ring_ptr) {
+            munmap(cq_ring_ptr, cq_ring_sz);
+        }
+        munmap(sq_ring_ptr, sq_ring_sz);
+    }
+
+    unsigned sq_pending() noexcept
+    {
+        return sq_tail - __atomic_load_n(sq_khead, __ATOMIC_ACQUIRE);
+    }
+
+    // Submit queued requests now. Call with lock held.
+    void submit_nolock() noexcept
+    {
+        unsigned pending = sq_pending();
+        if (pending != 0) {
+            sys_io_uring_enter(ring_fd, pending, 0, 0);
+        }
+    }
+
+    // Get a free submission queue entry. The entry is not visible to the kernel until publish_sqe()
+    // is called. Call with lock held.
+    io_uring_sqe *get_sqe() noexcept
+    {
+        if (sq_pending() == sq_entries) {
+            // The queue is full; submit what we have so far.
+            submit_nolock();
+            while (sq_pending() == sq_entries) {
+                // The kernel didn't consume any entries; this is only likely if the completion
+                // queue has overflowed. Wait for some completions to be reaped.
+                sys_io_uring_enter(ring_fd, sq_entries, 0, IORING_ENTER_GETEVENTS);
+            }
+        }
+
+        unsigned idx = sq_tail & sq_mask;
+        io_uring_sqe *sqe = &sqes[idx];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sq_array[idx] = idx;
+        return sqe;
+    }
+
+    void publish_sqe() noexcept
+    {
+        sq_tail++;
+        __atomic_store_n(sq_ktail, sq_tail, __ATOMIC_RELEASE);
+        if (in_wait) {
+            // Another thread is waiting for completions; it won't see our request unless we
+            // submit it now.
+            submit_nolock();
+        }
+    }
+
+    // Queue a poll request for an fd, according to the state of its record. Call with lock held.
+    void queue_poll_add(int fd, fd_rec &rec) noexcept
+    {
+        if (++rec.gen == 0) rec.gen = 1;
+        io_uring_sqe *sqe = get_sqe();
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = fd;
+        sqe->poll32_events = to_poll_mask(rec.flags);
+        rec.multishot = rec.persistent && have_multishot;
+        if (rec.multishot) {
+            sqe->len = IORING_POLL_ADD_MULTI;
+        }
+        sqe->user_data = make_user_data(fd, rec.gen);
+        publish_sqe();
+    }
+
+    // Queue removal of the currently armed poll request for an fd. Call with lock held.
+    void queue_poll_remove(int fd, fd_rec &rec) noexcept
+    {
+        io_uring_sqe *sqe = get_sqe();
+        sqe->opcode = IORING_OP_POLL_REMOVE;
+        sqe->fd = -1;
+        sqe->addr = make_user_data(fd, rec.gen);
+        sqe->user_data = 0; // completion ignored
+        publish_sqe();
+        if (++rec.gen == 0) rec.gen = 1;
+        rec.flags = 0;
+    }
+
+    // Arm (or re-arm) a watch with the given flags, replacing any currently armed request.
+    // Call with lock held.
+    void arm_nolock(int fd, int flags) noexcept
+    {
+        fd_rec &rec = fd_recs[fd];
+        bool persistent = (flags & ONE_SHOT) == 0;
+        if (rec.flags != 0) {
+            if (rec.flags == (int)(flags & IO_EVENTS) && rec.persistent == persistent) {
+                // Already armed as requested.
+                return;
+            }
+            queue_poll_remove(fd, rec);
+        }
+        rec.persistent = persistent;
+        rec.flags = flags & IO_EVENTS;
+        if (rec.flags != 0) {
+            queue_poll_add(fd, rec);
+        }
+    }
+
+    void process_signals() noexcept
+    {
+        sigdata_t siginfo;
+        while (true) {
+            int r = read(sigfd, &siginfo.info, sizeof(siginfo.info));
+            if (r == -1) break;
+            auto iter = sigdataMap.find(siginfo.get_signo());
+            if (iter != sigdataMap.end()) {
+                void *userdata = (*iter).second;
+                if (Base::receive_signal(*this, siginfo, userdata)) {
+                    sigdelset(&sigmask, siginfo.get_signo());
+                }
+            }
+        }
+        signalfd(sigfd, &sigmask, SFD_NONBLOCK | SFD_CLOEXEC);
+    }
+
+    // Process a single completion. Call with lock held.
+    void process_cqe(const io_uring_cqe &cqe) noexcept
+    {
+        if (cqe.user_data == 0) {
+            // completion of a poll removal
+            return;
+        }
+
+        int fd = (int)(uint32_t)cqe.user_data;
+        uint32_t gen = (uint32_t)(cqe.user_data >> 32);
+        if ((size_t)fd >= fd_recs.size()) {
+            return;
+        }
+
+        fd_rec &rec = fd_recs[fd];
+        if (rec.gen != gen || rec.flags == 0) {
+            // stale completion (watch has since been disabled, removed or re-armed)
+            return;
+        }
+
+        bool more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+        int res = cqe.res;
+
+        if (res < 0) {
+            if (res == -EINVAL && rec.multishot) {
+                // Kernel doesn't support multishot poll; use single-shot polls instead, re-arming
+                // after each event. Every persistent watch armed before this was discovered fails
+                // in the same way, and each must be re-armed as it completes.
+                have_multishot = false;
+                queue_poll_add(fd, rec);
+            }
+            else if (! more) {
+                rec.flags = 0;
+            }
+            return;
+        }
+
+        if (! more) {
+            if (rec.persistent) {
+                // Multishot poll was terminated (or is not supported); re-arm it.
+                queue_poll_add(fd, rec);
+            }
+            else {
+                rec.flags = 0;
+            }
+        }
+
+        void *ptr = rec.userdata;
+        if (ptr == &sigfd) {
+            process_signals();
+            return;
+        }
+
+        int flags = 0;
+        (res & POLLIN) && (flags |= IN_EVENTS);
+        (res & POLLHUP) && (flags |= IN_EVENTS);
+        (res & POLLOUT) && (flags |= OUT_EVENTS);
+        (res & POLLERR) && (flags |= IN_EVENTS | OUT_EVENTS | ERR_EVENTS);
+        auto r = Base::receive_fd_event(*this, fd_r(fd), ptr, flags);
+        if (std::get<0>(r) != 0) {
+            enable_fd_watch_nolock(fd, ptr, std::get<0>(r));
+        }
+    }
+
+    // Process all completions currently in the completion queue. Returns true if any were
+    // processed.
+    bool process_events() noexcept
+    {
+        std::lock_guard<decltype(Base::lock)> guard(Base::lock);
+        in_wait = false;
+
+        unsigned head = *cq_khead;
+        unsigned tail = __atomic_load_n(cq_ktail, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            return false;
+        }
+
+        do {
+            while (head != tail) {
+                // Copy the entry, so that the slot can be released before we process it:
+                io_uring_cqe cqe = cqes[head & cq_mask];
+                head++;
+                __atomic_store_n(cq_khead, head, __ATOMIC_RELEASE);
+                process_cqe(cqe);
+            }
+            tail = __atomic_load_n(cq_ktail, __ATOMIC_ACQUIRE);
+        } while (head != tail);
+
+        return true;
+    }
+
+    // Add a record for a new fd watch. Call with lock held.
+    fd_rec &add_rec(int fd, void *userdata, int flags)
+    {
+        if ((size_t)fd >= fd_recs.size()) {
+            fd_recs.resize(fd + 1);
+        }
+        fd_rec &rec = fd_recs[fd];
+        rec.userdata = userdata;
+        rec.flags = 0;
+        rec.persistent = (flags & ONE_SHOT) == 0;
+        return rec;
+    }
+
+    public:
+
+    /**
+     * io_uring_loop constructor.
+     *
+     * Throws std::system_error or std::bad_alloc if the event loop cannot be initialised.
+     */
+    io_uring_loop() : sigfd(-1)
+    {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        ring_fd = sys_io_uring_setup(RING_ENTRIES, &params);
+        if (ring_fd == -1) {
+            throw std::system_error(errno, std::system_category());
+        }
+
+        sq_ring_sz = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_ring_sz = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_mmap && cq_ring_sz > sq_ring_sz) {
+            sq_ring_sz = cq_ring_sz;
+        }
+
+        sq_ring_ptr = mmap(nullptr, sq_ring_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                ring_fd, IORING_OFF_SQ_RING);
+        if (sq_ring_ptr == MAP_FAILED) {
+            int e = errno;
+            close(ring_fd);
+            throw std::system_error(e, std::system_category());
+        }
+
+        if (single_mmap) {
+            cq_ring_ptr = sq_ring_ptr;
+        }
+        else {
+            cq_ring_ptr = mmap(nullptr, cq_ring_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    ring_fd, IORING_OFF_CQ_RING);
+            if (cq_ring_ptr == MAP_FAILED) {
+                int e = errno;
+                munmap(sq_ring_ptr, sq_ring_sz);
+                close(ring_fd);
+                throw std::system_error(e, std::system_category());
+            }
+        }
+
+        sqes_sz = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = (io_uring_sqe *) mmap(nullptr, sqes_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                ring_fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            int e = errno;
+            if (cq_ring_ptr != sq_ring_ptr) {
+                munmap(cq_ring_ptr, cq_ring_sz);
+            }
+            munmap(sq_ring_ptr, sq_ring_sz);
+            close(ring_fd);
+            throw std::system_error(e, std::system_category());
+        }
+
+        char *sq_base = (char *) sq_ring_ptr;
+        sq_khead = (unsigned *)(sq_base + params.sq_off.head);
+        sq_ktail = (unsigned *)(sq_base + params.sq_off.tail);
+        sq_array = (unsigned *)(sq_base + params.sq_off.array);
+        sq_mask = *(unsigned *)(sq_base + params.sq_off.ring_mask);
+        sq_entries = params.sq_entries;
+        sq_tail = *sq_ktail;
+
+        char *cq_base = (char *) cq_ring_ptr;
+        cq_khead = (unsigned *)(cq_base + params.cq_off.head);
+        cq_ktail = (unsigned *)(cq_base + params.cq_off.tail);
+        cqes = (io_uring_cqe *)(cq_base + params.cq_off.cqes);
+        cq_mask = *(unsigned *)(cq_base + params.cq_off.ring_mask);
+
+        sigemptyset(&sigmask);
+        try {
+            Base::init(this);
+        }
+        catch (...) {
+            unmap_rings();
+            close(ring_fd);
+            throw;
+        }
+    }
+
+    ~io_uring_loop()
+    {
+        unmap_rings();
+        close(ring_fd);
+        if (sigfd != -1) {
+            close(sigfd);
+        }
+    }
+
+    // Note: add_fd_watch is called with the lock held (or during initialisation).
+    //
+    //        fd:  file descriptor to watch
+    //  userdata:  data to associate with descriptor
+    //     flags:  IN_EVENTS | OUT_EVENTS | ONE_SHOT
+    // soft_fail:  true if unsupported file descriptors should fail by returning false instead
+    //             of throwing an exception
+    // returns: true on success; false if file descriptor type isn't supported and soft_fail == true
+    // throws:  std::system_error or std::bad_alloc on failure
+    bool add_fd_watch(int fd, void *userdata, int flags, bool enabled = true, bool soft_fail = false)
+    {
+        if (soft_fail) {
+            // Regular files and directories can be polled with io_uring (they are always "ready"),
+            // but epoll refuses them and we want the same behaviour (emulation) here.
+            struct stat statbuf;
+            if (fstat(fd, &statbuf) == 0 && (S_ISREG(statbuf.st_mode) || S_ISDIR(statbuf.st_mode))) {
+                return false;
+            }
+        }
+
+        fd_rec &rec = add_rec(fd, userdata, flags);
+        if (enabled) {
+            rec.flags = flags & IO_EVENTS;
+            if (rec.flags != 0) {
+                queue_poll_add(fd, rec);
+            }
+        }
+        return true;
+    }
+
+    bool add_bidi_fd_watch(int fd, void *userdata, int flags, bool emulate)
+    {
+        // No implementation.
+        throw std::system_error(std::make_error_code(std::errc::not_supported));
+    }
+
+    // flags specifies which watch to remove; ignored if the loop doesn't support
+    // separate read/write watches.
+    void remove_fd_watch(int fd, int flags) noexcept
+    {
+        std::lock_guard<decltype(Base::lock)> guard(Base::lock);
+        remove_fd_watch_nolock(fd, flags);
+    }
+
+    void remove_fd_watch_nolock(int fd, int flags) noexcept
+    {
+        fd_rec &rec = fd_recs[fd];
+        if (rec.flags != 0) {
+            queue_poll_remove(fd, rec);
+        }
+        else if (++rec.gen == 0) {
+            rec.gen = 1;
+        }
+        rec.userdata = nullptr;
+    }
+
+    void remove_bidi_fd_watch(int fd) noexcept
+    {
+        // Shouldn't be called for io_uring.
+        remove_fd_watch(fd, IN_EVENTS | OUT_EVENTS);
+    }
+
+    // Note this will *replace* the old flags with the new, that is,
+    // it can enable *or disable* read/write events.
+    void enable_fd_watch(int fd, void *userdata, int flags) noexcept
+    {
+        std::lock_guard<decltype(Base::lock)> guard(Base::lock);
+        enable_fd_watch_nolock(fd, userdata, flags);
+    }
+
+    void enable_fd_watch_nolock(int fd, void *userdata, int flags) noexcept
+    {
+        fd_recs[fd].userdata = userdata;
+        arm_nolock(fd, flags);
+    }
+
+    void disable_fd_watch(int fd, int flags) noexcept
+    {
+        std::lock_guard<decltype(Base::lock)> guard(Base::lock);
+        disable_fd_watch_nolock(fd, flags);
+    }
+
+    void disable_fd_watch_nolock(int fd, int flags) noexcept
+    {
+        fd_rec &rec = fd_recs[fd];
+        if (rec.flags != 0) {
+            queue_poll_remove(fd, rec);
+        }
+    }
+
+    // Note signal should be masked before call.
+    void add_signal_watch(int signo, void *userdata)
+    {
+        std::lock_guard<decltype(Base::lock)> guard(Base::lock);
+        add_signal_watch_nolock(signo, userdata);
+    }
+
+    // Note signal should be masked before call.
+    void add_signal_watch_nolock(int signo, void *userdata)
+    {
+        sigdataMap[signo] = userdata;
+
+        // Modify the signal fd to watch the new signal
+        bool was_no_sigfd = (sigfd == -1);
+        sigaddset(&sigmask, signo);
+        sigfd = signalfd(sigfd, &sigmask, SFD_NONBLOCK | SFD_CLOEXEC);
+        if (sigfd == -1) {
+            throw std::system_error(errno, std::system_category());
+        }
+
+        if (was_no_sigfd) {
+            // Add the signalfd to the ring (as a persistent watch; we pull the signals out as
+            // we see them).
+            try {
+                add_fd_watch(sigfd, &sigfd, IN_EVENTS);
+            }
+            catch (...) {
+                close(sigfd);
+                sigfd = -1;
+                throw;
+            }
+        }
+    }
+
+    // Note, called with lock held:
+    void rearm_signal_watch_nolock(int signo, void *userdata) noexcept
+    {
+        sigaddset(&sigmask, signo);
+        signalfd(sigfd, &sigmask, SFD_NONBLOCK | SFD_CLOEXEC);
+    }
+
+    void remove_signal_watch_nolock(int signo) noexcept
+    {
+        sigdelset(&sigmask, signo);
+        signalfd(sigfd, &sigmask, 0);
+    }
+
+    void remove_signal_watch(int signo) noexcept
+    {
+        std::lock_guard<decltype(Base::lock)> guard(Base::lock);
+        remove_signal_watch_nolock(signo);
+    }
+
+    // If events are pending, process an unspecified number of them.
+    // If no events are pending, wait until one event is received and
+    // process this event (and possibly any other events received
+    // simultaneously).
+    // If processing an event removes a watch, there is a possibility
+    // that the watched event will still be reported (if it has
+    // occurred) before pull_events() returns.
+    //
+    //  do_wait - if false, returns immediately if no events are
+    //            pending.
+    void pull_events(bool do_wait)
+    {
+        unsigned to_submit;
+        {
+            std::lock_guard<decltype(Base::lock)> guard(Base::lock);
+            to_submit = sq_pending();
+            in_wait = do_wait;
+        }
+
+        // Submit any queued requests (re-arms etc) and wait for completions, in a single call:
+        if (to_submit != 0 || do_wait) {
+            int r = sys_io_uring_enter(ring_fd, to_submit, do_wait ? 1 : 0,
+                    do_wait ? IORING_ENTER_GETEVENTS : 0);
+            if (r == -1 && do_wait) {
+                // signal, probably
+                std::lock_guard<decltype(Base::lock)> guard(Base::lock);
+                in_wait = false;
+                return;
+            }
+        }
+
+        process_events();
+    }
+};
+
+} // end namespace
+
+#endif /* DASYNQ_IOURING_H_INCLUDED */
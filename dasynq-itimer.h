@@ -19,6 +19,8 @@ namespace dasynq {
 template <class Base, bool provide_mono_timer = true>
 class itimer_events : public timer_base<Base>
 {
+    using timer_queue_t = typename timer_base<Base>::timer_queue_t;
+
     private:
     
     // Set the alarm timeout to match the first timer in the queue (disable the alarm if there are no
@@ -36,7 +38,7 @@ class itimer_events : public timer_base<Base>
             newtime = timer_queue.get_root_priority();
 
             time_val curtimev;
-            timer_base<Base>::get_time(curtimev, clock_type::SYSTEM, true);
+            timer_base<Base>::get_time_nolock(curtimev, clock_type::SYSTEM, true);
 
             // interval before next timeout:
             if (curtimev < newtime) {
@@ -56,7 +58,7 @@ class itimer_events : public timer_base<Base>
             time_val mono_newtime = mono_timer_queue.get_root_priority();
 
             time_val curtimev_mono;
-            timer_base<Base>::get_time(curtimev_mono, clock_type::MONOTONIC, true);
+            timer_base<Base>::get_time_nolock(curtimev_mono, clock_type::MONOTONIC, true);
 
             time_val interval_mono = {0, 0};
             if (curtimev_mono < mono_newtime) {
@@ -151,14 +153,14 @@ class itimer_events : public timer_base<Base>
         auto &mono_timer_queue = this->queue_for_clock(clock_type::MONOTONIC);
         if (! mono_timer_queue.empty()) {
             struct timespec curtime_mono;
-            timer_base<Base>::get_time(curtime_mono, clock_type::MONOTONIC, true);
+            timer_base<Base>::get_time_nolock(curtime_mono, clock_type::MONOTONIC, true);
             timer_base<Base>::process_timer_queue(mono_timer_queue, curtime_mono);
         }
 
         auto &sys_timer_queue = this->queue_for_clock(clock_type::SYSTEM);
         if (! sys_timer_queue.empty()) {
             struct timespec curtime_sys;
-            timer_base<Base>::get_time(curtime_sys, clock_type::SYSTEM, true);
+            timer_base<Base>::get_time_nolock(curtime_sys, clock_type::SYSTEM, true);
             timer_base<Base>::process_timer_queue(sys_timer_queue, curtime_sys);
         }
     }
@@ -170,7 +172,7 @@ class itimer_events : public timer_base<Base>
         auto &timer_queue = this->queue_for_clock(clock_type::SYSTEM);
         if (! timer_queue.empty()) {
             struct timespec curtime;
-            timer_base<Base>::get_time(curtime, clock_type::SYSTEM, true);
+            timer_base<Base>::get_time_nolock(curtime, clock_type::SYSTEM, true);
             timer_base<Base>::process_timer_queue(timer_queue, curtime);
         }
         
@@ -179,7 +181,7 @@ class itimer_events : public timer_base<Base>
             auto &mono_timer_queue = this->queue_for_clock(clock_type::MONOTONIC);
             if (! mono_timer_queue.empty()) {
                 struct timespec curtime_mono;
-                timer_base<Base>::get_time(curtime_mono, clock_type::MONOTONIC, true);
+                timer_base<Base>::get_time_nolock(curtime_mono, clock_type::MONOTONIC, true);
                 timer_base<Base>::process_timer_queue(mono_timer_queue, curtime_mono);
             }
         }
@@ -214,28 +216,24 @@ class itimer_events : public timer_base<Base>
     //   enable: specifies whether to enable reporting of timeouts/intervals
     void set_timer(timer_handle_t &timer_id, const time_val &timeouttv, const time_val &intervaltv,
             bool enable, clock_type clock = clock_type::MONOTONIC) noexcept
+    {
+        std::lock_guard<decltype(Base::lock)> guard(Base::lock);
+        set_timer_nolock(timer_id, timeouttv, intervaltv, enable, clock);
+    }
+
+    void set_timer_nolock(timer_handle_t &timer_id, const time_val &timeouttv, const time_val &intervaltv,
+            bool enable, clock_type clock = clock_type::MONOTONIC) noexcept
     {
         auto &timer_queue = this->queue_for_clock(clock);
         timespec timeout = timeouttv;
         timespec interval = intervaltv;
 
-        std::lock_guard<decltype(Base::lock)> guard(Base::lock);
-
         auto &ts = timer_queue.node_data(timer_id);
         ts.interval_time = interval;
         ts.expiry_count = 0;
         ts.enabled = enable;
 
-        bool do_set_timer;
-        if (timer_queue.is_queued(timer_id)) {
-            // Already queued; alter timeout
-            do_set_timer = timer_queue.set_priority(timer_id, timeout);
-        }
-        else {
-            do_set_timer = timer_queue.insert(timer_id, timeout);
-        }
-
-        if (do_set_timer) {
+        if (this->queue_timer_nolock(timer_queue, timer_id, timeout)) {
             if (provide_mono_timer) {
                 set_timer_from_queue();
             }
@@ -252,15 +250,17 @@ class itimer_events : public timer_base<Base>
         timespec timeout = timeouttv;
         timespec interval = intervaltv;
 
+        std::lock_guard<decltype(Base::lock)> guard(Base::lock);
+
         struct timespec curtime;
-        timer_base<Base>::get_time(curtime, clock, false);
+        timer_base<Base>::get_time_nolock(curtime, clock, false);
         curtime.tv_sec += timeout.tv_sec;
         curtime.tv_nsec += timeout.tv_nsec;
         if (curtime.tv_nsec > 1000000000) {
             curtime.tv_nsec -= 1000000000;
             curtime.tv_sec++;
         }
-        set_timer(timer_id, curtime, interval, enable, clock);
+        set_timer_nolock(timer_id, curtime, interval, enable, clock);
     }
     
     void stop_timer(timer_handle_t &timer_id, clock_type clock = clock_type::MONOTONIC) noexcept
@@ -68,6 +68,8 @@ class macos_kqueue_traits : public signal_traits
     constexpr static bool has_separate_rw_fd_watches = true;
     constexpr static bool interrupt_after_fd_add = false;
     constexpr static bool supports_non_oneshot_fd = false;
+    constexpr static bool supports_concurrent_polling = false;
+    constexpr static bool supports_edge_triggered = false;
 };
 
 template <class Base> class macos_kqueue_loop : public signal_events<Base, true>
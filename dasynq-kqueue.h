@@ -98,6 +98,8 @@ class kqueue_traits
     constexpr static bool interrupt_after_fd_add = false;
     constexpr static bool interrupt_after_signal_add = false;
     constexpr static bool supports_non_oneshot_fd = false;
+    constexpr static bool supports_concurrent_polling = false;
+    constexpr static bool supports_edge_triggered = true;
 };
 
 namespace dprivate {
@@ -311,7 +313,7 @@ template <class Base> class kqueue_loop : public Base
     
     //        fd:  file descriptor to watch
     //  userdata:  data to associate with descriptor
-    //     flags:  IN_EVENTS | OUT_EVENTS | ONE_SHOT
+    //     flags:  IN_EVENTS | OUT_EVENTS | ONE_SHOT | EDGE_TRIGGERED
     //             (only one of IN_EVENTS/OUT_EVENTS can be specified)
     // soft_fail:  true if unsupported file descriptors should fail by returning false instead
     //             of throwing an exception
@@ -335,8 +337,11 @@ template <class Base> class kqueue_loop : public Base
 
         int fflags = (filter == EVFILT_READ) ? POLL_SEMANTICS : 0;
 
+        // For an edge-triggered watch, EV_CLEAR resets the filter state after each event is retrieved
+        short evflags = EV_ADD | (enabled ? 0 : EV_DISABLE) | ((flags & EDGE_TRIGGERED) ? EV_CLEAR : 0);
+
         struct kevent kev;
-        EV_SET(&kev, fd, filter, EV_ADD | (enabled ? 0 : EV_DISABLE), fflags, 0, userdata);
+        EV_SET(&kev, fd, filter, evflags, fflags, 0, userdata);
         if (kevent(kqfd, &kev, 1, nullptr, 0, nullptr) == -1) {
             // Note that kqueue supports EVFILT_READ on regular file fd's, but not EVFILT_WRITE.
             if (filter == EVFILT_WRITE && errno == EINVAL && emulate) {
@@ -0,0 +1,207 @@
+#ifndef DASYNQ_LOOPGROUP_H_INCLUDED
+#define DASYNQ_LOOPGROUP_H_INCLUDED
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "dasynq.h"
+
+#if DASYNQ_HAVE_PTHREAD_SETAFFINITY
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace dasynq {
+
+// A group of event loops, each run by its own thread. This is an alternative to running a single
+// (thread-safe) event loop from several threads: each loop has its own backend (eg. its own epoll
+// instance and timers), so threads do not contend for a single loop's locks, and a watcher's events
+// are normally processed by the same thread (which can be pinned to a processor).
+//
+// Watchers are distributed amongst the loops by the application, either round-robin (next_loop())
+// or according to some hint (get_loop()). When a thread finds that its own loop has no events
+// pending, it processes events that have been received by other loops in the group but not yet
+// dispatched ("work stealing"), before waiting for events in its own loop. This means that the
+// callbacks for watchers in one loop may be run by any thread in the group.
+//
+// Only one loop in a process may watch child processes; in the group this is child_loop(), and
+// attempts to add a child watch to any other loop in the group fail with std::system_error.
+template <typename Loop = event_loop_th>
+class loop_group
+{
+    static_assert(! std::is_same<typename Loop::mutex_t, null_mutex>::value,
+            "loop_group requires a thread-safe event loop type");
+
+    // Notifier used to wake a loop's thread when the group is stopped:
+    class wake_notifier : public Loop::template notifier_impl<wake_notifier>
+    {
+        public:
+        rearm notified(Loop &eloop)
+        {
+            return rearm::REARM;
+        }
+    };
+
+    struct member
+    {
+        Loop loop;
+        wake_notifier waker;
+    };
+
+    std::vector<std::unique_ptr<member>> members;
+    std::vector<std::thread> threads;
+    std::atomic<unsigned> next_index {0};
+    std::atomic<bool> stopping {false};
+    int steal_limit;
+
+    // Process events queued in another loop (starting with the loop following the given index).
+    // Returns true if any events were processed.
+    bool steal(unsigned index) noexcept
+    {
+        unsigned n = members.size();
+        for (unsigned i = 1; i < n; i++) {
+            if (members[(index + i) % n]->loop.process_queued(steal_limit)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run_thread(unsigned index) noexcept
+    {
+        Loop &loop = members[index]->loop;
+        while (! stopping.load(std::memory_order_acquire)) {
+            if (loop.poll()) continue;
+            if (steal_limit != 0 && steal(index)) continue;
+            loop.run();
+        }
+    }
+
+    // Pin a thread to the processor corresponding to the given index (amongst the processors that
+    // the process may run on). This is best-effort; failure is ignored.
+    static void pin_thread(std::thread &thread, unsigned index) noexcept
+    {
+#if DASYNQ_HAVE_PTHREAD_SETAFFINITY
+        cpu_set_t allowed;
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1) {
+            return;
+        }
+
+        unsigned count = CPU_COUNT(&allowed);
+        if (count == 0) return;
+        index %= count;
+
+        for (unsigned cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                if (index == 0) {
+                    cpu_set_t set;
+                    CPU_ZERO(&set);
+                    CPU_SET(cpu, &set);
+                    pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+                    return;
+                }
+                index--;
+            }
+        }
+#endif
+    }
+
+    public:
+    using loop_t = Loop;
+
+    // Construct a group of event loops. The loops are not run until start() is called.
+    //   num_loops - the number of loops (and threads); 0 for one per processor.
+    //   steal_limit - the maximum number of events that an idle thread processes from another loop
+    //                 before re-checking its own; 0 to disable stealing.
+    // Throws std::system_error or std::bad_alloc on failure.
+    explicit loop_group(unsigned num_loops = 0, int steal_limit_p = 16) : steal_limit(steal_limit_p)
+    {
+        if (num_loops == 0) {
+            num_loops = std::thread::hardware_concurrency();
+            if (num_loops == 0) num_loops = 1;
+        }
+
+        members.reserve(num_loops);
+        for (unsigned i = 0; i < num_loops; i++) {
+            members.emplace_back(new member());
+            members.back()->waker.add_watch(members.back()->loop);
+            if (i != 0) {
+                members.back()->loop.disable_child_watch();
+            }
+        }
+    }
+
+    loop_group(const loop_group &) = delete;
+    loop_group &operator=(const loop_group &) = delete;
+
+    ~loop_group()
+    {
+        stop();
+        for (auto &m : members) {
+            m->waker.deregister(m->loop);
+        }
+    }
+
+    // Start a thread to run each loop, optionally pinning each thread to a processor.
+    // Throws std::system_error on failure (in which case any threads started are stopped).
+    void start(bool pin_threads = true)
+    {
+        stopping.store(false, std::memory_order_relaxed);
+        try {
+            for (unsigned i = 0; i < members.size(); i++) {
+                threads.emplace_back(&loop_group::run_thread, this, i);
+                if (pin_threads) {
+                    pin_thread(threads.back(), i);
+                }
+            }
+        }
+        catch (...) {
+            stop();
+            throw;
+        }
+    }
+
+    // Stop all threads (after they finish processing any current event) and wait for them to exit.
+    // Must not be called from a thread in the group.
+    void stop()
+    {
+        stopping.store(true, std::memory_order_release);
+        for (auto &m : members) {
+            m->waker.notify(m->loop);
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+        threads.clear();
+    }
+
+    unsigned size() const noexcept
+    {
+        return members.size();
+    }
+
+    // Get the loop corresponding to a hint (such as a file descriptor or a connection hash value).
+    Loop &get_loop(unsigned hint) noexcept
+    {
+        return members[hint % members.size()]->loop;
+    }
+
+    // Get the next loop in round-robin order.
+    Loop &next_loop() noexcept
+    {
+        return get_loop(next_index.fetch_add(1, std::memory_order_relaxed));
+    }
+
+    // Get the loop which watches child processes.
+    Loop &child_loop() noexcept
+    {
+        return members[0]->loop;
+    }
+};
+
+} // namespace dasynq
+
+#endif /* DASYNQ_LOOPGROUP_H_INCLUDED */
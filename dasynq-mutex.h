@@ -1,7 +1,9 @@
 #ifndef DASYNQ_MUTEX_H_INCLUDED
 #define DASYNQ_MUTEX_H_INCLUDED
 
+#include <condition_variable>
 #include <mutex>
+#include <thread>
 
 namespace dasynq {
 
@@ -17,6 +19,89 @@ class null_mutex
     DASYNQ_EMPTY_BODY;
 };
 
+// A mutex which, when contended, spins for a bounded time (attempting to acquire the lock, with
+// exponential backoff between attempts) before blocking. When the lock is held only briefly (as for
+// the event loop's internal locks), this usually avoids the cost of the waiting thread sleeping and
+// being woken. Spinning is skipped on a uniprocessor, where it cannot succeed.
+//
+// The mutex wraps a std::mutex, so that a waitqueue_node for a loop using it can use a
+// std::condition_variable (see adaptive_condvar below).
+class adaptive_mutex
+{
+    std::mutex mutex;
+
+    // Number of failed attempts to acquire the lock before blocking, and the maximum number of
+    // "relax" operations between attempts:
+    constexpr static int spin_attempts = 16;
+    constexpr static int max_backoff = 64;
+
+    static bool spin_enabled() noexcept
+    {
+        static const bool multiprocessor = std::thread::hardware_concurrency() > 1;
+        return multiprocessor;
+    }
+
+    public:
+    void lock()
+    {
+        if (mutex.try_lock()) return;
+
+        if (spin_enabled()) {
+            int backoff = 1;
+            for (int i = 0; i < spin_attempts; i++) {
+                for (int j = 0; j < backoff; j++) {
+                    DASYNQ_CPU_RELAX;
+                }
+                if (mutex.try_lock()) return;
+                if (backoff < max_backoff) backoff *= 2;
+            }
+        }
+
+        mutex.lock();
+    }
+
+    bool try_lock()
+    {
+        return mutex.try_lock();
+    }
+
+    void unlock()
+    {
+        mutex.unlock();
+    }
+
+    // Access the underlying mutex:
+    std::mutex &native() noexcept
+    {
+        return mutex;
+    }
+};
+
+// A condition variable for use with adaptive_mutex; it waits using a std::condition_variable on the
+// underlying std::mutex (avoiding the overhead of std::condition_variable_any).
+class adaptive_condvar
+{
+    std::condition_variable condvar;
+
+    public:
+    void notify_one() noexcept
+    {
+        condvar.notify_one();
+    }
+
+    void notify_all() noexcept
+    {
+        condvar.notify_all();
+    }
+
+    void wait(std::unique_lock<adaptive_mutex> &lock)
+    {
+        std::unique_lock<std::mutex> native_lock(lock.mutex()->native(), std::adopt_lock);
+        condvar.wait(native_lock);
+        native_lock.release();
+    }
+};
+
 } // end of namespace
 
 #endif
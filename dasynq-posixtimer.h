@@ -17,17 +17,29 @@ namespace dasynq {
 template <class Base, bool provide_mono_timer = true>
 class posix_timer_events : public timer_base<Base>
 {
+    using timer_queue_t = typename timer_base<Base>::timer_queue_t;
+
+    using alarm_state = typename timer_base<Base>::alarm_state;
+
     private:
     timer_t real_timer;
     timer_t mono_timer;
 
+    alarm_state real_alarm;
+    alarm_state mono_alarm;
+
     // Set the timeout to match the first timer in the queue (disable the timer if there are no
-    // active timers).
-    void set_timer_from_queue(timer_t &timer, timer_queue_t &timer_queue)
+    // active timers). If the timer is already set for a time that is within the slack of the first
+    // timer in the queue, it is left unchanged.
+    void set_timer_from_queue(timer_t &timer, timer_queue_t &timer_queue, alarm_state &alarm)
     {
+        if (! this->update_alarm(timer_queue, alarm)) {
+            return;
+        }
+
         struct itimerspec newalarm;
 
-        if (timer_queue.empty()) {
+        if (! alarm.set) {
             newalarm.it_value = {0, 0};
             newalarm.it_interval = {0, 0};
             timer_settime(timer, TIMER_ABSTIME, &newalarm, nullptr);
@@ -35,10 +47,15 @@ class posix_timer_events : public timer_base<Base>
         }
 
         newalarm.it_interval = {0, 0};
-        newalarm.it_value = timer_queue.get_root_priority();
+        newalarm.it_value = alarm.time;
         timer_settime(timer, TIMER_ABSTIME, &newalarm, nullptr);
     }
 
+    alarm_state &alarm_for_clock(clock_type clock) noexcept
+    {
+        return (clock == clock_type::MONOTONIC) ? mono_alarm : real_alarm;
+    }
+
     protected:
 
     using sigdata_t = typename Base::sigdata_t;
@@ -52,16 +69,21 @@ class posix_timer_events : public timer_base<Base>
         if (siginfo.get_signo() == SIGALRM) {
             time_val curtime;
 
+            // We don't know which timer(s) fired; consider neither to be set any longer, so that
+            // both are reset as appropriate:
+            real_alarm.set = false;
+            mono_alarm.set = false;
+
             if (! real_timer_queue.empty()) {
-                this->get_time(curtime, clock_type::SYSTEM, true);
+                this->get_time_nolock(curtime, clock_type::SYSTEM, true);
                 this->process_timer_queue(real_timer_queue, curtime.get_timespec());
-                set_timer_from_queue(real_timer, real_timer_queue);
+                set_timer_from_queue(real_timer, real_timer_queue, real_alarm);
             }
 
             if (! mono_timer_queue.empty() && provide_mono_timer) {
-                this->get_time(curtime, clock_type::MONOTONIC, true);
+                this->get_time_nolock(curtime, clock_type::MONOTONIC, true);
                 this->process_timer_queue(mono_timer_queue, curtime);
-                set_timer_from_queue(mono_timer, mono_timer_queue);
+                set_timer_from_queue(mono_timer, mono_timer_queue, mono_alarm);
             }
 
             return false; // don't disable signal watch
@@ -124,7 +146,12 @@ class posix_timer_events : public timer_base<Base>
             bool enable, clock_type clock = clock_type::MONOTONIC) noexcept
     {
         std::lock_guard<decltype(Base::lock)> guard(Base::lock);
+        set_timer_nolock(timer_id, timeout, interval, enable, clock);
+    }
 
+    void set_timer_nolock(timer_handle_t &timer_id, const timespec &timeout, const timespec &interval,
+            bool enable, clock_type clock = clock_type::MONOTONIC) noexcept
+    {
         timer_queue_t &timer_queue = this->queue_for_clock(clock);
         timer_t &timer = timer_for_clock(clock);
 
@@ -133,19 +160,9 @@ class posix_timer_events : public timer_base<Base>
         ts.expiry_count = 0;
         ts.enabled = enable;
 
-        if (timer_queue.is_queued(timer_id)) {
-            // Already queued; alter timeout
-            if (timer_queue.set_priority(timer_id, timeout)) {
-                if (clock != clock_type::MONOTONIC || provide_mono_timer) {
-                    set_timer_from_queue(timer, timer_queue);
-                }
-            }
-        }
-        else {
-            if (timer_queue.insert(timer_id, timeout)) {
-                if (clock != clock_type::MONOTONIC || provide_mono_timer) {
-                    set_timer_from_queue(timer, timer_queue);
-                }
+        if (this->queue_timer_nolock(timer_queue, timer_id, timeout)) {
+            if (clock != clock_type::MONOTONIC || provide_mono_timer) {
+                set_timer_from_queue(timer, timer_queue, alarm_for_clock(clock));
             }
         }
     }
@@ -154,15 +171,17 @@ class posix_timer_events : public timer_base<Base>
     void set_timer_rel(timer_handle_t &timer_id, const timespec &timeout, const timespec &interval,
             bool enable, clock_type clock = clock_type::MONOTONIC) noexcept
     {
+        std::lock_guard<decltype(Base::lock)> guard(Base::lock);
+
         struct timespec curtime;
-        this->get_time(curtime, clock, false);
+        this->get_time_nolock(curtime, clock, false);
         curtime.tv_sec += timeout.tv_sec;
         curtime.tv_nsec += timeout.tv_nsec;
         if (curtime.tv_nsec > 1000000000) {
             curtime.tv_nsec -= 1000000000;
             curtime.tv_sec++;
         }
-        set_timer(timer_id, curtime, interval, enable, clock);
+        set_timer_nolock(timer_id, curtime, interval, enable, clock);
     }
 
     void stop_timer(timer_handle_t &timer_id, clock_type clock = clock_type::MONOTONIC) noexcept
@@ -180,7 +199,7 @@ class posix_timer_events : public timer_base<Base>
             bool was_first = (&timer_queue.get_root()) == &timer_id;
             timer_queue.remove(timer_id);
             if (was_first && (clock != clock_type::MONOTONIC || provide_mono_timer)) {
-                set_timer_from_queue(timer, timer_queue);
+                set_timer_from_queue(timer, timer_queue, alarm_for_clock(clock));
             }
         }
     }
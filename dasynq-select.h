@@ -61,6 +61,8 @@ class select_traits : public signal_traits
     constexpr static bool interrupt_after_fd_add = true;
     constexpr static bool interrupt_after_signal_add = true;
     constexpr static bool supports_non_oneshot_fd = false;
+    constexpr static bool supports_concurrent_polling = false;
+    constexpr static bool supports_edge_triggered = false;
 };
 
 template <class Base> class select_events : public signal_events<Base, true>
@@ -0,0 +1,596 @@
+#ifndef DASYNQ_SOAHEAP_H_INCLUDED
+#define DASYNQ_SOAHEAP_H_INCLUDED
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <time.h>
+
+#include "dasynq-config.h"
+#include "dasynq-daryheap.h"
+#include "dasynq-stableheap.h"
+
+#if DASYNQ_HEAP_AVX2
+#include <immintrin.h>
+#elif DASYNQ_HEAP_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace dasynq {
+
+namespace dprivate {
+
+// Select the smallest of a group of (count) contiguous heap priorities, returning its index within the
+// group, by comparing the priorities in turn:
+template <typename P, typename Compare>
+inline unsigned select_min_scalar(const P *children, unsigned count) noexcept
+{
+    Compare lt;
+    unsigned sel = 0;
+    for (unsigned i = 1; i < count; i++) {
+        if (lt(children[i], children[sel])) {
+            sel = i;
+        }
+    }
+    return sel;
+}
+
+// Select the smallest of a group of (count, at most N) children in a heap. This generic version uses
+// select_min_scalar; it is specialised (below, and for time_val in dasynq-timerbase.h) to use SIMD
+// instructions for a full group, if enabled by DASYNQ_HEAP_SSE2 or DASYNQ_HEAP_AVX2.
+template <typename P, typename Compare, unsigned N>
+struct heap_child_select
+{
+    static unsigned select(const P *children, unsigned count) noexcept
+    {
+        return select_min_scalar<P, Compare>(children, count);
+    }
+};
+
+// The SIMD versions (below) handle a full group of children, where N is a multiple of 4. The smallest
+// value is found by reducing the group to a single vector of (element-wise) minimums, and then finding
+// the minimum across the lanes of that vector; its position in the group is then found with one compare
+// (per vector) against the original values and a "movemask" (the first match is chosen).
+constexpr unsigned simd_group_size(unsigned n)
+{
+    return (n % 4 == 0) ? n : 4;
+}
+
+#if DASYNQ_HEAP_SSE2 || DASYNQ_HEAP_AVX2
+
+// Minimum of signed 32-bit values in each lane (pminsd requires SSE4.1):
+inline __m128i min_epi32_sse2(__m128i a, __m128i b) noexcept
+{
+    __m128i lt = _mm_cmplt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(lt, a), _mm_andnot_si128(lt, b));
+}
+
+// Index of the smallest of N (a multiple of 4) int values (the first, if there are several).
+template <unsigned N>
+inline unsigned select_min_i32(const int *vals) noexcept
+{
+    static_assert(N % 4 == 0, "N must be a multiple of 4");
+    constexpr unsigned NV = N / 4;
+
+    __m128i v[NV];
+    __m128i m[NV];
+    for (unsigned i = 0; i < NV; i++) {
+        v[i] = _mm_loadu_si128((const __m128i *)(vals + i * 4));
+        m[i] = v[i];
+    }
+    for (unsigned w = NV; w > 1; w /= 2) {
+        for (unsigned i = 0; i < w / 2; i++) {
+            m[i] = min_epi32_sse2(m[i], m[i + w / 2]);
+        }
+    }
+    __m128i mn = min_epi32_sse2(m[0], _mm_shuffle_epi32(m[0], _MM_SHUFFLE(1, 0, 3, 2)));
+    mn = min_epi32_sse2(mn, _mm_shuffle_epi32(mn, _MM_SHUFFLE(2, 3, 0, 1)));
+
+    unsigned mask = 0;
+    for (unsigned i = 0; i < NV; i++) {
+        mask |= (unsigned)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v[i], mn))) << (i * 4);
+    }
+    return __builtin_ctz(mask);
+}
+
+template <unsigned N>
+struct heap_child_select<int, std::less<int>, N>
+{
+    static unsigned select(const int *children, unsigned count) noexcept
+    {
+        if (N % 4 == 0 && count == N) {
+            return select_min_i32<simd_group_size(N)>(children);
+        }
+        return select_min_scalar<int, std::less<int>>(children, count);
+    }
+};
+
+#endif
+
+#if DASYNQ_HEAP_AVX2
+
+// Minimum of signed 64-bit values in each lane:
+inline __m256i min_epi64_avx2(__m256i a, __m256i b) noexcept
+{
+    return _mm256_blendv_epi8(a, b, _mm256_cmpgt_epi64(a, b));
+}
+
+// Index of the smallest of N (a multiple of 4) unsigned 64-bit values (the first, if there are several).
+template <unsigned N>
+inline unsigned select_min_u64(const uint64_t *vals) noexcept
+{
+    static_assert(N % 4 == 0, "N must be a multiple of 4");
+    constexpr unsigned NV = N / 4;
+
+    // There is no unsigned 64-bit comparison; flip the sign bits so that signed comparison works:
+    const __m256i bias = _mm256_set1_epi64x(std::numeric_limits<int64_t>::min());
+
+    __m256i v[NV];
+    __m256i m[NV];
+    for (unsigned i = 0; i < NV; i++) {
+        v[i] = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(vals + i * 4)), bias);
+        m[i] = v[i];
+    }
+    for (unsigned w = NV; w > 1; w /= 2) {
+        for (unsigned i = 0; i < w / 2; i++) {
+            m[i] = min_epi64_avx2(m[i], m[i + w / 2]);
+        }
+    }
+    __m256i mn = min_epi64_avx2(m[0], _mm256_permute4x64_epi64(m[0], _MM_SHUFFLE(1, 0, 3, 2)));
+    mn = min_epi64_avx2(mn, _mm256_shuffle_epi32(mn, _MM_SHUFFLE(1, 0, 3, 2)));
+
+    unsigned mask = 0;
+    for (unsigned i = 0; i < NV; i++) {
+        mask |= (unsigned)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(v[i], mn))) << (i * 4);
+    }
+    return __builtin_ctz(mask);
+}
+
+// Index of the earliest of N (a multiple of 4) timespec values. As for select_min_u64, but comparing
+// (seconds, nanoseconds) pairs. If there are several equal values, any one of them may be selected.
+template <unsigned N>
+inline unsigned select_min_timespec(const struct timespec *vals) noexcept
+{
+    static_assert(N % 4 == 0, "N must be a multiple of 4");
+    static_assert(sizeof(struct timespec) == 16 && sizeof(time_t) == 8,
+            "timespec must consist of two 64-bit fields");
+    constexpr unsigned NV = N / 4;
+
+    // Lexicographic (seconds, nanoseconds) minimum in each lane:
+    auto min_ts = [](__m256i &ms, __m256i &mn, __m256i ps, __m256i pn) {
+        __m256i gt = _mm256_or_si256(_mm256_cmpgt_epi64(ms, ps),
+                _mm256_and_si256(_mm256_cmpeq_epi64(ms, ps), _mm256_cmpgt_epi64(mn, pn)));
+        ms = _mm256_blendv_epi8(ms, ps, gt);
+        mn = _mm256_blendv_epi8(mn, pn, gt);
+    };
+
+    // Each group of 4 values is split into seconds and nanoseconds, in the order 0, 2, 1, 3:
+    __m256i secs[NV], nsecs[NV];
+    __m256i ms[NV], mn[NV];
+    for (unsigned i = 0; i < NV; i++) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(vals + i * 4));      // s0 n0 s1 n1
+        __m256i b = _mm256_loadu_si256((const __m256i *)(vals + i * 4 + 2));  // s2 n2 s3 n3
+        secs[i] = ms[i] = _mm256_unpacklo_epi64(a, b);   // s0 s2 s1 s3
+        nsecs[i] = mn[i] = _mm256_unpackhi_epi64(a, b);  // n0 n2 n1 n3
+    }
+    for (unsigned w = NV; w > 1; w /= 2) {
+        for (unsigned i = 0; i < w / 2; i++) {
+            min_ts(ms[i], mn[i], ms[i + w / 2], mn[i + w / 2]);
+        }
+    }
+    min_ts(ms[0], mn[0], _mm256_permute4x64_epi64(ms[0], _MM_SHUFFLE(1, 0, 3, 2)),
+            _mm256_permute4x64_epi64(mn[0], _MM_SHUFFLE(1, 0, 3, 2)));
+    min_ts(ms[0], mn[0], _mm256_shuffle_epi32(ms[0], _MM_SHUFFLE(1, 0, 3, 2)),
+            _mm256_shuffle_epi32(mn[0], _MM_SHUFFLE(1, 0, 3, 2)));
+
+    unsigned mask = 0;
+    for (unsigned i = 0; i < NV; i++) {
+        __m256i eq = _mm256_and_si256(_mm256_cmpeq_epi64(secs[i], ms[0]), _mm256_cmpeq_epi64(nsecs[i], mn[0]));
+        mask |= (unsigned)_mm256_movemask_pd(_mm256_castsi256_pd(eq)) << (i * 4);
+    }
+
+    static const unsigned char lane_index[4] = { 0, 2, 1, 3 };
+    unsigned lane = __builtin_ctz(mask);
+    return (lane & ~3u) + lane_index[lane & 3];
+}
+
+// Compact stable priorities (for int) are a single 64-bit key:
+template <unsigned N>
+struct heap_child_select<compact_stable_prio<int, uint32_t>,
+        compare_compact_stable_prio<int, uint32_t, std::less<int>>, N>
+{
+    using P = compact_stable_prio<int, uint32_t>;
+    using Compare = compare_compact_stable_prio<int, uint32_t, std::less<int>>;
+
+    static_assert(sizeof(P) == sizeof(uint64_t), "compact_stable_prio<int,uint32_t> must be a 64-bit key");
+
+    static unsigned select(const P *children, unsigned count) noexcept
+    {
+        if (N % 4 == 0 && count == N) {
+            return select_min_u64<simd_group_size(N)>(&children[0].key);
+        }
+        return select_min_scalar<P, Compare>(children, count);
+    }
+};
+
+#endif
+
+} // namespace dprivate
+
+/**
+ * A d-ary heap (see dary_heap) with a "structure of arrays" layout: node priorities are stored in one
+ * array, and pointers to the node handles in another (parallel) array. The search for the smallest
+ * child when a node moves down the heap therefore reads only priorities, and the array is arranged so
+ * that all N children of a node are adjacent and aligned to N priorities (within a 64-byte aligned
+ * array; so the children share a cache line if N * sizeof(P) divides 64). The search is performed by
+ * dprivate::heap_child_select, which can use SIMD instructions for some priority types, when N is a
+ * multiple of 4 (see DASYNQ_HEAP_SSE2 and DASYNQ_HEAP_AVX2).
+ *
+ * The interface (including the handle type) is identical to that of dary_heap. The priority type must
+ * be trivially copyable.
+ *
+ * Parameters:
+ *
+ * T : node data type
+ * P : priority type (eg int)
+ * Compare : functional object type to compare priorities
+ * N : fan-out factor (number of child nodes per node)
+ * Allocator : allocator for the heap storage (rebound as required; must be default-constructible)
+ */
+template <typename T, typename P, typename Compare = std::less<P>, int N = 4,
+        typename Allocator = std::allocator<char>>
+class soa_dary_heap
+{
+    public:
+    using handle_t = dprivate::queue_handle<T, std::size_t>;
+    using handle_t_r = handle_t &;
+
+    // The same heap type, but using a different allocator (the handle type is unchanged):
+    template <typename A> using rebind_alloc = soa_dary_heap<T, P, Compare, N, A>;
+
+    private:
+
+    static_assert(N > 1, "bad fan-out factor");
+    static_assert(std::is_trivially_copyable<P>::value, "P must be trivially copyable");
+
+    using hindex_t = std::size_t;
+
+    using byte_alloc_t = typename std::allocator_traits<Allocator>::template rebind_alloc<char>;
+    using byte_alloc_traits = std::allocator_traits<byte_alloc_t>;
+    using hnd_alloc_t = typename std::allocator_traits<Allocator>::template rebind_alloc<handle_t *>;
+    using hnd_alloc_traits = std::allocator_traits<hnd_alloc_t>;
+
+    constexpr static std::size_t ALIGN = 64;
+
+    // Node i has its priority at prios[i + N - 1], so that the children of node p (p * N + 1 through
+    // p * N + N) begin at a multiple of N:
+    char *prio_mem = nullptr;   // allocation holding the priority array
+    P *prios = nullptr;
+    handle_t **hnds = nullptr;
+
+    hindex_t size_v = 0;        // number of nodes in the heap
+    hindex_t capacity_v = 0;
+    hindex_t num_nodes = 0;     // number of allocated handles
+
+    P &prio_at(hindex_t i) noexcept
+    {
+        return prios[i + N - 1];
+    }
+
+    static std::size_t prio_mem_size(hindex_t capacity) noexcept
+    {
+        return (capacity + N - 1) * sizeof(P) + ALIGN - 1;
+    }
+
+    // Change the capacity (to at least the current size). Throws std::bad_alloc.
+    void set_capacity(hindex_t new_capacity)
+    {
+        char *new_prio_mem = nullptr;
+        handle_t **new_hnds = nullptr;
+        P *new_prios = nullptr;
+
+        if (new_capacity != 0) {
+            byte_alloc_t byte_alloc;
+            new_prio_mem = byte_alloc_traits::allocate(byte_alloc, prio_mem_size(new_capacity));
+            try {
+                hnd_alloc_t hnd_alloc;
+                new_hnds = hnd_alloc_traits::allocate(hnd_alloc, new_capacity);
+            }
+            catch (...) {
+                byte_alloc_traits::deallocate(byte_alloc, new_prio_mem, prio_mem_size(new_capacity));
+                throw;
+            }
+
+            uintptr_t aligned = ((uintptr_t)new_prio_mem + ALIGN - 1) & ~(uintptr_t)(ALIGN - 1);
+            new_prios = (P *)aligned;
+
+            if (size_v != 0) {
+                std::memcpy(new_prios + N - 1, prios + N - 1, size_v * sizeof(P));
+                std::memcpy(new_hnds, hnds, size_v * sizeof(handle_t *));
+            }
+        }
+
+        free_storage();
+        prio_mem = new_prio_mem;
+        prios = new_prios;
+        hnds = new_hnds;
+        capacity_v = new_capacity;
+    }
+
+    void free_storage() noexcept
+    {
+        if (capacity_v != 0) {
+            byte_alloc_t byte_alloc;
+            byte_alloc_traits::deallocate(byte_alloc, prio_mem, prio_mem_size(capacity_v));
+            hnd_alloc_t hnd_alloc;
+            hnd_alloc_traits::deallocate(hnd_alloc, hnds, capacity_v);
+        }
+    }
+
+    // Bubble a newly added node down to the correct position
+    bool bubble_down(hindex_t pos) noexcept
+    {
+        handle_t * ohndl = hnds[pos];
+        P op = prio_at(pos);
+        return bubble_down(pos, ohndl, op);
+    }
+
+    bool bubble_down(hindex_t pos, handle_t * ohndl, const P &op) noexcept
+    {
+        Compare lt;
+        while (pos > 0) {
+            hindex_t parent = (pos - 1) / N;
+            if (! lt(op, prio_at(parent))) {
+                break;
+            }
+
+            prio_at(pos) = prio_at(parent);
+            hnds[pos] = hnds[parent];
+            hnds[pos]->heap_index = pos;
+            pos = parent;
+        }
+
+        hnds[pos] = ohndl;
+        prio_at(pos) = op;
+        ohndl->heap_index = pos;
+
+        return pos == 0;
+    }
+
+    void bubble_up(hindex_t pos = 0) noexcept
+    {
+        P p = prio_at(pos);
+        handle_t &h = *hnds[pos];
+        bubble_up(pos, h, p);
+    }
+
+    void bubble_up(hindex_t pos, handle_t &h, const P &p) noexcept
+    {
+        Compare lt;
+
+        while (true) {
+            // Find (select) the smallest child node
+            hindex_t lchild = pos * N + 1;
+            if (lchild >= size_v) {
+                break;
+            }
+            unsigned num_children = std::min<hindex_t>(N, size_v - lchild);
+            hindex_t selchild = lchild + dprivate::heap_child_select<P, Compare, N>::select(
+                    &prio_at(lchild), num_children);
+
+            if (! lt(prio_at(selchild), p)) {
+                break;
+            }
+
+            prio_at(pos) = prio_at(selchild);
+            hnds[pos] = hnds[selchild];
+            hnds[pos]->heap_index = pos;
+            pos = selchild;
+        }
+
+        hnds[pos] = &h;
+        prio_at(pos) = p;
+        h.heap_index = pos;
+    }
+
+    void remove_h(hindex_t hidx) noexcept
+    {
+        hnds[hidx]->heap_index = -1;
+        size_v--;
+        if (size_v != hidx) {
+            // Move the last node into the vacated position; it may need to move in either direction.
+            handle_t *lhnd = hnds[size_v];
+            P lprio = prio_at(size_v);
+
+            Compare lt;
+            if (hidx > 0 && lt(lprio, prio_at((hidx - 1) / N))) {
+                bubble_down(hidx, lhnd, lprio);
+            }
+            else {
+                bubble_up(hidx, *lhnd, lprio);
+            }
+        }
+    }
+
+    public:
+
+    // Initialise a handle (if it does not have a suitable constructor). Need not do anything
+    // but may store a sentinel value to mark the handle as inactive. It should not be
+    // necessary to call this, really.
+    static void init_handle(handle_t &h) noexcept
+    {
+    }
+
+    T & node_data(handle_t & index) noexcept
+    {
+        return index.hd_u.hd;
+    }
+
+    // Allocate a slot, but do not incorporate into the heap:
+    //  u... : parameters for data constructor T::T(...)
+    template <typename ...U> void allocate(handle_t & hnd, U&&... u)
+    {
+        constexpr hindex_t max_allowed = (std::numeric_limits<ptrdiff_t>::max() - ALIGN) / sizeof(P) - N;
+
+        if (num_nodes == max_allowed) {
+            throw std::bad_alloc();
+        }
+
+        if (__builtin_expect(capacity_v <= num_nodes, 0)) {
+            hindex_t half_point = max_allowed / 2;
+            try {
+                set_capacity(num_nodes < half_point ? (num_nodes + 1) * 2 : max_allowed);
+            }
+            catch (std::bad_alloc &e) {
+                set_capacity(num_nodes + 1);
+            }
+        }
+
+        new (& hnd.hd_u.hd) T(std::forward<U>(u)...);
+        hnd.heap_index = -1;
+        num_nodes++;
+    }
+
+    // Deallocate a slot
+    void deallocate(handle_t & index) noexcept
+    {
+        num_nodes--;
+        index.hd_u.hd.~T();
+
+        // shrink the capacity if num_nodes is sufficiently less than the current capacity:
+        if (num_nodes < capacity_v / 4) {
+            try {
+                set_capacity(num_nodes * 2);
+            }
+            catch (std::bad_alloc &e) {
+                // ignore: keep the current storage
+            }
+        }
+    }
+
+    bool insert(handle_t & hnd) noexcept
+    {
+        P pval = P();
+        return insert(hnd, pval);
+    }
+
+    bool insert(handle_t & hnd, const P &pval) noexcept
+    {
+        hnd.heap_index = size_v;
+        size_v++;
+        return bubble_down(size_v - 1, &hnd, pval);
+    }
+
+    // Get the root node handle. (Returns a handle_t or reference to handle_t).
+    handle_t & get_root() noexcept
+    {
+        return * hnds[0];
+    }
+
+    P &get_root_priority() noexcept
+    {
+        return prio_at(0);
+    }
+
+    void pull_root() noexcept
+    {
+        remove_h(0);
+    }
+
+    void remove(handle_t & hnd) noexcept
+    {
+        remove_h(hnd.heap_index);
+    }
+
+    bool empty() noexcept
+    {
+        return size_v == 0;
+    }
+
+    bool is_queued(handle_t & hnd) noexcept
+    {
+        return hnd.heap_index != (hindex_t) -1;
+    }
+
+    // Set a node priority. Returns true iff the node becomes the root node (and wasn't before).
+    bool set_priority(handle_t & hnd, const P& p) noexcept
+    {
+        hindex_t heap_index = hnd.heap_index;
+
+        Compare lt;
+        if (lt(prio_at(heap_index), p)) {
+            // Increase key
+            prio_at(heap_index) = p;
+            bubble_up(heap_index);
+            return false;
+        }
+        else {
+            // Decrease key
+            prio_at(heap_index) = p;
+            return bubble_down(heap_index);
+        }
+    }
+
+    // Sort the nodes into priority order (which is also a valid heap), then call f(prio, i) for
+    // each node in turn (with i from 0), which may alter the priority provided that it does not change
+    // the order of the nodes (i.e. f must be order-preserving).
+    template <typename F> void sort_nodes(F f) noexcept
+    {
+        // Sort the handles by priority, then rebuild the priority array from the handle order:
+        P *nprios = prios + N - 1;
+        for (hindex_t i = 0; i < size_v; i++) {
+            hnds[i]->heap_index = i;
+        }
+        Compare lt;
+        std::sort(hnds, hnds + size_v, [&lt, nprios](handle_t *a, handle_t *b) {
+            return lt(nprios[a->heap_index], nprios[b->heap_index]);
+        });
+
+        // Permute the priorities accordingly (following the cycles of the permutation); heap_index
+        // holds the old position of each node:
+        for (hindex_t i = 0; i < size_v; i++) {
+            hindex_t src = hnds[i]->heap_index;
+            if (src == i || src == (hindex_t) -1) {
+                hnds[i]->heap_index = -1;
+                continue;
+            }
+            // Start of a cycle: position i's new priority comes from src, src's from its source, ...
+            P first = nprios[i];
+            hindex_t dst = i;
+            while (src != i) {
+                nprios[dst] = nprios[src];
+                hnds[dst]->heap_index = -1;
+                dst = src;
+                src = hnds[dst]->heap_index;
+            }
+            nprios[dst] = first;
+            hnds[dst]->heap_index = -1;
+        }
+
+        for (hindex_t i = 0; i < size_v; i++) {
+            hnds[i]->heap_index = i;
+            f(nprios[i], i);
+        }
+    }
+
+    soa_dary_heap() { }
+
+    soa_dary_heap(const soa_dary_heap &) = delete;
+
+    ~soa_dary_heap()
+    {
+        free_storage();
+    }
+};
+
+}
+
+#endif
@@ -9,6 +9,8 @@
 // The generation counter is a 64-bit integer and can not realistically overflow.
 
 #include <functional>
+#include <cstdint>
+#include <limits>
 #include <utility>
 
 namespace dasynq {
@@ -118,6 +120,179 @@ class stable_heap : private H<T,stable_prio<P>,compare_stable_prio<P,C>>
     }
 };
 
+// A stable queue with a smaller sequence number than stable_heap: the sequence type S (default
+// uint32_t) can be exhausted, in which case the queued elements are renumbered (in queue order) from
+// 0. The underlying heap H must support sort_nodes() (eg dary_heap); the renumbering is O(n log n) but
+// occurs only once every 2^32 insertions (for uint32_t). The number of queued elements must be less
+// than the maximum value of S.
+//
+// For int priorities, the priority and sequence number are packed into a single 64-bit key (so that a
+// heap node is 16 bytes on 64-bit platforms, rather than 24 bytes for stable_heap) which is compared
+// in one operation.
+
+template <typename P, typename S>
+class compact_stable_prio
+{
+    public:
+    P p;
+    S order;
+
+    compact_stable_prio(S o, const P &p_p) : p(p_p), order(o)
+    {
+    }
+
+    compact_stable_prio()
+    {
+    }
+
+    S get_order() const noexcept
+    {
+        return order;
+    }
+
+    void set_order(S o) noexcept
+    {
+        order = o;
+    }
+};
+
+template <>
+class compact_stable_prio<int, uint32_t>
+{
+    public:
+    // Priority (biased, so that it compares correctly as unsigned) in the upper 32 bits, sequence in the
+    // lower 32:
+    uint64_t key;
+
+    compact_stable_prio(uint32_t o, int p_p)
+        : key((uint64_t((uint32_t)p_p ^ 0x80000000u) << 32) | o)
+    {
+    }
+
+    compact_stable_prio()
+    {
+    }
+
+    uint32_t get_order() const noexcept
+    {
+        return (uint32_t)key;
+    }
+
+    void set_order(uint32_t o) noexcept
+    {
+        key = (key & ~uint64_t(0xFFFFFFFFu)) | o;
+    }
+};
+
+template <typename P, typename S, typename C>
+class compare_compact_stable_prio
+{
+    public:
+    bool operator()(const compact_stable_prio<P,S> &a, const compact_stable_prio<P,S> &b)
+    {
+        C lt;
+        if (lt(a.p, b.p)) {
+            return true;
+        }
+        if (lt(b.p, a.p)) {
+            return false;
+        }
+
+        return a.order < b.order;
+    }
+};
+
+template <>
+class compare_compact_stable_prio<int, uint32_t, std::less<int>>
+{
+    public:
+    bool operator()(const compact_stable_prio<int,uint32_t> &a, const compact_stable_prio<int,uint32_t> &b)
+    {
+        return a.key < b.key;
+    }
+};
+
+template <template <typename H1, typename H2, typename H3> class H, typename T, typename P,
+        typename C = std::less<P>, typename S = uint32_t>
+class compact_stable_heap : private H<T,compact_stable_prio<P,S>,compare_compact_stable_prio<P,S,C>>
+{
+    using Base = H<T,compact_stable_prio<P,S>,compare_compact_stable_prio<P,S,C>>;
+
+    using Base::Base;
+
+    S sequence = 0;
+
+    // Renumber the queued elements from 0, in queue order.
+    void renumber() noexcept
+    {
+        std::size_t count = 0;
+        Base::sort_nodes([&count](compact_stable_prio<P,S> &sp, std::size_t i) {
+            sp.set_order(S(i));
+            count++;
+        });
+        sequence = S(count);
+    }
+
+    public:
+
+    using handle_t = typename Base::handle_t;
+    using handle_t_r = typename Base::handle_t_r;
+
+    bool insert(handle_t & index, P pval = P())
+    {
+        if (__builtin_expect(sequence == std::numeric_limits<S>::max(), 0)) {
+            renumber();
+        }
+        auto sp = compact_stable_prio<P,S>(sequence++, pval);
+        return Base::insert(index, sp);
+    }
+
+    template <typename ...U> void allocate(handle_t & hnd, U&& ...u)
+    {
+        Base::allocate(hnd, std::forward<U>(u)...);
+    }
+
+    static void init_handle(handle_t &hndl)
+    {
+        Base::init_handle(hndl);
+    }
+
+    T &node_data(handle_t &hndl)
+    {
+        return Base::node_data(hndl);
+    }
+
+    bool is_queued(handle_t & hnd)
+    {
+        return Base::is_queued(hnd);
+    }
+
+    decltype(std::declval<Base>().get_root()) get_root()
+    {
+        return Base::get_root();
+    }
+
+    void pull_root()
+    {
+        Base::pull_root();
+    }
+
+    void deallocate(handle_t_r index)
+    {
+        Base::deallocate(index);
+    }
+
+    void remove(handle_t_r hnd)
+    {
+        Base::remove(hnd);
+    }
+
+    bool empty()
+    {
+        return Base::empty();
+    }
+};
+
 } // namespace dasynq
 
 #endif
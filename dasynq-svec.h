@@ -2,6 +2,7 @@
 #define DASYNQ_SVEC_H_INCLUDED
 
 #include <limits>
+#include <memory>
 #include <utility>
 #include <new>
 
@@ -10,10 +11,13 @@
 // The standard vector (std::vector) only allows shrinking a vector's capacity to its current size. In cases
 // where we need to keep some reserved capacity beyond the current size, we need an alternative solution: hence,
 // this class, svector.
+//
+// Storage is obtained from the Allocator (rebound to an internal node type), which is default-constructed
+// as needed (so it should be stateless).
 
 namespace dasynq {
 
-template <typename T>
+template <typename T, typename Allocator = std::allocator<T>>
 class svector
 {
     private:
@@ -23,23 +27,42 @@ class svector
         vec_node() { }
     };
 
+    using node_alloc_t = typename std::allocator_traits<Allocator>::template rebind_alloc<vec_node>;
+    using node_alloc_traits = std::allocator_traits<node_alloc_t>;
+
     vec_node * array;
     size_t size_v;
     size_t capacity_v;
 
+    // Allocate storage for the given number of nodes (the nodes are not constructed; they do not
+    // need to be). Throws std::bad_alloc on failure.
+    static vec_node *alloc_nodes(size_t count)
+    {
+        node_alloc_t alloc;
+        return node_alloc_traits::allocate(alloc, count);
+    }
+
+    static void free_nodes(vec_node *nodes, size_t count) noexcept
+    {
+        if (nodes != nullptr) {
+            node_alloc_t alloc;
+            node_alloc_traits::deallocate(alloc, nodes, count);
+        }
+    }
+
     void check_capacity()
     {
         if (size_v == capacity_v) {
             // double capacity now:
-            if (capacity_v == 0) capacity_v = 1;
-            vec_node * new_array = new vec_node[capacity_v * 2];
+            size_t new_capacity = (capacity_v == 0) ? 2 : capacity_v * 2;
+            vec_node * new_array = alloc_nodes(new_capacity);
             for (size_t i = 0; i < size_v; i++) {
                 new (&new_array[i].elem) T(std::move(array[i].elem));
                 array[i].elem.T::~T();
             }
-            delete[] array;
+            free_nodes(array, capacity_v);
             array = new_array;
-            capacity_v *= 2;
+            capacity_v = new_capacity;
         }
     }
 
@@ -51,13 +74,13 @@ class svector
 
     }
 
-    svector(const svector<T> &other)
+    svector(const svector &other)
     {
         capacity_v = other.size_v;
         size_v = other.size_v;
-        array = new T[capacity_v];
+        array = (capacity_v == 0) ? nullptr : alloc_nodes(capacity_v);
         for (size_t i = 0; i < size_v; i++) {
-            new (&array[i].elem) T(other[i].elem);
+            new (&array[i].elem) T(other[i]);
         }
     }
 
@@ -66,7 +89,7 @@ class svector
         for (size_t i = 0; i < size_v; i++) {
             array[i].elem.T::~T();
         }
-        delete[] array;
+        free_nodes(array, capacity_v);
     }
 
     void push_back(const T &t)
@@ -134,12 +157,12 @@ class svector
     void reserve(size_t amount)
     {
         if (capacity_v < amount) {
-            vec_node * new_array = new vec_node[amount];
+            vec_node * new_array = alloc_nodes(amount);
             for (size_t i = 0; i < size_v; i++) {
                 new (&new_array[i].elem) T(std::move(array[i].elem));
                 array[i].elem.T::~T();
             }
-            delete[] array;
+            free_nodes(array, capacity_v);
             array = new_array;
             capacity_v = amount;
         }
@@ -148,15 +171,20 @@ class svector
     void shrink_to(size_t amount)
     {
         if (capacity_v > amount) {
-            vec_node * new_array = new(std::nothrow) vec_node[amount];
-            if (new_array == nullptr) {
-                return;
+            vec_node * new_array = nullptr;
+            if (amount != 0) {
+                try {
+                    new_array = alloc_nodes(amount);
+                }
+                catch (std::bad_alloc &) {
+                    return;
+                }
             }
             for (size_t i = 0; i < size_v; i++) {
                 new (&new_array[i].elem) T(std::move(array[i].elem));
                 array[i].elem.T::~T();
             }
-            delete[] array;
+            free_nodes(array, capacity_v);
             array = new_array;
             capacity_v = amount;
         }
@@ -1,12 +1,15 @@
 #ifndef DASYNQ_TIMERBASE_H_INCLUDED
 #define DASYNQ_TIMERBASE_H_INCLUDED
 
+#include <type_traits>
 #include <utility>
 #include <mutex>
 
 #include <time.h>
 
 #include "dasynq-daryheap.h"
+#include "dasynq-soaheap.h"
+#include "dasynq-timerwheel.h"
 
 namespace dasynq {
 
@@ -183,11 +186,14 @@ class timer_data
 {
     public:
     time_val interval_time; // interval (if 0, one-off timer)
+    time_val expiry_time;   // time of expiry; the timer is queued at (expiry_time + slack)
+    time_val slack;         // amount by which expiry may be delayed, to coalesce expirations
     int expiry_count;  // number of times expired
     bool enabled;   // whether timer reports events
     void *userdata;
 
-    timer_data(void *udata = nullptr) noexcept : interval_time(0,0), expiry_count(0), enabled(true), userdata(udata)
+    timer_data(void *udata = nullptr) noexcept : interval_time(0,0), expiry_time(0,0), slack(0,0),
+            expiry_count(0), enabled(true), userdata(udata)
     {
         // constructor
     }
@@ -210,9 +216,65 @@ class compare_timespec
     }
 };
 
-using timer_queue_t = dary_heap<timer_data, time_val, compare_timespec>;
+namespace dprivate {
+
+#if DASYNQ_HEAP_AVX2
+
+// Select the earliest of a group of timer expiry times in a soa_dary_heap:
+template <unsigned N>
+struct heap_child_select<time_val, compare_timespec, N>
+{
+    static_assert(sizeof(time_val) == sizeof(struct timespec), "time_val must be a bare timespec");
+
+    static unsigned select(const time_val *children, unsigned count) noexcept
+    {
+        if (N % 4 == 0 && count == N) {
+            return select_min_timespec<simd_group_size(N)>(&children[0].get_timespec());
+        }
+        return select_min_scalar<time_val, compare_timespec>(children, count);
+    }
+};
+
+#endif
+
+} // namespace dprivate
+
+// A timer queue which is a d-ary heap with the specified fan-out, and the default timer queue (with a
+// fan-out of 4). A heap orders timers precisely:
+template <int N = 4>
+using dary_timer_queue_t = dary_heap<timer_data, time_val, compare_timespec, N>;
+using timer_queue_t = dary_timer_queue_t<>;
 using timer_handle_t = timer_queue_t::handle_t;
 
+// An alternative timer queue, a timing wheel with the specified granularity (in nanoseconds), for
+// which arming, re-arming and stopping a timer is O(1). Timers may expire up to one granule late. A
+// loop uses the timer queue specified by the timer_queue_t member of its traits.
+template <unsigned long G = 1000000>
+using timer_wheel_queue_t = timer_wheel<timer_data, time_val, G>;
+
+// Another alternative, a heap with a "structure of arrays" layout (see dasynq-soaheap.h), with the
+// specified fan-out:
+template <int N = 4>
+using soa_timer_queue_t = soa_dary_heap<timer_data, time_val, compare_timespec, N>;
+
+static_assert(std::is_same<timer_wheel_queue_t<>::handle_t, timer_handle_t>::value,
+        "timer queues must share a handle type");
+static_assert(std::is_same<dary_timer_queue_t<16>::handle_t, timer_handle_t>::value,
+        "timer queues must share a handle type");
+static_assert(std::is_same<soa_timer_queue_t<>::handle_t, timer_handle_t>::value,
+        "timer queues must share a handle type");
+
+// Advance a timer queue to the current time. Only a timer wheel needs this.
+template <typename Q> inline void advance_timer_queue(Q &queue, const time_val &now) noexcept
+{
+}
+
+template <typename T, unsigned long G, int L, typename A>
+inline void advance_timer_queue(timer_wheel<T, time_val, G, L, A> &queue, const time_val &now) noexcept
+{
+    queue.advance(now);
+}
+
 static inline void init_timer_handle(timer_handle_t &hnd) noexcept
 {
     timer_queue_t::init_handle(hnd);
@@ -282,6 +344,10 @@ static inline int divide_timespec(const struct timespec &num, const struct times
 
 template <typename Base> class timer_base : public Base
 {
+    protected:
+    // (The queue type from the loop traits, using the loop's allocator; see event_dispatch).
+    using timer_queue_t = typename Base::timer_queue_t;
+
     private:
     timer_queue_t timer_queue;
 
@@ -324,12 +390,18 @@ template <typename Base> class timer_base : public Base
     {
         if (queue.empty()) return;
 
-        // Peek timer queue; calculate difference between current time and timeout
-        const time_val * timeout = &queue.get_root_priority();
         time_val curtime_tv = curtime;
-        while (*timeout <= curtime_tv) {
+        advance_timer_queue(queue, curtime_tv);
+
+        // Timers are queued according to their latest expiry time (including slack); process timers
+        // from the head of the queue until we find one whose (earliest) expiry time has not yet been
+        // reached. This means that timers with slack expire together with any others that are due.
+        do {
             auto & thandle = queue.get_root();
             timer_data &data = queue.node_data(thandle);
+            if (data.expiry_time > curtime_tv) {
+                break;
+            }
             time_val &interval = data.interval_time;
             data.expiry_count++;
             queue.pull_root();
@@ -341,13 +413,10 @@ template <typename Base> class timer_base : public Base
                     data.expiry_count = 0;
                     Base::receive_timer_expiry(thandle, data.userdata, expiry_count);
                 }
-                if (queue.empty()) {
-                    break;
-                }
             }
             else {
                 // First calculate the overrun in time:
-                time_val overrun = time_val(curtime) - time_val(*timeout);
+                time_val overrun = curtime_tv - data.expiry_time;
 
                 // Now we have to divide the time overrun by the period to find the
                 // interval overrun. This requires a division of a value not representable
@@ -356,9 +425,9 @@ template <typename Base> class timer_base : public Base
                 data.expiry_count += divide_timespec(overrun, interval, rem);
 
                 // new time is current time + interval - remainder:
-                time_val newtime = curtime + interval - rem;
+                data.expiry_time = curtime + interval - rem;
 
-                queue.insert(thandle, newtime);
+                queue.insert(thandle, data.expiry_time + data.slack);
                 if (data.enabled) {
                     data.enabled = false;
                     int expiry_count = data.expiry_count;
@@ -368,8 +437,54 @@ template <typename Base> class timer_base : public Base
             }
 
             // repeat until all expired timeouts processed
-            timeout = &queue.get_root_priority();
+        } while (! queue.empty());
+    }
+
+    // Queue a timer to expire at the given time (or, if it is already queued, change its expiry time).
+    // The timer is queued at the expiry time plus its slack. Returns true if the head of the queue may
+    // now expire earlier than it did, in which case the system timer (if any) should be updated.
+    bool queue_timer_nolock(timer_queue_t &queue, timer_handle_t &timer_id, const time_val &timeout) noexcept
+    {
+        timer_data &data = queue.node_data(timer_id);
+        data.expiry_time = timeout;
+        if (queue.is_queued(timer_id)) {
+            return queue.set_priority(timer_id, timeout + data.slack);
+        }
+        else {
+            return queue.insert(timer_id, timeout + data.slack);
+        }
+    }
+
+    // The time for which a system timer (one per queue) has been set, if it has been set. A timer that
+    // has fired remains "set" until the resulting event is received.
+    class alarm_state
+    {
+        public:
+        time_val time;
+        bool set = false;
+    };
+
+    // Determine whether a system timer, set as recorded by alarm, must be reset to match the head of
+    // the queue, and if so update the record. The timer need not be reset if it is set for a time
+    // within the slack window of the timer at the head of the queue (all other timers are queued no
+    // earlier than the end of that window). Returns true if the system timer must be set to
+    // alarm.time, or disabled if alarm.set is false.
+    bool update_alarm(timer_queue_t &queue, alarm_state &alarm) noexcept
+    {
+        if (queue.empty()) {
+            if (! alarm.set) return false;
+            alarm.set = false;
+            return true;
+        }
+
+        const time_val &qtime = queue.get_root_priority();
+        if (alarm.set && alarm.time <= qtime && queue.node_data(queue.get_root()).expiry_time <= alarm.time) {
+            return false;
         }
+
+        alarm.time = qtime;
+        alarm.set = true;
+        return true;
     }
 
     // Process timers based on the current clock time. If any timers have expired,
@@ -380,7 +495,7 @@ template <typename Base> class timer_base : public Base
     {
         timespec now;
         auto &timer_q = this->queue_for_clock(clock);
-        this->get_time(now, clock, true);
+        this->get_time_nolock(now, clock, true);
         if (! timer_q.empty()) {
             const time_val &timeout = timer_q.get_root_priority();
             if (timeout <= now) {
@@ -402,7 +517,7 @@ template <typename Base> class timer_base : public Base
     {
         timespec now;
         auto &timer_q = this->queue_for_clock(clock);
-        this->get_time(now, clock, true);
+        this->get_time_nolock(now, clock, true);
         if (! timer_q.empty()) {
             const time_val &timeout = timer_q.get_root_priority();
             if (timeout <= now) {
@@ -423,7 +538,7 @@ template <typename Base> class timer_base : public Base
     {
         timespec now;
         auto &timer_q = this->queue_for_clock(clock_type::MONOTONIC);
-        this->get_time(now, clock_type::MONOTONIC, true);
+        this->get_time_nolock(now, clock_type::MONOTONIC, true);
         process_timer_queue(timer_q, now);
     }
 
@@ -445,22 +560,15 @@ template <typename Base> class timer_base : public Base
         process_timers(clock_type::MONOTONIC, do_wait, tv, wait_tv);
     }
 
-    public:
-
-    void get_time(time_val &tv, clock_type clock, bool force_update) noexcept
-    {
-        get_time(tv.get_timespec(), clock, force_update);
-    }
-
 #ifdef CLOCK_MONOTONIC
-    void get_time(timespec &ts, clock_type clock, bool force_update) noexcept
+    static void read_clock(timespec &ts, clock_type clock) noexcept
     {
         clockid_t posix_clock_id = (clock == clock_type::MONOTONIC) ? CLOCK_MONOTONIC : CLOCK_REALTIME;
         clock_gettime(posix_clock_id, &ts);
     }
 #else
     // If CLOCK_MONOTONIC is not defined, assume we only have gettimeofday():
-    void get_time(timespec &ts, clock_type clock, bool force_update) noexcept
+    static void read_clock(timespec &ts, clock_type clock) noexcept
     {
         struct timeval curtime_tv;
         gettimeofday(&curtime_tv, nullptr);
@@ -469,11 +577,84 @@ template <typename Base> class timer_base : public Base
     }
 #endif
 
+    // Cached clock times (indexed by clock_index()). Times are cached only while events are being
+    // processed (between begin_time_cache_nolock() and end_time_cache_nolock()), so that a cached time
+    // is never older than the last poll. Protected by Base::lock.
+    timespec cached_time[2];
+    bool cached_time_valid[2] = { false, false };
+    bool time_cache_active = false;
+
+    static int clock_index(clock_type clock) noexcept
+    {
+        return (clock == clock_type::MONOTONIC) ? 0 : 1;
+    }
+
+    public:
+
+    void get_time(time_val &tv, clock_type clock, bool force_update) noexcept
+    {
+        get_time(tv.get_timespec(), clock, force_update);
+    }
+
+    void get_time(timespec &ts, clock_type clock, bool force_update) noexcept
+    {
+        std::lock_guard<decltype(Base::lock)> guard(Base::lock);
+        get_time_nolock(ts, clock, force_update);
+    }
+
+    void get_time_nolock(time_val &tv, clock_type clock, bool force_update) noexcept
+    {
+        get_time_nolock(tv.get_timespec(), clock, force_update);
+    }
+
+    // Get the time for the specified clock; this is the cached time, unless there is no cached time
+    // or force_update is true, in which case the clock is read (and the cached time updated).
+    void get_time_nolock(timespec &ts, clock_type clock, bool force_update) noexcept
+    {
+        int ci = clock_index(clock);
+        if (force_update || ! cached_time_valid[ci]) {
+            read_clock(ts, clock);
+            advance_timer_queue(queue_for_clock(clock), ts);
+            if (time_cache_active) {
+                cached_time[ci] = ts;
+                cached_time_valid[ci] = true;
+            }
+        }
+        else {
+            ts = cached_time[ci];
+        }
+    }
+
+    // Begin caching clock times; the first read of each clock after this will query the system, and
+    // subsequent reads will return the same time. This should be called after each poll for events.
+    void begin_time_cache_nolock() noexcept
+    {
+        cached_time_valid[0] = false;
+        cached_time_valid[1] = false;
+        time_cache_active = true;
+    }
+
+    // Stop caching clock times (and discard any cached times).
+    void end_time_cache_nolock() noexcept
+    {
+        cached_time_valid[0] = false;
+        cached_time_valid[1] = false;
+        time_cache_active = false;
+    }
+
     void add_timer_nolock(timer_handle_t &h, void *userdata, clock_type clock = clock_type::MONOTONIC)
     {
         this->queue_for_clock(clock).allocate(h, userdata);
     }
 
+    // Set the slack for a timer: the amount of time by which its expiry may be delayed, so that it
+    // can expire together with other timers. Takes effect when the timer is next set.
+    void set_timer_slack(timer_handle_t &timer_id, const time_val &slack, clock_type clock = clock_type::MONOTONIC) noexcept
+    {
+        std::lock_guard<decltype(Base::lock)> guard(Base::lock);
+        this->queue_for_clock(clock).node_data(timer_id).slack = slack;
+    }
+
     void remove_timer(timer_handle_t &timer_id, clock_type clock = clock_type::MONOTONIC) noexcept
     {
         std::lock_guard<decltype(Base::lock)> guard(Base::lock);
@@ -21,71 +21,53 @@ namespace dasynq {
 
 template <class Base> class timer_fd_events : public timer_base<Base>
 {
+    using timer_queue_t = typename timer_base<Base>::timer_queue_t;
+
+    using alarm_state = typename timer_base<Base>::alarm_state;
+
     private:
     int timerfd_fd = -1;
     int systemtime_fd = -1;
-    
+
+    alarm_state timerfd_alarm;
+    alarm_state systemtime_alarm;
+
     // Set the timerfd timeout to match the first timer in the queue (disable the timerfd
-    // if there are no active timers).
-    static void set_timer_from_queue(int fd, timer_queue_t &queue) noexcept
+    // if there are no active timers). Unless force is true, if the timerfd is already set for a
+    // time that is within the slack of the first timer, it is left unchanged.
+    void set_timer_from_queue(clock_type clock, bool force = false) noexcept
     {
+        timer_queue_t &queue = this->queue_for_clock(clock);
+        int fd = (clock == clock_type::MONOTONIC) ? timerfd_fd : systemtime_fd;
+        alarm_state &alarm = (clock == clock_type::MONOTONIC) ? timerfd_alarm : systemtime_alarm;
+
+        if (! this->update_alarm(queue, alarm) && ! force) {
+            return;
+        }
+
         struct itimerspec newtime;
-        if (queue.empty()) {
+        if (! alarm.set) {
             newtime.it_value = {0, 0};
             newtime.it_interval = {0, 0};
         }
         else {
-            newtime.it_value = queue.get_root_priority();
+            newtime.it_value = alarm.time;
             newtime.it_interval = {0, 0};
         }
         timerfd_settime(fd, TFD_TIMER_ABSTIME, &newtime, nullptr);
     }
-    
-    void process_timer(clock_type clock, int fd) noexcept
+
+    void process_timer(clock_type clock) noexcept
     {
         timer_queue_t &queue = this->queue_for_clock(clock);
         struct timespec curtime;
-        switch (clock) {
-        case clock_type::SYSTEM:
-            clock_gettime(CLOCK_REALTIME, &curtime);
-            break;
-        case clock_type::MONOTONIC:
-            clock_gettime(CLOCK_MONOTONIC, &curtime);
-            break;
-        default:
-            DASYNQ_UNREACHABLE;
-        }
+        this->get_time_nolock(curtime, clock, true);
 
         timer_base<Base>::process_timer_queue(queue, curtime);
 
-        // arm timerfd with timeout from head of queue
-        set_timer_from_queue(fd, queue);
-    }
-
-    void set_timer(timer_handle_t & timer_id, const time_val &timeouttv, const time_val &intervaltv,
-            timer_queue_t &queue, int fd, bool enable) noexcept
-    {
-        timespec timeout = timeouttv;
-        timespec interval = intervaltv;
-
-        std::lock_guard<decltype(Base::lock)> guard(Base::lock);
-
-        auto &ts = queue.node_data(timer_id);
-        ts.interval_time = interval;
-        ts.expiry_count = 0;
-        ts.enabled = enable;
-
-        if (queue.is_queued(timer_id)) {
-            // Already queued; alter timeout
-            if (queue.set_priority(timer_id, timeout)) {
-                set_timer_from_queue(fd, queue);
-            }
-        }
-        else {
-            if (queue.insert(timer_id, timeout)) {
-                set_timer_from_queue(fd, queue);
-            }
-        }
+        // arm timerfd with timeout from head of queue (this must be done even if the time is
+        // unchanged, since the timerfd otherwise remains readable)
+        set_timer_from_queue(clock, true);
     }
 
     public:
@@ -100,11 +82,11 @@ template <class Base> class timer_fd_events : public timer_base<Base>
     receive_fd_event(T &loop_mech, typename traits_t::fd_r fd_r_a, void * userdata, int flags)
     {
         if (userdata == &timerfd_fd) {
-            process_timer(clock_type::MONOTONIC, timerfd_fd);
+            process_timer(clock_type::MONOTONIC);
             return std::make_tuple(IN_EVENTS, typename traits_t::fd_s(timerfd_fd));
         }
         else if (userdata == &systemtime_fd) {
-            process_timer(clock_type::SYSTEM, systemtime_fd);
+            process_timer(clock_type::SYSTEM);
             if (Base::traits_t::supports_non_oneshot_fd) {
                 return std::make_tuple(0, typename traits_t::fd_s(systemtime_fd));
             }
@@ -148,12 +130,11 @@ template <class Base> class timer_fd_events : public timer_base<Base>
     void stop_timer_nolock(timer_handle_t &timer_id, clock_type clock = clock_type::MONOTONIC) noexcept
     {
         timer_queue_t &queue = this->queue_for_clock(clock);
-        int fd = (clock == clock_type::MONOTONIC) ? timerfd_fd : systemtime_fd;
         if (queue.is_queued(timer_id)) {
             bool was_first = (&queue.get_root()) == &timer_id;
             queue.remove(timer_id);
             if (was_first) {
-                set_timer_from_queue(fd, queue);
+                set_timer_from_queue(clock);
             }
         }
     }
@@ -163,31 +144,36 @@ template <class Base> class timer_fd_events : public timer_base<Base>
     void set_timer(timer_handle_t & timer_id, const time_val &timeouttv, const time_val &intervaltv,
             bool enable, clock_type clock = clock_type::MONOTONIC) noexcept
     {
-        timespec timeout = timeouttv;
-        timespec interval = intervaltv;
+        std::lock_guard<decltype(Base::lock)> guard(Base::lock);
+        set_timer_nolock(timer_id, timeouttv, intervaltv, enable, clock);
+    }
+
+    void set_timer_nolock(timer_handle_t & timer_id, const time_val &timeouttv, const time_val &intervaltv,
+            bool enable, clock_type clock = clock_type::MONOTONIC) noexcept
+    {
         timer_queue_t &queue = this->queue_for_clock(clock);
 
-        switch (clock) {
-        case clock_type::SYSTEM:
-            set_timer(timer_id, timeout, interval, queue, systemtime_fd, enable);
-            break;
-        case clock_type::MONOTONIC:
-            set_timer(timer_id, timeout, interval, queue, timerfd_fd, enable);
-            break;
-        default:
-            DASYNQ_UNREACHABLE;
+        auto &ts = queue.node_data(timer_id);
+        ts.interval_time = intervaltv;
+        ts.expiry_count = 0;
+        ts.enabled = enable;
+
+        if (this->queue_timer_nolock(queue, timer_id, timeouttv)) {
+            set_timer_from_queue(clock);
         }
     }
 
-    // Set timer relative to current time:    
+    // Set timer relative to current time (as cached, see timer_base::get_time_nolock):
     void set_timer_rel(timer_handle_t & timer_id, const time_val &timeout, const time_val &interval,
             bool enable, clock_type clock = clock_type::MONOTONIC) noexcept
     {
+        std::lock_guard<decltype(Base::lock)> guard(Base::lock);
+
         time_val alarmtime;
-        this->get_time(alarmtime, clock, false);
+        this->get_time_nolock(alarmtime, clock, false);
         alarmtime += timeout;
 
-        set_timer(timer_id, alarmtime, interval, enable, clock);
+        set_timer_nolock(timer_id, alarmtime, interval, enable, clock);
     }
     
     ~timer_fd_events()
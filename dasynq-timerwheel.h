@@ -0,0 +1,485 @@
+#ifndef DASYNQ_TIMERWHEEL_H_INCLUDED
+#define DASYNQ_TIMERWHEEL_H_INCLUDED
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+#include "dasynq-svec.h"
+#include "dasynq-daryheap.h"
+
+namespace dasynq {
+
+/**
+ * Priority queue for timers, implemented as a hierarchical timing wheel. Insertion, removal and
+ * changing the priority of a node are O(1); finding the root is O(L) (a bitmap scan per level).
+ * This suits large numbers of timers that are frequently reset and rarely expire (such as idle
+ * timeouts), for which a heap would spend O(log n) on each reset.
+ *
+ * Priorities are times (P must provide seconds() and nseconds() accessors and a (seconds, nseconds)
+ * constructor, i.e. time_val), which are rounded up to a multiple of the granularity G (nanoseconds).
+ * Nodes which expire within the same granule are not ordered relative to each other, and a node is
+ * never reported as expiring before its priority; otherwise the queue is not precise, unlike
+ * dary_heap.
+ *
+ * Implementation details:
+ *
+ * There are L levels, each with 64 slots. A slot at level 0 holds nodes expiring in a single tick
+ * (granule); a slot at level n holds nodes expiring within a range of 8^n ticks. A node is placed
+ * at the lowest level that can hold it, given the current tick of the wheel. The root of the queue
+ * is the earliest non-empty slot, where the time of a slot above level 0 is the start of its range;
+ * when such a slot is the root and the current time reaches it, its nodes are redistributed
+ * ("cascaded") to lower levels. The queue must be advanced to the current time (via advance()) for
+ * this to happen; until then, get_root_priority() may return the time at which the queue next needs
+ * to be advanced, rather than the time at which a node expires. Nodes too far in the future for the
+ * wheel are kept in an unordered overflow list.
+ *
+ * When the priority of a node in a slot above level 0 is set to a time no earlier than the start of
+ * its slot, the node is left in place (rather than being moved to the slot that would now be chosen
+ * for it); it is moved when the slot is cascaded. Re-arming an idle timeout to a later time, which
+ * is the common case, therefore usually touches only the node itself.
+ *
+ * Node data is stored as part of the handle (the same handle type as dary_heap); the handle's index
+ * refers to a node record within the wheel, which is allocated along with the handle.
+ *
+ * Parameters:
+ *
+ * T : node data type
+ * P : priority (time) type
+ * G : granularity, in nanoseconds
+ * L : number of levels (the range of the wheel is 64 * 8^(L-1) ticks)
+ * Allocator : allocator for the node records (rebound as required; must be default-constructible)
+ */
+template <typename T, typename P, unsigned long G = 1000000, int L = 10,
+        typename Allocator = std::allocator<char>>
+class timer_wheel
+{
+    public:
+    using handle_t = dprivate::queue_handle<T, std::size_t>;
+    using handle_t_r = handle_t &;
+
+    // The same wheel type, but using a different allocator (the handle type is unchanged):
+    template <typename A> using rebind_alloc = timer_wheel<T, P, G, L, A>;
+
+    private:
+
+    static_assert(G > 0 && G <= 1000000000, "G must be between 1 and 1000000000 (ns)");
+    static_assert(L > 0 && L <= 19, "L must be between 1 and 19");
+
+    using hindex_t = std::size_t;
+    using tick_t = uint64_t;
+
+    static constexpr int slot_bits = 6;
+    static constexpr int num_slots = 1 << slot_bits;
+    static constexpr int level_bits = 3; // each level covers 8 times the range of the level below
+    static constexpr int overflow_slot = L * num_slots;
+    static constexpr int no_slot = -1;
+    static constexpr hindex_t none = std::numeric_limits<hindex_t>::max();
+    static constexpr tick_t no_tick = std::numeric_limits<tick_t>::max();
+
+    class wheel_node
+    {
+        public:
+        tick_t tick;      // expiry tick
+        handle_t * hnd;
+        hindex_t next;    // next node in slot (or free) list
+        hindex_t prev;    // previous node in slot list
+        int slot;         // slot number, or overflow_slot, or no_slot if not queued
+
+        wheel_node(handle_t * hnd_p) noexcept : tick(0), hnd(hnd_p), next(none), prev(none), slot(no_slot)
+        {
+        }
+
+        wheel_node() { }
+    };
+
+    svector<wheel_node, Allocator> nodes;
+    hindex_t free_head = none;
+    hindex_t num_queued = 0;
+
+    hindex_t slot_heads[L * num_slots + 1];
+    uint64_t occupied[L];  // bitmap of non-empty slots for each level
+
+    // The current tick; no node expires before this, and no slot (above level 0) starts before it.
+    tick_t cur_tick = 0;
+
+    // The tick that the wheel has been advanced to (the current time); slots above level 0 which
+    // start at or before this must be cascaded before they can become the root.
+    tick_t adv_tick = 0;
+
+    // Root slot and its start tick; only valid if root_valid is true.
+    bool root_valid = true;
+    int root_slot = no_slot;
+    tick_t root_start = no_tick;
+    P root_prio;
+
+    // The earliest node in the overflow list; only valid if overflow_min_valid is true.
+    bool overflow_min_valid = true;
+    hindex_t overflow_min = none;
+
+    static tick_t to_tick(const P &p, bool round_up) noexcept
+    {
+        if (p.seconds() < 0) return 0;
+        constexpr tick_t max_secs = std::numeric_limits<tick_t>::max() / 1000000000u - 1;
+        tick_t secs = p.seconds();
+        if (secs > max_secs) secs = max_secs;
+        tick_t ns = secs * 1000000000u + p.nseconds();
+        return round_up ? (ns + (G - 1)) / G : ns / G;
+    }
+
+    static P from_tick(tick_t tick) noexcept
+    {
+        tick_t ns = tick * G;
+        return P(ns / 1000000000u, ns % 1000000000u);
+    }
+
+    // The first tick of a slot's range. Not valid for the overflow slot.
+    tick_t slot_start(int slot) noexcept
+    {
+        int level = slot / num_slots;
+        int shift = level * level_bits;
+        tick_t cur_b = cur_tick >> shift;
+        tick_t b = cur_b + (((slot % num_slots) - cur_b) & (num_slots - 1));
+        if (level == 0) return b;
+        return (b == 0) ? 0 : ((b - 1) << shift) + 1;
+    }
+
+    void link(hindex_t i, int slot) noexcept
+    {
+        wheel_node &n = nodes[i];
+        n.slot = slot;
+        n.prev = none;
+        n.next = slot_heads[slot];
+        if (n.next != none) {
+            nodes[n.next].prev = i;
+        }
+        slot_heads[slot] = i;
+
+        if (slot != overflow_slot) {
+            occupied[slot / num_slots] |= uint64_t(1) << (slot % num_slots);
+        }
+        else if (overflow_min_valid && (overflow_min == none || n.tick < nodes[overflow_min].tick)) {
+            overflow_min = i;
+        }
+    }
+
+    void unlink(hindex_t i) noexcept
+    {
+        wheel_node &n = nodes[i];
+        int slot = n.slot;
+        if (n.prev != none) {
+            nodes[n.prev].next = n.next;
+        }
+        else {
+            slot_heads[slot] = n.next;
+        }
+        if (n.next != none) {
+            nodes[n.next].prev = n.prev;
+        }
+        n.slot = no_slot;
+
+        if (slot != overflow_slot) {
+            if (slot_heads[slot] == none) {
+                occupied[slot / num_slots] &= ~(uint64_t(1) << (slot % num_slots));
+                if (slot == root_slot) root_valid = false;
+            }
+        }
+        else if (slot_heads[overflow_slot] == none) {
+            // (the overflow list is empty; its minimum is trivially known):
+            overflow_min = none;
+            overflow_min_valid = true;
+            if (slot == root_slot) root_valid = false;
+        }
+        else if (i == overflow_min) {
+            overflow_min_valid = false;
+            if (slot == root_slot) root_valid = false;
+        }
+    }
+
+    // Find the appropriate slot for a node with the given tick, according to the current tick.
+    int slot_for(tick_t tick) noexcept
+    {
+        if (tick < cur_tick) tick = cur_tick;
+
+        for (int level = 0; level < L; level++) {
+            int shift = level * level_bits;
+            tick_t b = (tick + ((tick_t(1) << shift) - 1)) >> shift;
+            if (b - (cur_tick >> shift) < (tick_t)num_slots) {
+                return level * num_slots + (b & (num_slots - 1));
+            }
+        }
+
+        return overflow_slot;
+    }
+
+    // Place a node in the specified slot (as determined by slot_for()).
+    void place(hindex_t i, int slot) noexcept
+    {
+        link(i, slot);
+        if (! root_valid) return;
+
+        if (slot != overflow_slot) {
+            tick_t start = slot_start(slot);
+            if (start < root_start) {
+                root_slot = slot;
+                root_start = start;
+                if (slot >= num_slots && start <= adv_tick) {
+                    // needs to be cascaded:
+                    root_valid = false;
+                }
+            }
+        }
+        else if (! overflow_min_valid) {
+            // The overflow minimum is not known, so we can't tell whether this node is the root:
+            root_valid = false;
+        }
+        else if (overflow_min == i && nodes[i].tick < root_start) {
+            root_slot = overflow_slot;
+            root_start = nodes[i].tick;
+        }
+    }
+
+    void place(hindex_t i) noexcept
+    {
+        place(i, slot_for(nodes[i].tick));
+    }
+
+    void find_overflow_min() noexcept
+    {
+        overflow_min = none;
+        for (hindex_t i = slot_heads[overflow_slot]; i != none; i = nodes[i].next) {
+            if (overflow_min == none || nodes[i].tick < nodes[overflow_min].tick) {
+                overflow_min = i;
+            }
+        }
+        overflow_min_valid = true;
+    }
+
+    // Redistribute the nodes in a slot (above level 0) to lower levels. The slot must be the earliest
+    // slot, and its range must have begun.
+    void cascade(int slot, tick_t start) noexcept
+    {
+        cur_tick = start;
+        hindex_t i = slot_heads[slot];
+        slot_heads[slot] = none;
+        occupied[slot / num_slots] &= ~(uint64_t(1) << (slot % num_slots));
+        while (i != none) {
+            hindex_t next = nodes[i].next;
+            place(i);
+            i = next;
+        }
+    }
+
+    void find_root() noexcept
+    {
+        while (true) {
+            root_slot = no_slot;
+            root_start = no_tick;
+
+            for (int level = 0; level < L; level++) {
+                uint64_t occ = occupied[level];
+                if (occ == 0) continue;
+                int shift = level * level_bits;
+                int s0 = (cur_tick >> shift) & (num_slots - 1);
+                uint64_t rotated = (s0 == 0) ? occ : ((occ >> s0) | (occ << (num_slots - s0)));
+                int slot = level * num_slots + ((s0 + __builtin_ctzll(rotated)) & (num_slots - 1));
+                tick_t start = slot_start(slot);
+                if (start < root_start) {
+                    root_slot = slot;
+                    root_start = start;
+                }
+            }
+
+            if (slot_heads[overflow_slot] != none) {
+                if (! overflow_min_valid) find_overflow_min();
+                if (nodes[overflow_min].tick < root_start) {
+                    root_slot = overflow_slot;
+                    root_start = nodes[overflow_min].tick;
+                }
+            }
+
+            if (root_slot < num_slots || root_slot == overflow_slot || root_start > adv_tick) {
+                break;
+            }
+
+            cascade(root_slot, root_start);
+        }
+
+        root_valid = true;
+    }
+
+    tick_t get_root_start() noexcept
+    {
+        if (! root_valid) find_root();
+        return root_start;
+    }
+
+    // Re-place all queued nodes (after the current tick has moved backwards).
+    void rebuild() noexcept
+    {
+        for (int i = 0; i <= overflow_slot; i++) {
+            slot_heads[i] = none;
+        }
+        for (int i = 0; i < L; i++) {
+            occupied[i] = 0;
+        }
+        overflow_min = none;
+        overflow_min_valid = true;
+        root_valid = false;
+
+        for (hindex_t i = 0; i < nodes.size(); i++) {
+            if (nodes[i].slot != no_slot) {
+                place(i);
+            }
+        }
+    }
+
+    public:
+
+    T & node_data(handle_t & hnd) noexcept
+    {
+        return hnd.hd_u.hd;
+    }
+
+    static void init_handle(handle_t &h) noexcept
+    {
+    }
+
+    // Allocate a node, but do not queue it:
+    //  u... : parameters for data constructor T::T(...)
+    template <typename ...U> void allocate(handle_t & hnd, U&&... u)
+    {
+        hindex_t i = free_head;
+        if (i != none) {
+            free_head = nodes[i].next;
+            nodes[i] = wheel_node(&hnd);
+        }
+        else {
+            i = nodes.size();
+            nodes.push_back(wheel_node(&hnd));
+        }
+
+        new (& hnd.hd_u.hd) T(std::forward<U>(u)...);
+        hnd.heap_index = i;
+    }
+
+    // Deallocate a (non-queued) node
+    void deallocate(handle_t & hnd) noexcept
+    {
+        hnd.hd_u.hd.~T();
+        hindex_t i = hnd.heap_index;
+        nodes[i].next = free_head;
+        free_head = i;
+    }
+
+    // Queue a node. Returns true if the root priority of the queue is now earlier than it was.
+    bool insert(handle_t & hnd, const P &pval) noexcept
+    {
+        tick_t old_start = get_root_start();
+        hindex_t i = hnd.heap_index;
+        nodes[i].tick = to_tick(pval, true);
+        place(i);
+        num_queued++;
+        return get_root_start() < old_start;
+    }
+
+    // Get the root node handle: a node in the earliest slot.
+    handle_t & get_root() noexcept
+    {
+        if (! root_valid) find_root();
+        hindex_t i = (root_slot == overflow_slot) ? overflow_min : slot_heads[root_slot];
+        return *nodes[i].hnd;
+    }
+
+    // Get the root priority: the expiry time of the root node, or the time at which the queue must
+    // next be advanced (whichever is earlier).
+    P &get_root_priority() noexcept
+    {
+        root_prio = from_tick(get_root_start());
+        return root_prio;
+    }
+
+    void pull_root() noexcept
+    {
+        remove(get_root());
+    }
+
+    void remove(handle_t & hnd) noexcept
+    {
+        unlink(hnd.heap_index);
+        num_queued--;
+    }
+
+    bool empty() noexcept
+    {
+        return num_queued == 0;
+    }
+
+    bool is_queued(handle_t & hnd) noexcept
+    {
+        return nodes[hnd.heap_index].slot != no_slot;
+    }
+
+    // Set a node priority. Returns true if the root priority of the queue is now earlier than it was.
+    bool set_priority(handle_t & hnd, const P& p) noexcept
+    {
+        tick_t old_start = get_root_start();
+        hindex_t i = hnd.heap_index;
+        tick_t tick = to_tick(p, true);
+        int cur_slot = nodes[i].slot;
+        if (cur_slot >= num_slots && cur_slot != overflow_slot && tick >= slot_start(cur_slot)) {
+            // The node may remain in its (above level 0) slot, since the slot does not start later
+            // than the new expiry; it will be placed correctly when the slot is cascaded.
+            nodes[i].tick = tick;
+            return false;
+        }
+        int slot = slot_for(tick);
+        if (slot == cur_slot && slot != overflow_slot) {
+            // Same slot; no need to move the node
+            nodes[i].tick = tick;
+            return false;
+        }
+        unlink(i);
+        nodes[i].tick = tick;
+        place(i, slot);
+        return get_root_start() < old_start;
+    }
+
+    // Advance the wheel to the specified (current) time. Slots whose range has begun will be cascaded
+    // as necessary. If the time has moved backwards, the wheel is rebuilt (this is O(n)).
+    void advance(const P &now) noexcept
+    {
+        tick_t now_tick = to_tick(now, false);
+        adv_tick = now_tick;
+        root_valid = false;
+
+        if (now_tick < cur_tick) {
+            cur_tick = now_tick;
+            rebuild();
+        }
+
+        // Advance the current tick up to (but not past) the root:
+        tick_t new_tick = std::min(now_tick, get_root_start());
+        if (new_tick > cur_tick) {
+            cur_tick = new_tick;
+        }
+    }
+
+    timer_wheel() noexcept
+    {
+        for (int i = 0; i <= overflow_slot; i++) {
+            slot_heads[i] = none;
+        }
+        for (int i = 0; i < L; i++) {
+            occupied[i] = 0;
+        }
+    }
+
+    timer_wheel(const timer_wheel &) = delete;
+};
+
+}
+
+#endif /* DASYNQ_TIMERWHEEL_H_INCLUDED */
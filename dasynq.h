@@ -5,6 +5,8 @@
 
 #include "dasynq-flags.h"
 #include "dasynq-stableheap.h"
+#include "dasynq-bucketqueue.h"
+#include "dasynq-fifoqueue.h"
 #include "dasynq-interrupt.h"
 #include "dasynq-util.h"
 
@@ -73,6 +75,10 @@
 //                events from receive_fd_event (the event notification function) will leave the descriptor
 //                armed. If false, all fd watches are effectively ONESHOT (they can be re-armed immediately
 //                after delivery by returning an appropriate event flag mask).
+//   supports_edge_triggered
+//              - boolean indicating that fd watches can be edge-triggered (EDGE_TRIGGERED flag). If false,
+//                edge-triggered watches requested via the public API are instead treated as regular
+//                (level-triggered) watches.
 //   full_timer_support
 //              - boolean indicating that the monotonic and system clocks are actually different clocks and
 //                that timers against the system clock will work correctly if the system clock time is
@@ -110,6 +116,14 @@ namespace dasynq {
     using loop_traits_t = kqueue_traits;
 }
 #endif
+#elif DASYNQ_HAVE_IO_URING
+#include "dasynq-iouring.h"
+#include "dasynq-timerfd.h"
+#include "dasynq-childproc.h"
+namespace dasynq {
+    template <typename T> using loop_t = io_uring_loop<interrupt_channel<timer_fd_events<child_proc_events<T>>>>;
+    using loop_traits_t = io_uring_traits;
+}
 #elif DASYNQ_HAVE_EPOLL
 #include "dasynq-epoll.h"
 #include "dasynq-timerfd.h"
@@ -135,40 +149,31 @@ namespace dasynq {
 #endif
 #endif
 
+#include <array>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <cstdint>
 #include <cstddef>
+#include <new>
 #include <system_error>
+#include <utility>
 
 #include <unistd.h>
 #include <fcntl.h>
 
+#if DASYNQ_HAVE_FUTEX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
 #include "dasynq-mutex.h"
+#include "dasynq-affinity.h"
 
 #include "dasynq-basewatchers.h"
 
 namespace dasynq {
 
-/**
- * Values for rearm/disarm return from event handlers
- */
-enum class rearm
-{
-    /** Re-arm the event watcher so that it receives further events */
-    REARM,
-    /** Disarm the event watcher so that it receives no further events, until it is re-armed explicitly */
-    DISARM,
-    /** Leave in current armed/disarmed state */
-    NOOP,
-    /** Remove the event watcher (and call "removed" callback) */
-    REMOVE,
-    /** The watcher has been removed - don't touch it! */
-    REMOVED,
-    /** RE-queue the watcher to have its notification called again */
-    REQUEUE
-};
-
 namespace dprivate {
 
     // Classes for implementing a fair(ish) wait queue.
@@ -179,8 +184,8 @@ namespace dprivate {
     template <typename T_Mutex> class waitqueue_node;
 
     // Select an appropriate condition variable type for a mutex:
-    // condition_variable if mutex is std::mutex, or condition_variable_any
-    // otherwise.
+    // condition_variable if mutex is std::mutex, adaptive_condvar if it is
+    // adaptive_mutex, or condition_variable_any otherwise.
     template <class T_Mutex> class condvar_selector;
 
     template <> class condvar_selector<std::mutex>
@@ -189,6 +194,12 @@ namespace dprivate {
         typedef std::condition_variable condvar;
     };
 
+    template <> class condvar_selector<adaptive_mutex>
+    {
+        public:
+        typedef adaptive_condvar condvar;
+    };
+
     template <class T_Mutex> class condvar_selector
     {
         public:
@@ -203,11 +214,74 @@ namespace dprivate {
         
         public:
         void wait(std::unique_lock<null_mutex> &ul) { }
+        void wait_handoff(std::unique_lock<null_mutex> &ul) { }
         void signal() { }
         
         DASYNQ_EMPTY_BODY;
     };
 
+    // A node is waited on (wait()/wait_handoff()) by its owning thread, and signalled (signal()) by
+    // another thread, both with the mutex held. wait() returns with the mutex re-acquired, possibly
+    // spuriously; the waiter must re-check whatever condition it is waiting for. wait_handoff() returns
+    // only once the node has been signalled (after wait_handoff() was called), and may return without
+    // re-acquiring the mutex: it is used where the signaller hands ownership (of the attention lock) to
+    // the waiter directly, so that the waiter need not re-check anything.
+
+#if DASYNQ_HAVE_FUTEX
+
+    // Linux implementation: the waiter parks on a per-node futex word, which the signaller sets. With
+    // wait_handoff(), the woken thread does not need to re-acquire the mutex (which a thread woken from
+    // a condition variable must do, often immediately contending with the thread that woke it).
+    template <typename T_Mutex> class waitqueue_node
+    {
+        friend class waitqueue<T_Mutex>;
+
+        // ptr to next node in queue, set to null when added to queue tail:
+        waitqueue_node * next;
+
+        // 0 = not signalled, 1 = signalled, 2 = not signalled, waiter is (or is about to be) parked:
+        std::atomic<int> state {0};
+
+        void park() noexcept
+        {
+            int expected = 0;
+            if (! state.compare_exchange_strong(expected, 2, std::memory_order_acquire)) {
+                return;
+            }
+            do {
+                syscall(SYS_futex, &state, FUTEX_WAIT_PRIVATE, 2, nullptr, nullptr, 0);
+            } while (state.load(std::memory_order_acquire) == 2);
+        }
+
+        public:
+        void signal()
+        {
+            // Note that the waiter may return (and the node cease to exist) as soon as the state is
+            // set, before the wake; a wake for a stale address can at worst cause a spurious wakeup
+            // (which all futex waiters must allow for).
+            if (state.exchange(1, std::memory_order_release) == 2) {
+                syscall(SYS_futex, &state, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+            }
+        }
+
+        void wait(std::unique_lock<T_Mutex> &mutex_lock)
+        {
+            state.store(0, std::memory_order_relaxed);
+            mutex_lock.unlock();
+            park();
+            mutex_lock.lock();
+        }
+
+        void wait_handoff(std::unique_lock<T_Mutex> &mutex_lock)
+        {
+            state.store(0, std::memory_order_relaxed);
+            mutex_lock.unlock();
+            park();
+        }
+    };
+
+#else
+
     template <typename T_Mutex> class waitqueue_node
     {
         typename condvar_selector<T_Mutex>::condvar condvar;
@@ -215,10 +289,13 @@ namespace dprivate {
 
         // ptr to next node in queue, set to null when added to queue tail:
         waitqueue_node * next;
+
+        bool signalled = false;
         
         public:
         void signal()
         {
+            signalled = true;
             condvar.notify_one();
         }
         
@@ -226,8 +303,18 @@ namespace dprivate {
         {
             condvar.wait(mutex_lock);
         }
+
+        void wait_handoff(std::unique_lock<T_Mutex> &mutex_lock)
+        {
+            signalled = false;
+            do {
+                condvar.wait(mutex_lock);
+            } while (! signalled);
+        }
     };
 
+#endif
+
     template <> class waitqueue<null_mutex>
     {
         public:
@@ -362,6 +449,13 @@ namespace dprivate {
             loop.process_timer_rearm(btw, rearm_type);
         }
 
+        template <typename Loop>
+        static rearm process_notifier_rearm(Loop &loop, typename Loop::base_notifier *bn,
+                rearm rearm_type) noexcept
+        {
+            return loop.process_notifier_rearm(bn, rearm_type);
+        }
+
         template <typename Loop>
         static void requeue_watcher(Loop &loop, base_watcher *watcher) noexcept
         {
@@ -425,11 +519,23 @@ namespace dprivate {
         public:
         using mutex_t = typename LoopTraits::mutex_t;
         using traits_t = Traits;
+        using allocator_t = typename LoopTraits::allocator_t;
+        using timer_queue_t = typename LoopTraits::timer_queue_t::template rebind_alloc<allocator_t>;
+
+        // Backend event batch sizes (see default_traits::event_batch):
+        constexpr static int event_batch = LoopTraits::event_batch;
+        constexpr static int max_event_batch = LoopTraits::max_event_batch;
+        static_assert(event_batch >= 1 && max_event_batch >= event_batch,
+                "event_batch must be at least 1, and max_event_batch at least event_batch");
 
         private:
 
         // queue data structure/pointer
-        prio_queue event_queue;
+        using event_queue_t = typename std::conditional<LoopTraits::single_priority,
+                basic_fifo_queue<allocator_t>, basic_prio_queue<allocator_t>>::type;
+        static_assert(std::is_same<typename event_queue_t::handle_t, prio_queue::handle_t>::value,
+                "event queue handle type must match base_watcher's heap_handle");
+        event_queue_t event_queue;
         
         using base_signal_watcher = dprivate::base_signal_watcher<typename traits_t::sigdata_t>;
         using base_child_watcher = dprivate::base_child_watcher;
@@ -444,7 +550,8 @@ namespace dprivate {
         
         void queue_watcher(base_watcher *bwatcher) noexcept
         {
-            event_queue.insert(bwatcher->heap_handle, bwatcher->priority);
+            event_queue.insert(bwatcher->heap_handle,
+                    LoopTraits::single_priority ? DEFAULT_PRIORITY : bwatcher->priority);
         }
         
         void dequeue_watcher(base_watcher *bwatcher) noexcept
@@ -454,11 +561,82 @@ namespace dprivate {
             }
         }
 
+        bool is_queued(base_watcher *bwatcher) noexcept
+        {
+            return event_queue.is_queued(bwatcher->heap_handle);
+        }
+
+        bool has_queued_events() noexcept
+        {
+            return ! event_queue.empty();
+        }
+
         // Remove watcher from the queueing system
         void release_watcher(base_watcher *bwatcher) noexcept
         {
             event_queue.deallocate(bwatcher->heap_handle);
         }
+
+        // Allocate (or release) a queue slot which is not associated with a watcher. Slots held this way
+        // keep the queue's storage from shrinking, only to be re-grown, as watchers which are added and
+        // removed frequently (posted tasks) pass through the queue.
+        //   may throw: std::bad_alloc
+        void reserve_queue_slot(prio_queue::handle_t &hnd)
+        {
+            allocate_handle(event_queue, hnd, nullptr);
+        }
+
+        void release_queue_slot(prio_queue::handle_t &hnd) noexcept
+        {
+            event_queue.deallocate(hnd);
+        }
+
+        // An event pulled from the queue for batched dispatch (see event_loop::process_event_batches).
+        // Until its callback is started, the dispatch can be cancelled (by issue_delete), in which case
+        // the dispatching thread skips the entry without touching the watcher.
+        struct batch_entry
+        {
+            enum { PENDING, STARTED, CANCELLED };
+
+            base_watcher *queued;   // the watcher pulled from the queue (for a bidi watcher, may be the secondary)
+            base_watcher *watcher;  // the watcher to dispatch (for a bidi watcher, the main watcher)
+            bool secondary;
+            int arg;
+            rearm rearm_type;
+            std::atomic<int> state;
+        };
+
+        // A batch being dispatched by some thread. Batches are linked into a list so that a watcher's
+        // pending dispatch can be found and cancelled; the list and the entry count are protected by
+        // the lock.
+        struct dispatch_batch_rec
+        {
+            batch_entry *entries;
+            int count;
+            dispatch_batch_rec *next;
+        };
+
+        dispatch_batch_rec *batches = nullptr;
+
+        // Cancel the batched dispatch of a watcher whose callback has not yet started. Returns true if
+        // the dispatch was cancelled (the watcher is then no longer active), or false if the watcher is
+        // not awaiting batched dispatch. Call with lock held.
+        bool cancel_batched(base_watcher *watcher) noexcept
+        {
+            for (dispatch_batch_rec *batch = batches; batch != nullptr; batch = batch->next) {
+                for (int i = 0; i < batch->count; i++) {
+                    batch_entry &entry = batch->entries[i];
+                    if (entry.queued != watcher) continue;
+                    int expected = batch_entry::PENDING;
+                    if (entry.state.compare_exchange_strong(expected, batch_entry::CANCELLED,
+                            std::memory_order_acq_rel)) {
+                        watcher->active = false;
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
         
         protected:
         mutex_t lock;
@@ -493,6 +671,19 @@ namespace dprivate {
             bfdw->event_flags |= flags;
             typename Traits::fd_s watch_fd_s {bfdw->watch_fd};
             
+            if (bfdw->watch_flags & EDGE_TRIGGERED) {
+                // The watch remains armed, so an event may be received while the watcher is already
+                // queued or while its handler is running. In that case we just accumulate the event
+                // flags; the watcher will be re-queued after the handler returns.
+                if (! bfdw->active && ! event_queue.is_queued(bfdw->heap_handle)) {
+                    queue_watcher(bfdw);
+                }
+                if (traits_t::supports_non_oneshot_fd) {
+                    return std::make_tuple(0, watch_fd_s);
+                }
+                return std::make_tuple((bfdw->watch_flags & IO_EVENTS) | EDGE_TRIGGERED, watch_fd_s);
+            }
+
             base_watcher * bwatcher = bfdw;
             
             bool is_multi_watch = bfdw->watch_flags & multi_watch;
@@ -567,9 +758,10 @@ namespace dprivate {
             
             lock.lock();
             
-            if (watcher->active) {
+            if (watcher->active && ! cancel_batched(watcher)) {
                 // If the watcher is active, set deleteme true; the watcher will be removed
-                // at the end of current processing (i.e. when active is set false).
+                // at the end of current processing (i.e. when active is set false). (A watcher
+                // awaiting batched dispatch is not yet processing; its dispatch is cancelled).
                 watcher->deleteme = true;
                 lock.unlock();
             }
@@ -589,7 +781,7 @@ namespace dprivate {
         {
             lock.lock();
             
-            if (watcher->active) {
+            if (watcher->active && ! cancel_batched(watcher)) {
                 watcher->deleteme = true;
                 release_watcher(watcher);
             }
@@ -600,7 +792,7 @@ namespace dprivate {
             }
             
             base_watcher *secondary = &(watcher->out_watcher);
-            if (secondary->active) {
+            if (secondary->active && ! cancel_batched(secondary)) {
                 secondary->deleteme = true;
                 release_watcher(watcher);
             }
@@ -634,7 +826,8 @@ namespace dprivate {
 // loop.
 //
 // The Traits type parameter specifies any required traits for the event loop.  This specifies the back-end
-// to use (backend_t, a template) and the basic back-end traits (backend_traits_t).
+// to use (backend_t, a template), the basic back-end traits (backend_traits_t), and the timer queue type
+// (timer_queue_t).
 // The default is `default_traits<T_Mutex>'.
 //
 template <typename T_Mutex, typename Traits>
@@ -647,6 +840,7 @@ class event_loop
     friend class dprivate::signal_watcher<my_event_loop_t>;
     friend class dprivate::child_proc_watcher<my_event_loop_t>;
     friend class dprivate::timer<my_event_loop_t>;
+    friend class dprivate::notifier<my_event_loop_t>;
     
     friend class dprivate::loop_access;
 
@@ -657,6 +851,15 @@ class event_loop
     using loop_mech_t = typename Traits::template backend_t<dispatch_t>;
     using reaper_mutex_t = typename loop_mech_t::reaper_mutex_t;
 
+    // Whether several threads may poll the backend at once (see default_traits::concurrent_polling):
+    constexpr static bool concurrent_polling = Traits::concurrent_polling;
+    static_assert(! concurrent_polling || backend_traits_t::supports_concurrent_polling,
+            "backend does not support concurrent polling");
+
+    // The maximum number of events dispatched as a batch (see default_traits::dispatch_batch):
+    constexpr static int dispatch_batch = Traits::dispatch_batch;
+    static_assert(dispatch_batch >= 1, "dispatch_batch must be at least 1");
+
     public:
     using traits_t = Traits;
     using loop_traits_t = typename loop_mech_t::traits_t;
@@ -671,10 +874,89 @@ class event_loop
     using base_bidi_fd_watcher = dprivate::base_bidi_fd_watcher;
     using base_child_watcher = dprivate::base_child_watcher;
     using base_timer_watcher = dprivate::base_timer_watcher;
+    using base_notifier = dprivate::base_notifier;
+    using base_posted_task = dprivate::base_posted_task;
     using watch_type_t = dprivate::watch_type_t;
 
+    // The processors to which threads running the loop are restricted, if any. (This is initialised
+    // before loop_mech, so that the backend allocates its structures after the constructing thread
+    // has been restricted).
+    dprivate::loop_placement placement;
+
     loop_mech_t loop_mech;
 
+    // Notifiers which have been notified but not yet queued. This is a lock-free stack, pushed by
+    // notify() (from any thread) and drained (with the lock held) by process_events().
+    std::atomic<base_notifier *> notify_list {nullptr};
+
+    // Tasks which have been posted but not yet queued (lock-free stack, as for notify_list), and tasks
+    // which could not yet be queued due to allocation failure (protected by the lock; in order):
+    std::atomic<base_posted_task *> post_list {nullptr};
+    base_posted_task *post_backlog = nullptr;
+
+    // Pool of blocks for small posted tasks (see default_traits::post_pool_size). Each block holds a
+    // task with a callable of up to post_inline_size bytes:
+    constexpr static std::size_t post_block_size =
+            (sizeof(base_posted_task) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t)
+            * alignof(std::max_align_t)
+            + (Traits::post_inline_size + alignof(std::max_align_t) - 1) / alignof(std::max_align_t)
+            * alignof(std::max_align_t);
+    dprivate::post_pool<typename Traits::allocator_t, post_block_size, Traits::post_pool_size> post_pool;
+
+    // Event queue slots reserved for the tasks in the pool. A task from the pool takes over one of the
+    // reserved slots when it is queued (the slot is released just before the task's own queue node is
+    // allocated, so that the number of allocated nodes, and the queue's storage, is unchanged) and
+    // returns it once it has run. The first post_slots_held slots are currently reserved.
+    std::array<dprivate::prio_queue::handle_t, Traits::post_pool_size> post_queue_slots;
+    std::size_t post_slots_held = 0;
+
+    void reserve_post_queue_slots()
+    {
+        for (auto &slot : post_queue_slots) {
+            loop_mech.reserve_queue_slot(slot);
+            post_slots_held++;
+        }
+    }
+
+    // Allocate the queue node for a posted task, taking over a reserved slot if the task is from the
+    // pool. Call with lock held.
+    //   may throw: std::bad_alloc (for a task from the pool, only if no reserved slot is held)
+    void prepare_task(base_posted_task *pt)
+    {
+        if (post_slots_held != 0 && post_pool.contains(pt)) {
+            loop_mech.release_queue_slot(post_queue_slots[--post_slots_held]);
+        }
+        loop_mech.prepare_watcher(pt);
+    }
+
+    // Release the queue node of a task which has run, returning the slot taken over by a task from the
+    // pool. Call with lock held.
+    void release_task(base_posted_task *pt) noexcept
+    {
+        loop_mech.release_watcher(pt);
+        if (post_slots_held < post_queue_slots.size() && post_pool.contains(pt)) {
+            try {
+                loop_mech.reserve_queue_slot(post_queue_slots[post_slots_held]);
+                post_slots_held++;
+            }
+            catch (std::bad_alloc &) {
+                // (not expected, since a node was just released; the task's successor will allocate)
+            }
+        }
+    }
+
+    // Destroy a posted task which has been dequeued (or was never queued), and free its storage.
+    void discard_task(base_posted_task *pt) noexcept
+    {
+        if (post_pool.contains(pt)) {
+            pt->~base_posted_task();
+            post_pool.release(pt);
+        }
+        else {
+            delete pt;
+        }
+    }
+
     // There is a complex problem with most asynchronous event notification mechanisms
     // when used in a multi-threaded environment. Generally, a file descriptor or other
     // event type that we are watching will be associated with some data used to manage
@@ -729,10 +1011,42 @@ class event_loop
     //    - otherwise, if a poll is in progress, interrupt it
     //    - wait until our node is at the head of the attn_waitqueue
     
+    //
+    // If concurrent polling is enabled (via the traits), any number of threads may poll at once, so
+    // polling is a shared lock and only the attention lock is exclusive. Poll-waiters do not enter the
+    // attn_waitqueue: they poll immediately if the attn_waitqueue is empty, and otherwise wait in the
+    // wait_waitqueue until it becomes empty. The head of the attn_waitqueue holds the attention lock
+    // only once all polling threads have finished (it interrupts them, one at a time, until then).
+    //
+    // With concurrent polling, watchers deregistered via deregister_async (while no thread holds or
+    // wants the attention lock) are reclaimed using epochs, so that neither the deregistering thread
+    // nor polling threads need to wait: a polling thread is counted against the epoch current when
+    // it began polling (there are two epochs, which alternate). A deregistered watcher (whose watch
+    // has already been removed from the backend) is "retired" in the current epoch, and the epoch is
+    // advanced (once any polling threads from the previous epoch have finished). Once the polling
+    // threads counted against the retired watcher's epoch have all finished, no thread can still
+    // receive an event for it, and its deregistration is completed by the last of them.
+    
     mutex_t wait_lock;  // protects the wait/attention queues
     bool long_poll_running = false;  // whether any thread is polling the backend (with non-zero timeout)
     waitqueue<mutex_t> attn_waitqueue;
     waitqueue<mutex_t> wait_waitqueue;
+
+    // (Concurrent polling only): the number of threads polling the backend, and a count incremented
+    // each time the waiting poll-waiters are released.
+    int active_pollers = 0;
+    unsigned poll_grants = 0;
+
+    // (Concurrent polling only): the current epoch, and for each of the two epochs (indexed by epoch
+    // parity) the number of threads polling and the list of retired watchers (linked via next_dereg).
+    unsigned poll_epoch = 0;
+    int epoch_pollers[2] = {0, 0};
+    base_watcher *retired[2] = {nullptr, nullptr};
+
+    // Watchers whose deregistration was requested (via deregister_async) while another thread held the
+    // attention lock; the holder completes their deregistration before releasing the lock. For a
+    // bidi_fd_watcher, the secondary (output) watcher is listed. Protected by wait_lock.
+    base_watcher *dereg_list = nullptr;
     
     mutex_t &get_base_lock() noexcept
     {
@@ -773,14 +1087,28 @@ class event_loop
         release_lock(qnode);
     }
 
+    void deregister_async(base_signal_watcher *callBack, int signo) noexcept
+    {
+        loop_mech.remove_signal_watch(signo);
+        issue_delete_async(callBack);
+    }
+
     void register_fd(base_fd_watcher *callback, int fd, int eventmask, bool enabled, bool emulate = false)
     {
         std::lock_guard<mutex_t> guard(loop_mech.lock);
 
         loop_mech.prepare_watcher(callback);
 
+        if (! backend_traits_t::supports_edge_triggered) {
+            callback->watch_flags &= ~EDGE_TRIGGERED;
+        }
+        callback->edge_disarmed = ! enabled;
+        callback->event_flags = 0;
+
         try {
-            if (! loop_mech.add_fd_watch(fd, callback, eventmask | ONE_SHOT, enabled, emulate)) {
+            int mode = fd_watch_mode(callback->watch_flags);
+            if (! loop_mech.add_fd_watch(fd, callback, (eventmask & IO_EVENTS) | mode, enabled, emulate)) {
+                callback->watch_flags &= ~EDGE_TRIGGERED;
                 callback->emulatefd = true;
                 callback->emulate_enabled = enabled;
                 if (enabled) {
@@ -806,6 +1134,10 @@ class event_loop
     {
         std::lock_guard<mutex_t> guard(loop_mech.lock);
 
+        // Edge-triggered mode is not supported for bidi watchers; they are always level-triggered.
+        eventmask &= ~EDGE_TRIGGERED;
+        callback->watch_flags &= ~EDGE_TRIGGERED;
+
         loop_mech.prepare_watcher(callback);
         try {
             loop_mech.prepare_watcher(&callback->out_watcher);
@@ -868,10 +1200,17 @@ class event_loop
         }
     }
     
+    // Get the backend watch mode flag (EDGE_TRIGGERED or ONE_SHOT) for an fd watch with the given flags.
+    static int fd_watch_mode(int watch_flags) noexcept
+    {
+        return (watch_flags & EDGE_TRIGGERED) ? EDGE_TRIGGERED : ONE_SHOT;
+    }
+
     void set_fd_enabled(base_watcher *watcher, int fd, int watch_flags, bool enabled) noexcept
     {
+        watcher->edge_disarmed = ! enabled;
         if (enabled) {
-            loop_mech.enable_fd_watch(fd, watcher, watch_flags | ONE_SHOT);
+            loop_mech.enable_fd_watch(fd, watcher, (watch_flags & IO_EVENTS) | fd_watch_mode(watch_flags));
             if (backend_traits_t::interrupt_after_fd_add) {
                 interrupt_if_necessary();
             }
@@ -883,8 +1222,9 @@ class event_loop
 
     void set_fd_enabled_nolock(base_watcher *watcher, int fd, int watch_flags, bool enabled) noexcept
     {
+        watcher->edge_disarmed = ! enabled;
         if (enabled) {
-            loop_mech.enable_fd_watch_nolock(fd, watcher, watch_flags | ONE_SHOT);
+            loop_mech.enable_fd_watch_nolock(fd, watcher, (watch_flags & IO_EVENTS) | fd_watch_mode(watch_flags));
             if (backend_traits_t::interrupt_after_fd_add) {
                 interrupt_if_necessary();
             }
@@ -912,6 +1252,18 @@ class event_loop
         
         release_lock(qnode);        
     }
+
+    void deregister_async(base_fd_watcher *callback, int fd) noexcept
+    {
+        if (callback->emulatefd) {
+            auto & ed = (dispatch_t &) loop_mech;
+            ed.issue_delete(callback);
+            return;
+        }
+
+        loop_mech.remove_fd_watch(fd, callback->watch_flags);
+        issue_delete_async(callback);
+    }
     
     void deregister(base_bidi_fd_watcher *callback, int fd) noexcept
     {
@@ -930,6 +1282,18 @@ class event_loop
         
         release_lock(qnode);
     }
+
+    void deregister_async(base_bidi_fd_watcher *callback, int fd) noexcept
+    {
+        if (backend_traits_t::has_separate_rw_fd_watches) {
+            loop_mech.remove_bidi_fd_watch(fd);
+        }
+        else {
+            loop_mech.remove_fd_watch(fd, callback->watch_flags);
+        }
+
+        issue_delete_async(&callback->out_watcher);
+    }
     
     void reserve_child_watch(base_child_watcher *callback)
     {
@@ -949,7 +1313,7 @@ class event_loop
     {
         std::lock_guard<mutex_t> guard(loop_mech.lock);
 
-        loop_mech.unreserve_child_watch(callback->watch_handle);
+        loop_mech.unreserve_child_watch_nolock(callback->watch_handle);
         loop_mech.release_watcher(callback);
     }
     
@@ -988,6 +1352,12 @@ class event_loop
         
         release_lock(qnode);
     }
+
+    void deregister_async(base_child_watcher *callback, pid_t child) noexcept
+    {
+        loop_mech.remove_child_watch(callback->watch_handle);
+        issue_delete_async(callback);
+    }
     
     // Stop watching a child process, but retain watch reservation so that another child can be
     // watched without running into resource allocation issues.
@@ -1033,6 +1403,11 @@ class event_loop
         loop_mech.set_timer_rel(callBack->timer_handle, timeout, interval, true, clock);
     }
 
+    void set_timer_slack(base_timer_watcher *callback, const timespec &slack, clock_type clock) noexcept
+    {
+        loop_mech.set_timer_slack(callback->timer_handle, slack, clock);
+    }
+
     void set_timer_enabled(base_timer_watcher *callback, clock_type clock, bool enabled) noexcept
     {
         loop_mech.enable_timer(callback->timer_handle, enabled, clock);
@@ -1059,125 +1434,502 @@ class event_loop
         
         release_lock(qnode);
     }
-    
-    void dequeue_watcher(base_watcher *watcher) noexcept
-    {
-        loop_mech.dequeue_watcher(watcher);
-    }
 
-    void requeue_watcher(base_watcher *watcher) noexcept
+    void deregister_async(base_timer_watcher *callback, clock_type clock) noexcept
     {
-        loop_mech.queue_watcher(watcher);
-        interrupt_if_necessary();
+        loop_mech.remove_timer(callback->timer_handle, clock);
+        issue_delete_async(callback);
     }
-
-    void release_watcher(base_watcher *watcher) noexcept
+    
+    void register_notifier(base_notifier *callback)
     {
-        loop_mech.release_watcher(watcher);
+        std::lock_guard<mutex_t> guard(loop_mech.lock);
+        loop_mech.prepare_watcher(callback);
+        callback->enabled = true;
+        callback->pending = false;
+        callback->is_notified.store(false, std::memory_order_relaxed);
     }
 
-    // Interrupt the current poll-waiter, if necessary - that is, if the loop is multi-thread safe, and if
-    // there is currently another thread polling the backend event mechanism.
-    void interrupt_if_necessary()
+    // Lock-free and async-signal-safe (assuming lock-free atomics).
+    void notify(base_notifier *callback) noexcept
     {
-        wait_lock.lock();
-        bool attn_q_empty = attn_waitqueue.is_empty(); // (always false for single-threaded loops)
-        wait_lock.unlock();
+        if (callback->is_notified.exchange(true)) {
+            // already notified, and not yet dispatched
+            return;
+        }
 
-        if (! attn_q_empty) {
+        base_notifier *head = notify_list.load(std::memory_order_relaxed);
+        do {
+            callback->next_notified = head;
+        } while (! notify_list.compare_exchange_weak(head, callback, std::memory_order_release,
+                std::memory_order_relaxed));
+
+        if (head == nullptr) {
+            // The list was empty; the loop may be waiting, and needs to be woken so that it will
+            // process the list. (If the list was not empty, this has already been done).
             loop_mech.interrupt_wait();
         }
     }
 
-    // Acquire the attention lock (when held, ensures that no thread is polling the AEN
-    // mechanism). This can be used to safely remove watches, since it is certain that
-    // notification callbacks won't be run while the attention lock is held. Any in-progress
-    // poll will be interrupted so that the lock should be acquired quickly.
-    void get_attn_lock(waitqueue_node<T_Mutex> &qnode) noexcept
+    // Push a task onto the post list; lock-free.
+    void post_task(base_posted_task *task) noexcept
     {
-        std::unique_lock<T_Mutex> ulock(wait_lock);
-        attn_waitqueue.queue(&qnode);        
-        if (! attn_waitqueue.check_head(qnode)) {
-            if (long_poll_running) {
-                // We want to interrupt any in-progress poll so that the attn queue will progress
-                // but we don't want to do that unnecessarily. If we are 2nd in the queue then the
-                // head must be doing the poll; interrupt it. Otherwise, we assume the 2nd has
-                // already interrupted it.
-                if (attn_waitqueue.get_second() == &qnode) {
-                    loop_mech.interrupt_wait();
-                }
-            }
-            while (! attn_waitqueue.check_head(qnode)) {
-                qnode.wait(ulock);
-            }
+        base_posted_task *head = post_list.load(std::memory_order_relaxed);
+        do {
+            task->next_posted = head;
+        } while (! post_list.compare_exchange_weak(head, task, std::memory_order_release,
+                std::memory_order_relaxed));
+
+        if (head == nullptr) {
+            loop_mech.interrupt_wait();
         }
     }
-    
-    // Acquire the attention lock, but without interrupting any poll that's in progress
-    // (prefer to fail in that case).
-    bool poll_attn_lock(waitqueue_node<T_Mutex> &qnode) noexcept
+
+    // Move all tasks from the post list into the event queue. Call with lock held.
+    void drain_post_list() noexcept
     {
-        std::unique_lock<T_Mutex> ulock(wait_lock);
-        if (long_poll_running) {
-            // There are poll-waiters, bail out
-            return false;
+        // The list is in reverse order of posting; reverse it and append it to the backlog:
+        base_posted_task *pt = post_list.exchange(nullptr, std::memory_order_acquire);
+        base_posted_task *fifo = nullptr;
+        while (pt != nullptr) {
+            base_posted_task *next = pt->next_posted;
+            pt->next_posted = fifo;
+            fifo = pt;
+            pt = next;
         }
 
-        // Nobody's doing a long poll, wait until we're at the head of the attn queue and return
-        // success:
-        attn_waitqueue.queue(&qnode);
-        while (! attn_waitqueue.check_head(qnode)) {
-            qnode.wait(ulock);
+        base_posted_task **tailp = &post_backlog;
+        while (*tailp != nullptr) {
+            tailp = &(*tailp)->next_posted;
         }
+        *tailp = fifo;
 
-        return true;
+        while (post_backlog != nullptr) {
+            pt = post_backlog;
+            try {
+                prepare_task(pt);
+            }
+            catch (std::bad_alloc &) {
+                // leave the remaining tasks in the backlog, and try again later
+                return;
+            }
+            post_backlog = pt->next_posted;
+            loop_mech.queue_watcher(pt);
+        }
     }
 
-    // Acquire the poll-wait lock (to be held when polling the AEN mechanism; lower priority than
-    // the attention lock). The poll-wait lock is used to prevent more than a single thread from
-    // polling the event loop mechanism at a time; if this is not done, it is basically
-    // impossible to safely deregister watches.
-    void get_pollwait_lock(waitqueue_node<T_Mutex> &qnode) noexcept
+    // Move all notifiers from the notify list into the event queue (or mark them pending, if they
+    // are currently disabled or active). Call with lock held.
+    void drain_notify_list() noexcept
     {
-        std::unique_lock<T_Mutex> ulock(wait_lock);
-        if (attn_waitqueue.is_empty()) {
-            // Queue is completely empty:
-            attn_waitqueue.queue(&qnode);
-        }
-        else {
-            wait_waitqueue.queue(&qnode);
-        }
-        
-        while (! attn_waitqueue.check_head(qnode)) {
-            qnode.wait(ulock);
+        base_notifier *bn = notify_list.exchange(nullptr, std::memory_order_acquire);
+        while (bn != nullptr) {
+            base_notifier *next = bn->next_notified;
+            if (bn->enabled && ! bn->active) {
+                loop_mech.queue_watcher(bn);
+            }
+            else {
+                bn->pending = true;
+            }
+            bn = next;
         }
-
-        long_poll_running = true;
     }
-    
-    // Release the poll-wait/attention lock.
-    void release_lock(waitqueue_node<T_Mutex> &qnode) noexcept
+
+    void set_notifier_enabled_nolock(base_notifier *callback, bool enabled) noexcept
     {
-        std::unique_lock<T_Mutex> ulock(wait_lock);
-        long_poll_running = false;
-        waitqueue_node<T_Mutex> * nhead = attn_waitqueue.unqueue();
-        if (nhead != nullptr) {
-            // Someone else now owns the lock, signal them to wake them up
-            nhead->signal();
+        callback->enabled = enabled;
+        if (enabled) {
+            if (callback->pending && ! callback->active) {
+                callback->pending = false;
+                requeue_watcher(callback);
+            }
         }
         else {
-            // Nobody is waiting in attn_waitqueue (the high-priority queue) so check in
-            // wait_waitqueue (the low-priority queue)
-            if (! wait_waitqueue.is_empty()) {
-                auto nhead = wait_waitqueue.get_head();
-                wait_waitqueue.unqueue();
-                attn_waitqueue.queue(nhead);
-                long_poll_running = true;
-                nhead->signal();
+            if (loop_mech.is_queued(callback)) {
+                // retain the notification until re-enabled:
+                loop_mech.dequeue_watcher(callback);
+                callback->pending = true;
             }
-        }                
+        }
     }
-    
+
+    void deregister(base_notifier *callback) noexcept
+    {
+        waitqueue_node<T_Mutex> qnode;
+        get_attn_lock(qnode);
+
+        // The notifier might be in the notify list; it must be removed from there before it can be
+        // released:
+        loop_mech.lock.lock();
+        drain_notify_list();
+        loop_mech.lock.unlock();
+
+        loop_mech.issue_delete(callback);
+
+        release_lock(qnode);
+    }
+
+    void deregister_async(base_notifier *callback) noexcept
+    {
+        issue_delete_async(callback);
+    }
+
+    void dequeue_watcher(base_watcher *watcher) noexcept
+    {
+        loop_mech.dequeue_watcher(watcher);
+    }
+
+    void requeue_watcher(base_watcher *watcher) noexcept
+    {
+        loop_mech.queue_watcher(watcher);
+        interrupt_if_necessary();
+    }
+
+    void release_watcher(base_watcher *watcher) noexcept
+    {
+        loop_mech.release_watcher(watcher);
+    }
+
+    // Complete the deregistration of a watcher (whose watch has already been removed from the backend),
+    // that is, remove it from the event queue and issue its watch_removed() callback (or mark it for
+    // removal, if active). For a bidi_fd_watcher, the secondary watcher is specified.
+    void issue_delete_any(base_watcher *watcher) noexcept
+    {
+        dispatch_t & ed = (dispatch_t &) loop_mech;
+        if (watcher->watchType == watch_type_t::SECONDARYFD) {
+            // Get the main watcher (see process_events):
+            uintptr_t rp = (uintptr_t)watcher;
+            _Pragma ("GCC diagnostic push")
+            _Pragma ("GCC diagnostic ignored \"-Winvalid-offsetof\"")
+            rp -= offsetof(base_bidi_fd_watcher, out_watcher);
+            _Pragma ("GCC diagnostic pop")
+            ed.issue_delete((base_bidi_fd_watcher *)rp);
+        }
+        else if (watcher->watchType == watch_type_t::NOTIFIER) {
+            // The notifier might be in the notify list (see deregister(base_notifier *)):
+            loop_mech.lock.lock();
+            drain_notify_list();
+            loop_mech.lock.unlock();
+            ed.issue_delete(watcher);
+        }
+        else {
+            ed.issue_delete(watcher);
+        }
+    }
+
+    // Complete the deregistration of a watcher if the attention lock is immediately available;
+    // otherwise, add the watcher to the deregistration list, so that the deregistration will be
+    // completed by the thread currently holding the lock (when it releases the lock). This avoids
+    // waiting for a polling thread to be interrupted and for the attention lock to be handed over.
+    // With concurrent polling, if threads are polling (and none holds or wants the attention lock),
+    // the watcher is instead retired, to be reclaimed once those threads have finished polling.
+    void issue_delete_async(base_watcher *watcher) noexcept
+    {
+        std::unique_lock<T_Mutex> ulock(wait_lock);
+        if (concurrent_polling && attn_waitqueue.is_empty() && active_pollers != 0) {
+            unsigned cur = poll_epoch & 1;
+            watcher->next_dereg = retired[cur];
+            retired[cur] = watcher;
+            base_watcher *reclaimed = advance_epoch();
+            ulock.unlock();
+            complete_deregistrations(reclaimed);
+            return;
+        }
+
+        if (! attn_waitqueue.is_empty() || active_pollers != 0) {
+            bool was_empty = (dereg_list == nullptr);
+            watcher->next_dereg = dereg_list;
+            dereg_list = watcher;
+            if (was_empty && (long_poll_running || active_pollers != 0)) {
+                // Make sure the deregistration is not delayed indefinitely by a long poll:
+                loop_mech.interrupt_wait();
+            }
+            return;
+        }
+
+        waitqueue_node<T_Mutex> qnode;
+        attn_waitqueue.queue(&qnode);
+        ulock.unlock();
+
+        issue_delete_any(watcher);
+
+        release_lock(qnode);
+    }
+
+    // Complete the deregistration of each watcher in a list (linked via next_dereg).
+    void complete_deregistrations(base_watcher *watcher) noexcept
+    {
+        while (watcher != nullptr) {
+            base_watcher *next = watcher->next_dereg;
+            issue_delete_any(watcher);
+            watcher = next;
+        }
+    }
+
+    // (Concurrent polling only) Advance the epoch, if there are watchers retired in the current epoch
+    // and the previous epoch is finished (no threads still polling in it). If no thread is polling in
+    // the current epoch, the retired watchers can be reclaimed immediately, and are returned (the
+    // caller must complete their deregistration). Otherwise, the polling threads (of whichever epoch
+    // must finish first) are interrupted, so that reclamation will not be delayed indefinitely.
+    // Call with wait_lock held.
+    base_watcher *advance_epoch() noexcept
+    {
+        unsigned cur = poll_epoch & 1;
+        unsigned prev = cur ^ 1;
+        if (retired[cur] == nullptr) {
+            return nullptr;
+        }
+        if (epoch_pollers[prev] != 0) {
+            loop_mech.interrupt_wait();
+            return nullptr;
+        }
+
+        poll_epoch++;
+        if (epoch_pollers[cur] == 0) {
+            base_watcher *reclaimed = retired[cur];
+            retired[cur] = nullptr;
+            return reclaimed;
+        }
+
+        loop_mech.interrupt_wait();
+        return nullptr;
+    }
+
+    // Interrupt the current poll-waiter, if necessary - that is, if the loop is multi-thread safe, and if
+    // there is currently another thread polling the backend event mechanism.
+    void interrupt_if_necessary()
+    {
+        wait_lock.lock();
+        bool attn_q_empty = attn_waitqueue.is_empty(); // (always false for single-threaded loops)
+        bool polling = active_pollers != 0;
+        wait_lock.unlock();
+
+        if (! attn_q_empty || polling) {
+            loop_mech.interrupt_wait();
+        }
+    }
+
+    // Acquire the attention lock (when held, ensures that no thread is polling the AEN
+    // mechanism). This can be used to safely remove watches, since it is certain that
+    // notification callbacks won't be run while the attention lock is held. Any in-progress
+    // poll will be interrupted so that the lock should be acquired quickly.
+    void get_attn_lock(waitqueue_node<T_Mutex> &qnode) noexcept
+    {
+        std::unique_lock<T_Mutex> ulock(wait_lock);
+        attn_waitqueue.queue(&qnode);        
+
+        if (concurrent_polling) {
+            // Wait until we are at the head of the queue and no thread is polling. An interrupt might
+            // wake only one polling thread, so interrupt again each time a polling thread finishes:
+            while (! attn_waitqueue.check_head(qnode) || active_pollers != 0) {
+                if (active_pollers != 0 && attn_waitqueue.check_head(qnode)) {
+                    loop_mech.interrupt_wait();
+                }
+                qnode.wait(ulock);
+            }
+            return;
+        }
+
+        if (! attn_waitqueue.check_head(qnode)) {
+            if (long_poll_running) {
+                // We want to interrupt any in-progress poll so that the attn queue will progress
+                // but we don't want to do that unnecessarily. If we are 2nd in the queue then the
+                // head must be doing the poll; interrupt it. Otherwise, we assume the 2nd has
+                // already interrupted it.
+                if (attn_waitqueue.get_second() == &qnode) {
+                    loop_mech.interrupt_wait();
+                }
+            }
+            // We are signalled only once the lock has been handed to us:
+            qnode.wait_handoff(ulock);
+        }
+    }
+    
+    // Acquire the attention lock, but without interrupting any poll that's in progress
+    // (prefer to fail in that case).
+    bool poll_attn_lock(waitqueue_node<T_Mutex> &qnode, unsigned &epoch) noexcept
+    {
+        if (concurrent_polling) {
+            // Polling is not exclusive; poll (as for a poll-wait) unless the attention lock is wanted:
+            return try_pollwait_lock(qnode, epoch);
+        }
+
+        std::unique_lock<T_Mutex> ulock(wait_lock);
+        if (long_poll_running) {
+            // There are poll-waiters, bail out
+            return false;
+        }
+
+        // Nobody's doing a long poll, wait until we're at the head of the attn queue and return
+        // success:
+        attn_waitqueue.queue(&qnode);
+        if (! attn_waitqueue.check_head(qnode)) {
+            qnode.wait_handoff(ulock);
+        }
+
+        return true;
+    }
+
+    // Acquire the poll-wait lock, but only if it is immediately available (no other thread holds or
+    // is waiting for the poll-wait or attention lock). Returns true if the lock was acquired. With
+    // concurrent polling, the epoch in which polling begins is stored in 'epoch'.
+    bool try_pollwait_lock(waitqueue_node<T_Mutex> &qnode, unsigned &epoch) noexcept
+    {
+        std::unique_lock<T_Mutex> ulock(wait_lock);
+        if (! attn_waitqueue.is_empty()) {
+            return false;
+        }
+
+        if (concurrent_polling) {
+            begin_concurrent_poll(epoch);
+            return true;
+        }
+
+        attn_waitqueue.queue(&qnode);
+        long_poll_running = true;
+        return true;
+    }
+
+    // Check whether any events are queued for processing.
+    bool has_queued_events() noexcept
+    {
+        std::lock_guard<mutex_t> guard(loop_mech.lock);
+        return loop_mech.has_queued_events();
+    }
+
+    // Acquire the poll-wait lock (to be held when polling the AEN mechanism; lower priority than
+    // the attention lock). The poll-wait lock is used to prevent more than a single thread from
+    // polling the event loop mechanism at a time; if this is not done, it is basically
+    // impossible to safely deregister watches.
+    void get_pollwait_lock(waitqueue_node<T_Mutex> &qnode, unsigned &epoch) noexcept
+    {
+        std::unique_lock<T_Mutex> ulock(wait_lock);
+
+        if (concurrent_polling) {
+            if (! attn_waitqueue.is_empty()) {
+                // Wait until released by the (last) holder of the attention lock:
+                unsigned grant = poll_grants;
+                wait_waitqueue.queue(&qnode);
+                do {
+                    qnode.wait(ulock);
+                } while (poll_grants == grant);
+            }
+            begin_concurrent_poll(epoch);
+            return;
+        }
+
+        if (attn_waitqueue.is_empty()) {
+            // Queue is completely empty:
+            attn_waitqueue.queue(&qnode);
+            long_poll_running = true;
+        }
+        else {
+            // Wait until the lock is handed to us (see release_lock, which also sets
+            // long_poll_running):
+            wait_waitqueue.queue(&qnode);
+            qnode.wait_handoff(ulock);
+        }
+    }
+    
+    // Release the poll-wait/attention lock.
+    void release_lock(waitqueue_node<T_Mutex> &qnode) noexcept
+    {
+        std::unique_lock<T_Mutex> ulock(wait_lock);
+
+        // Complete any deregistrations requested while we held the lock:
+        while (dereg_list != nullptr) {
+            base_watcher *watcher = dereg_list;
+            dereg_list = nullptr;
+            ulock.unlock();
+            do {
+                base_watcher *next = watcher->next_dereg;
+                issue_delete_any(watcher);
+                watcher = next;
+            } while (watcher != nullptr);
+            ulock.lock();
+        }
+
+        long_poll_running = false;
+        waitqueue_node<T_Mutex> * nhead = attn_waitqueue.unqueue();
+        if (nhead != nullptr) {
+            // Someone else now owns the lock, signal them to wake them up (with concurrent polling,
+            // they may still need to wait for polling threads to finish; otherwise, ownership is
+            // handed over directly).
+            nhead->signal();
+        }
+        else if (concurrent_polling) {
+            // Release all waiting poll-waiters:
+            poll_grants++;
+            while (! wait_waitqueue.is_empty()) {
+                auto whead = wait_waitqueue.get_head();
+                wait_waitqueue.unqueue();
+                whead->signal();
+            }
+        }
+        else {
+            // Nobody is waiting in attn_waitqueue (the high-priority queue) so check in
+            // wait_waitqueue (the low-priority queue)
+            if (! wait_waitqueue.is_empty()) {
+                auto nhead = wait_waitqueue.get_head();
+                wait_waitqueue.unqueue();
+                attn_waitqueue.queue(nhead);
+                long_poll_running = true;
+                nhead->signal();
+            }
+        }                
+    }
+
+    // (Concurrent polling only) Count the current thread as polling. Call with wait_lock held.
+    void begin_concurrent_poll(unsigned &epoch) noexcept
+    {
+        epoch = poll_epoch;
+        epoch_pollers[epoch & 1]++;
+        active_pollers++;
+    }
+
+    // Release the poll-wait lock, or the attention lock if acquired via poll_attn_lock (as used for
+    // polling). With concurrent polling, 'epoch' is the epoch in which polling began.
+    void release_poll_lock(waitqueue_node<T_Mutex> &qnode, unsigned epoch) noexcept
+    {
+        if (! concurrent_polling) {
+            release_lock(qnode);
+            return;
+        }
+
+        std::unique_lock<T_Mutex> ulock(wait_lock);
+        active_pollers--;
+        unsigned slot = epoch & 1;
+        base_watcher *reclaimed = nullptr;
+        unsigned prev = (poll_epoch & 1) ^ 1;
+        if (--epoch_pollers[slot] == 0 && slot == prev) {
+            // We were the last thread polling in the previous epoch; its retired watchers (if any)
+            // can be reclaimed, and the current epoch can now be advanced:
+            reclaimed = retired[slot];
+            retired[slot] = nullptr;
+            base_watcher *also_reclaimed = advance_epoch();
+            if (also_reclaimed != nullptr) {
+                base_watcher *last = also_reclaimed;
+                while (last->next_dereg != nullptr) last = last->next_dereg;
+                last->next_dereg = reclaimed;
+                reclaimed = also_reclaimed;
+            }
+        }
+        else if (epoch_pollers[prev] != 0 && (retired[0] != nullptr || retired[1] != nullptr)) {
+            // Threads are still polling in the previous epoch, and must finish before retired watchers
+            // can be reclaimed (or the epoch advanced). An interrupt wakes only one polling thread
+            // (which may not be one of them), so interrupt again:
+            loop_mech.interrupt_wait();
+        }
+
+        if (! attn_waitqueue.is_empty()) {
+            // The head of the attention queue is waiting for polling to finish:
+            attn_waitqueue.get_head()->signal();
+        }
+
+        ulock.unlock();
+        complete_deregistrations(reclaimed);
+    }
+    
     void process_signal_rearm(base_signal_watcher * bsw, rearm rearm_type) noexcept
     {
         // Called with lock held
@@ -1213,7 +1965,32 @@ class event_loop
                 }
             }
         }
-        else  if (rearm_type == rearm::REARM) {
+        else if (bfw->watch_flags & EDGE_TRIGGERED) {
+            // An edge-triggered watch stays armed in the backend, so re-arming needs no backend
+            // operation unless the watch was disabled. Events received while the handler was
+            // running are reported by re-queueing the watcher.
+            if (rearm_type == rearm::REARM) {
+                if (bfw->edge_disarmed) {
+                    set_fd_enabled_nolock(bfw, bfw->watch_fd, bfw->watch_flags, true);
+                }
+                else if (bfw->event_flags != 0) {
+                    rearm_type = rearm::REQUEUE;
+                }
+            }
+            else if (rearm_type == rearm::NOOP) {
+                if (! bfw->edge_disarmed && bfw->event_flags != 0) {
+                    rearm_type = rearm::REQUEUE;
+                }
+            }
+            else if (rearm_type == rearm::DISARM) {
+                set_fd_enabled_nolock(bfw, bfw->watch_fd, bfw->watch_flags, false);
+                bfw->event_flags = 0;
+            }
+            else if (rearm_type == rearm::REMOVE) {
+                loop_mech.remove_fd_watch_nolock(bfw->watch_fd, bfw->watch_flags);
+            }
+        }
+        else if (rearm_type == rearm::REARM) {
             set_fd_enabled_nolock(bfw, bfw->watch_fd,
                     bfw->watch_flags & (IN_EVENTS | OUT_EVENTS), true);
         }
@@ -1399,9 +2176,119 @@ class event_loop
         }
     }
 
+    // Process rearm return from a notifier. Called with lock held.
+    rearm process_notifier_rearm(base_notifier *bn, rearm rearm_type) noexcept
+    {
+        if (rearm_type == rearm::REMOVE) {
+            // (the notifier might have been notified again, and be in the notify list)
+            drain_notify_list();
+            return rearm_type;
+        }
+
+        if (rearm_type == rearm::REARM) {
+            bn->enabled = true;
+        }
+        else if (rearm_type == rearm::DISARM) {
+            bn->enabled = false;
+        }
+
+        if (bn->enabled && bn->pending) {
+            bn->pending = false;
+            rearm_type = rearm::REQUEUE;
+        }
+        return rearm_type;
+    }
+
     // Process queued events; returns true if any events were processed.
     //   limit - maximum number of events to process before returning; -1 for
     //           no limit.
+    // Process queued events in batches of up to dispatch_batch (as for process_events; call with
+    // loop_mech.lock held).
+    bool process_event_batches(int limit) noexcept
+    {
+        using batch_entry = typename dispatch_t::batch_entry;
+
+        batch_entry batch[dispatch_batch];
+        bool active = false;
+
+        // Make the batch visible to issue_delete, which may cancel the dispatch of an entry (if a
+        // watcher is deregistered before its callback is started):
+        dispatch_t &ed = (dispatch_t &) loop_mech;
+        typename dispatch_t::dispatch_batch_rec batch_rec { batch, 0, ed.batches };
+        ed.batches = &batch_rec;
+
+        while (limit != 0) {
+            // Take a batch of events from the queue, and prepare each for dispatch:
+            int count = 0;
+            while (count < dispatch_batch && limit != 0) {
+                base_watcher *pqueue = loop_mech.pull_event();
+                if (pqueue == nullptr) break;
+
+                pqueue->active = true;
+                batch_entry &entry = batch[count++];
+                entry.queued = pqueue;
+                entry.state.store(batch_entry::PENDING, std::memory_order_relaxed);
+                if (pqueue->watchType == watch_type_t::SECONDARYFD) {
+                    // the secondary (output) watcher of a bidi watcher; construct a pointer to the
+                    // main watcher (as in process_events):
+                    uintptr_t rp = (uintptr_t)pqueue;
+                    _Pragma ("GCC diagnostic push")
+                    _Pragma ("GCC diagnostic ignored \"-Winvalid-offsetof\"")
+                    rp -= offsetof(base_bidi_fd_watcher, out_watcher);
+                    _Pragma ("GCC diagnostic pop")
+                    entry.watcher = (base_bidi_fd_watcher *)rp;
+                    entry.secondary = true;
+                }
+                else {
+                    entry.watcher = pqueue;
+                    entry.secondary = false;
+                    entry.arg = pqueue->dispatch_prepare(this);
+                    if (limit > 0) limit--;
+                }
+            }
+
+            if (count == 0) break;
+            active = true;
+            batch_rec.count = count;
+
+            // Run the callbacks (skipping any entry cancelled by a deregistration, including one by an
+            // earlier callback in the batch, since the watcher may since have been deleted):
+            loop_mech.lock.unlock();
+            for (int i = 0; i < count; i++) {
+                batch_entry &entry = batch[i];
+                if (entry.state.exchange(batch_entry::STARTED, std::memory_order_acq_rel)
+                        == batch_entry::CANCELLED) {
+                    entry.rearm_type = rearm::REMOVED;
+                    continue;
+                }
+                entry.rearm_type = entry.secondary ? entry.watcher->dispatch_second_callback(this)
+                        : entry.watcher->dispatch_callback(this, entry.arg);
+            }
+            loop_mech.lock.lock();
+
+            // Process the results:
+            batch_rec.count = 0;
+            for (int i = 0; i < count; i++) {
+                batch_entry &entry = batch[i];
+                if (entry.rearm_type == rearm::REMOVED) continue;
+                if (entry.secondary) {
+                    entry.watcher->dispatch_second_complete(this, entry.rearm_type);
+                }
+                else {
+                    entry.watcher->dispatch_complete(this, entry.rearm_type);
+                }
+            }
+        }
+
+        auto **link = &ed.batches;
+        while (*link != &batch_rec) {
+            link = &(*link)->next;
+        }
+        *link = batch_rec.next;
+
+        return active;
+    }
+
     bool process_events(int limit) noexcept
     {
         loop_mech.lock.lock();
@@ -1409,7 +2296,24 @@ class event_loop
         if (limit == 0) {
             return false;
         }
+
+        // Clock reads while processing the events from the last poll use a single (cached) time:
+        loop_mech.begin_time_cache_nolock();
+
+        if (notify_list.load(std::memory_order_relaxed) != nullptr) {
+            drain_notify_list();
+        }
+        if (post_list.load(std::memory_order_relaxed) != nullptr || post_backlog != nullptr) {
+            drain_post_list();
+        }
         
+        if (dispatch_batch > 1) {
+            bool active = process_event_batches(limit);
+            loop_mech.end_time_cache_nolock();
+            loop_mech.lock.unlock();
+            return active;
+        }
+
         base_watcher * pqueue = loop_mech.pull_event();
         bool active = false;
         
@@ -1450,10 +2354,27 @@ class event_loop
             pqueue = loop_mech.pull_event();
         }
         
+        loop_mech.end_time_cache_nolock();
         loop_mech.lock.unlock();
         return active;
     }
 
+    // Wait for and process events, until at least one event (up to the limit) has been processed.
+    void wait_and_process(waitqueue_node<T_Mutex> &qnode, unsigned &epoch, int limit) noexcept
+    {
+        while (! process_events(limit)) {
+            // Pull events from the AEN mechanism and insert them in our internal queue. However, if
+            // another thread has queued events while we were waiting for the poll-wait lock, don't
+            // wait for further events: instead, help to process the queued events. This allows any
+            // number of threads to dispatch events in parallel.
+            get_pollwait_lock(qnode, epoch);
+            if (! has_queued_events()) {
+                loop_mech.pull_events(true);
+            }
+            release_poll_lock(qnode, epoch);
+        }
+    }
+
     public:
     
     using fd_watcher = dprivate::fd_watcher<my_event_loop_t>;
@@ -1461,41 +2382,93 @@ class event_loop
     using signal_watcher = dprivate::signal_watcher<my_event_loop_t>;
     using child_proc_watcher = dprivate::child_proc_watcher<my_event_loop_t>;
     using timer = dprivate::timer<my_event_loop_t>;
+    using notifier = dprivate::notifier<my_event_loop_t>;
     
     template <typename D> using fd_watcher_impl = dprivate::fd_watcher_impl<my_event_loop_t, D>;
     template <typename D> using bidi_fd_watcher_impl = dprivate::bidi_fd_watcher_impl<my_event_loop_t, D>;
     template <typename D> using signal_watcher_impl = dprivate::signal_watcher_impl<my_event_loop_t, D>;
     template <typename D> using child_proc_watcher_impl = dprivate::child_proc_watcher_impl<my_event_loop_t, D>;
     template <typename D> using timer_impl = dprivate::timer_impl<my_event_loop_t, D>;
+    template <typename D> using notifier_impl = dprivate::notifier_impl<my_event_loop_t, D>;
+
+    // Poll the event loop and process any pending events (up to a limit). If no events are pending, wait
+    // for and process at least one event.
+    void run(int limit = -1) noexcept
+    {
+        placement.enter();
+
+        // Poll the mechanism first, in case high-priority events are pending (unless another thread
+        // is polling or waiting to poll, in which case it will pick up such events):
+        waitqueue_node<T_Mutex> qnode;
+        unsigned epoch;
+        if (try_pollwait_lock(qnode, epoch)) {
+            loop_mech.pull_events(false);
+            release_poll_lock(qnode, epoch);
+        }
 
-    // Poll the event loop and process any pending events (up to a limit). If no events are pending, wait
-    // for and process at least one event.
-    void run(int limit = -1) noexcept
+        wait_and_process(qnode, epoch, limit);
+    }
+
+    // As for run(), but if no events are pending, repeatedly poll for events (without waiting) for up
+    // to the specified duration before waiting. This trades processor time for latency: an event which
+    // arrives while the thread is spinning is processed without the thread first having to be woken.
+    // See also the backend's busy-poll settings (epoll_loop::set_busy_poll()).
+    void run_busy(const time_val &spin_duration, int limit = -1) noexcept
     {
-        // Poll the mechanism first, in case high-priority events are pending:
+        placement.enter();
+
+        auto spin_end = std::chrono::steady_clock::now() + std::chrono::seconds(spin_duration.seconds())
+                + std::chrono::nanoseconds(spin_duration.nseconds());
+
         waitqueue_node<T_Mutex> qnode;
-        get_pollwait_lock(qnode);
-        loop_mech.pull_events(false);
-        release_lock(qnode);
+        unsigned epoch;
+        do {
+            // If another thread is polling (or waiting to poll), it will queue any events; we need
+            // only check for them:
+            if (try_pollwait_lock(qnode, epoch)) {
+                loop_mech.pull_events(false);
+                release_poll_lock(qnode, epoch);
+            }
+            if (process_events(limit)) {
+                return;
+            }
+        } while (std::chrono::steady_clock::now() < spin_end);
 
-        while (! process_events(limit)) {
-            // Pull events from the AEN mechanism and insert them in our internal queue:
-            get_pollwait_lock(qnode);
-            loop_mech.pull_events(true);
-            release_lock(qnode);
-        }
+        wait_and_process(qnode, epoch, limit);
     }
 
-    // Poll the event loop and process any pending events (up to a limit).
-    void poll(int limit = -1) noexcept
+    // Poll the event loop and process any pending events (up to a limit). Returns true if any events
+    // were processed.
+    bool poll(int limit = -1) noexcept
     {
+        placement.enter();
+
         waitqueue_node<T_Mutex> qnode;
-        if (poll_attn_lock(qnode)) {
+        unsigned epoch;
+        if (poll_attn_lock(qnode, epoch)) {
             loop_mech.pull_events(false);
-            release_lock(qnode);
+            release_poll_lock(qnode, epoch);
         }
 
-        process_events(limit);
+        return process_events(limit);
+    }
+
+    // Process events that have already been received and queued (up to a limit), without polling
+    // for further events. This can be called by a thread other than one running the loop, to help
+    // process events received by that thread. Returns true if any events were processed.
+    bool process_queued(int limit = -1) noexcept
+    {
+        return process_events(limit);
+    }
+
+    // Stop watching for child process termination. Only one event loop in a process can watch child
+    // processes (any loop reaps all terminated children); this allows other loops to be created. After
+    // this is called, attempts to add a child watch to this loop fail with std::system_error (ENOTSUP).
+    void disable_child_watch() noexcept
+    {
+        loop_mech.remove_signal_watch(SIGCHLD);
+        std::lock_guard<mutex_t> guard(loop_mech.lock);
+        loop_mech.disable_child_watch_nolock();
     }
 
     // Get the current time corresponding to a specific clock.
@@ -1514,8 +2487,117 @@ class event_loop
         loop_mech.get_time(tv, clock, force_update);
     }
 
-    event_loop() { }
+    // Access the backend mechanism, for backend-specific tuning parameters and statistics (such as
+    // epoll_loop::get_event_batch_size()). Other members of the backend should not be used directly.
+    loop_mech_t &get_backend() noexcept
+    {
+        return loop_mech;
+    }
+
+    // Post a task to the event loop: the callable will be run (as `task(loop)') by a thread processing
+    // events, with the specified priority relative to other watchers. Tasks with the same priority are
+    // run in the order posted. Posting is lock-free and may be done from any thread. The callable must
+    // not throw. A task whose callable is small enough (see default_traits::post_inline_size) is stored
+    // in a block from the loop's pool if one is free; otherwise it is allocated with operator new.
+    // Can fail with std::bad_alloc (only if the task is not stored in the pool).
+    template <typename T>
+    void post(T task, int prio = DEFAULT_PRIORITY)
+    {
+        class posted_task : public base_posted_task
+        {
+            T task;
+
+            public:
+            posted_task(T &&task_a) : task(std::move(task_a)) { }
+
+            void dispatch(void *loop_ptr) noexcept override
+            {
+                my_event_loop_t &loop = *static_cast<my_event_loop_t *>(loop_ptr);
+                loop.loop_mech.lock.unlock();
+                task(loop);
+                loop.loop_mech.lock.lock();
+                posted_task::dispatch_complete(loop_ptr, rearm::REMOVE);
+            }
+
+            rearm dispatch_callback(void *loop_ptr, int arg) noexcept override
+            {
+                task(*static_cast<my_event_loop_t *>(loop_ptr));
+                return rearm::REMOVE;
+            }
+
+            void dispatch_complete(void *loop_ptr, rearm rearm_type) noexcept override
+            {
+                my_event_loop_t &loop = *static_cast<my_event_loop_t *>(loop_ptr);
+                loop.release_task(this);
+                loop.loop_mech.lock.unlock();
+                loop.discard_task(this);
+                loop.loop_mech.lock.lock();
+            }
+        };
+
+        constexpr bool fits_pool = sizeof(posted_task) <= post_block_size
+                && alignof(posted_task) <= alignof(std::max_align_t);
+
+        void *block = fits_pool ? post_pool.acquire() : nullptr;
+        posted_task *pt = (block != nullptr) ? new (block) posted_task(std::move(task))
+                : new posted_task(std::move(task));
+        pt->init();
+        pt->priority = prio;
+        post_task(pt);
+    }
+
+    event_loop()
+    {
+        reserve_post_queue_slots();
+    }
+
+#if DASYNQ_HAVE_PTHREAD_SETAFFINITY
+    // Construct an event loop whose threads are restricted to the specified processors (eg
+    // cpu_affinity::for_numa_node(n)). The constructing thread is restricted before the loop's internal
+    // structures are allocated, and remains restricted; each thread which runs the loop (via run() or
+    // poll()) is restricted when it does so. An empty affinity restricts no threads.
+    // Throws std::system_error if the constructing thread can't be restricted, or as for the default
+    // constructor.
+    explicit event_loop(const cpu_affinity &affinity) : placement(affinity)
+    {
+        reserve_post_queue_slots();
+    }
+
+    // Get the processors to which the loop's threads are restricted (empty if not restricted).
+    const cpu_affinity &get_affinity() const noexcept
+    {
+        return placement.get_affinity();
+    }
+#endif
+
     event_loop(const event_loop &other) = delete;
+
+    ~event_loop()
+    {
+        // Delete tasks which were posted but not run:
+        auto delete_tasks = [this](base_posted_task *pt) {
+            while (pt != nullptr) {
+                base_posted_task *next = pt->next_posted;
+                discard_task(pt);
+                pt = next;
+            }
+        };
+        delete_tasks(post_list.load(std::memory_order_acquire));
+        delete_tasks(post_backlog);
+
+        base_watcher *bw = loop_mech.pull_event();
+        while (bw != nullptr) {
+            if (bw->watchType == watch_type_t::TASK) {
+                loop_mech.release_watcher(bw);
+                discard_task(static_cast<base_posted_task *>(bw));
+            }
+            bw = loop_mech.pull_event();
+        }
+
+        for (std::size_t i = 0; i < post_slots_held; i++) {
+            loop_mech.release_queue_slot(post_queue_slots[i]);
+        }
+    }
 };
 
 typedef event_loop<null_mutex> event_loop_n;
@@ -1552,6 +2634,13 @@ class signal_watcher : private dprivate::base_signal_watcher<typename EventLoop:
     {
         eloop.deregister(this, this->siginfo.get_signo());
     }
+
+    // Deregister the watcher without waiting for other threads polling the event loop (see
+    // fd_watcher::deregister_async).
+    inline void deregister_async(event_loop_t &eloop) noexcept
+    {
+        eloop.deregister_async(this, this->siginfo.get_signo());
+    }
     
     template <typename T>
     static signal_watcher<event_loop_t> *add_watch(event_loop_t &eloop, int signo, T watch_hndlr)
@@ -1594,22 +2683,34 @@ class signal_watcher_impl : public signal_watcher<EventLoop>
         EventLoop &loop = *static_cast<EventLoop *>(loop_ptr);
         loop_access::get_base_lock(loop).unlock();
 
-        auto rearm_type = static_cast<Derived *>(this)->received(loop, this->siginfo.get_signo(), this->siginfo);
+        auto rearm_type = signal_watcher_impl::dispatch_callback(loop_ptr, 0);
 
         loop_access::get_base_lock(loop).lock();
 
         if (rearm_type != rearm::REMOVED) {
+            signal_watcher_impl::dispatch_complete(loop_ptr, rearm_type);
+        }
+    }
 
-            this->active = false;
-            if (this->deleteme) {
-                // We don't want a watch that is marked "deleteme" to re-arm itself.
-                rearm_type = rearm::REMOVE;
-            }
+    rearm dispatch_callback(void *loop_ptr, int arg) noexcept override
+    {
+        EventLoop &loop = *static_cast<EventLoop *>(loop_ptr);
+        return static_cast<Derived *>(this)->received(loop, this->siginfo.get_signo(), this->siginfo);
+    }
 
-            loop_access::process_signal_rearm(loop, this, rearm_type);
+    void dispatch_complete(void *loop_ptr, rearm rearm_type) noexcept override
+    {
+        EventLoop &loop = *static_cast<EventLoop *>(loop_ptr);
 
-            post_dispatch(loop, this, rearm_type);
+        this->active = false;
+        if (this->deleteme) {
+            // We don't want a watch that is marked "deleteme" to re-arm itself.
+            rearm_type = rearm::REMOVE;
         }
+
+        loop_access::process_signal_rearm(loop, this, rearm_type);
+
+        post_dispatch(loop, this, rearm_type);
     }
 };
 
@@ -1685,6 +2786,14 @@ class fd_watcher : private dprivate::base_fd_watcher
     {
         eloop.deregister(this, this->watch_fd);
     }
+
+    // Deregister the watcher without waiting for other threads polling the event loop. The watcher
+    // is removed (and watch_removed() is called) asynchronously, possibly by another thread; until
+    // then, the event handler may still be called.
+    void deregister_async(event_loop_t &eloop) noexcept
+    {
+        eloop.deregister_async(this, this->watch_fd);
+    }
     
     void set_enabled(event_loop_t &eloop, bool enable) noexcept
     {
@@ -1745,28 +2854,48 @@ class fd_watcher_impl : public fd_watcher<EventLoop>
     void dispatch(void *loop_ptr) noexcept override
     {
         EventLoop &loop = *static_cast<EventLoop *>(loop_ptr);
-
-        // In case emulating, clear enabled here; REARM or explicit set_enabled will re-enable.
-        this->emulate_enabled = false;
-
+        int arg = fd_watcher_impl::dispatch_prepare(loop_ptr);
         loop_access::get_base_lock(loop).unlock();
 
-        auto rearm_type = static_cast<Derived *>(this)->fd_event(loop, this->watch_fd, this->event_flags);
+        auto rearm_type = fd_watcher_impl::dispatch_callback(loop_ptr, arg);
 
         loop_access::get_base_lock(loop).lock();
 
         if (rearm_type != rearm::REMOVED) {
-            this->event_flags = 0;
-            this->active = false;
-            if (this->deleteme) {
-                // We don't want a watch that is marked "deleteme" to re-arm itself.
-                rearm_type = rearm::REMOVE;
-            }
+            fd_watcher_impl::dispatch_complete(loop_ptr, rearm_type);
+        }
+    }
+
+    int dispatch_prepare(void *loop_ptr) noexcept override
+    {
+        // In case emulating, clear enabled here; REARM or explicit set_enabled will re-enable.
+        this->emulate_enabled = false;
+
+        // (For an edge-triggered watch, further events may be received while the handler runs):
+        int event_flags = this->event_flags;
+        this->event_flags = 0;
+        return event_flags;
+    }
+
+    rearm dispatch_callback(void *loop_ptr, int event_flags) noexcept override
+    {
+        EventLoop &loop = *static_cast<EventLoop *>(loop_ptr);
+        return static_cast<Derived *>(this)->fd_event(loop, this->watch_fd, event_flags);
+    }
 
-            rearm_type = loop_access::process_fd_rearm(loop, this, rearm_type);
+    void dispatch_complete(void *loop_ptr, rearm rearm_type) noexcept override
+    {
+        EventLoop &loop = *static_cast<EventLoop *>(loop_ptr);
 
-            post_dispatch(loop, this, rearm_type);
+        this->active = false;
+        if (this->deleteme) {
+            // We don't want a watch that is marked "deleteme" to re-arm itself.
+            rearm_type = rearm::REMOVE;
         }
+
+        rearm_type = loop_access::process_fd_rearm(loop, this, rearm_type);
+
+        post_dispatch(loop, this, rearm_type);
     }
 };
 
@@ -1906,6 +3035,14 @@ class bidi_fd_watcher : private dprivate::base_bidi_fd_watcher
     {
         eloop.deregister(this, this->watch_fd);
     }
+
+    // Deregister the watcher without waiting for other threads polling the event loop. The watcher
+    // is removed (and watch_removed() is called) asynchronously, possibly by another thread; until
+    // then, the event handler may still be called.
+    void deregister_async(event_loop_t &eloop) noexcept
+    {
+        eloop.deregister_async(this, this->watch_fd);
+    }
     
     template <typename T>
     static bidi_fd_watcher<event_loop_t> *add_watch(event_loop_t &eloop, int fd, int flags, T watch_hndlr)
@@ -1952,55 +3089,86 @@ class bidi_fd_watcher_impl : public bidi_fd_watcher<EventLoop>
     void dispatch(void *loop_ptr) noexcept override
     {
         EventLoop &loop = *static_cast<EventLoop *>(loop_ptr);
-        this->emulate_enabled = false;
+        int arg = bidi_fd_watcher_impl::dispatch_prepare(loop_ptr);
         loop_access::get_base_lock(loop).unlock();
 
-        auto rearm_type = static_cast<Derived *>(this)->read_ready(loop, this->watch_fd);
+        auto rearm_type = bidi_fd_watcher_impl::dispatch_callback(loop_ptr, arg);
 
         loop_access::get_base_lock(loop).lock();
 
         if (rearm_type != rearm::REMOVED) {
-            this->event_flags &= ~IN_EVENTS;
-            this->active = false;
-            if (this->deleteme) {
-                // We don't want a watch that is marked "deleteme" to re-arm itself.
-                rearm_type = rearm::REMOVE;
-            }
+            bidi_fd_watcher_impl::dispatch_complete(loop_ptr, rearm_type);
+        }
+    }
 
-            rearm_type = loop_access::process_primary_rearm(loop, this, rearm_type);
+    int dispatch_prepare(void *loop_ptr) noexcept override
+    {
+        this->emulate_enabled = false;
+        return 0;
+    }
 
-            auto &outwatcher = bidi_fd_watcher<EventLoop>::out_watcher;
-            post_dispatch(loop, this, &outwatcher, rearm_type);
-        }
+    rearm dispatch_callback(void *loop_ptr, int arg) noexcept override
+    {
+        EventLoop &loop = *static_cast<EventLoop *>(loop_ptr);
+        return static_cast<Derived *>(this)->read_ready(loop, this->watch_fd);
     }
 
-    void dispatch_second(void *loop_ptr) noexcept override
+    void dispatch_complete(void *loop_ptr, rearm rearm_type) noexcept override
     {
+        EventLoop &loop = *static_cast<EventLoop *>(loop_ptr);
+
+        this->event_flags &= ~IN_EVENTS;
+        this->active = false;
+        if (this->deleteme) {
+            // We don't want a watch that is marked "deleteme" to re-arm itself.
+            rearm_type = rearm::REMOVE;
+        }
+
+        rearm_type = loop_access::process_primary_rearm(loop, this, rearm_type);
+
         auto &outwatcher = bidi_fd_watcher<EventLoop>::out_watcher;
+        post_dispatch(loop, this, &outwatcher, rearm_type);
+    }
 
+    void dispatch_second(void *loop_ptr) noexcept override
+    {
         EventLoop &loop = *static_cast<EventLoop *>(loop_ptr);
         loop_access::get_base_lock(loop).unlock();
 
-        auto rearm_type = static_cast<Derived *>(this)->write_ready(loop, this->watch_fd);
+        auto rearm_type = bidi_fd_watcher_impl::dispatch_second_callback(loop_ptr);
 
         loop_access::get_base_lock(loop).lock();
 
         if (rearm_type != rearm::REMOVED) {
-            this->event_flags &= ~OUT_EVENTS;
-            outwatcher.active = false;
-            if (outwatcher.deleteme) {
-                // We don't want a watch that is marked "deleteme" to re-arm itself.
-                rearm_type = rearm::REMOVE;
-            }
+            bidi_fd_watcher_impl::dispatch_second_complete(loop_ptr, rearm_type);
+        }
+    }
+
+    rearm dispatch_second_callback(void *loop_ptr) noexcept override
+    {
+        EventLoop &loop = *static_cast<EventLoop *>(loop_ptr);
+        return static_cast<Derived *>(this)->write_ready(loop, this->watch_fd);
+    }
 
-            rearm_type = loop_access::process_secondary_rearm(loop, this, &outwatcher, rearm_type);
+    void dispatch_second_complete(void *loop_ptr, rearm rearm_type) noexcept override
+    {
+        auto &outwatcher = bidi_fd_watcher<EventLoop>::out_watcher;
+        EventLoop &loop = *static_cast<EventLoop *>(loop_ptr);
 
-            if (rearm_type == rearm::REQUEUE) {
-                post_dispatch(loop, &outwatcher, rearm_type);
-            }
-            else {
-                post_dispatch(loop, this, &outwatcher, rearm_type);
-            }
+        this->event_flags &= ~OUT_EVENTS;
+        outwatcher.active = false;
+        if (outwatcher.deleteme) {
+            // We don't want a watch that is marked "deleteme" to re-arm itself.
+            rearm_type = rearm::REMOVE;
+        }
+
+        rearm_type = loop_access::process_secondary_rearm(loop, this, &outwatcher, rearm_type);
+
+        if (rearm_type == rearm::REQUEUE) {
+            post_dispatch(loop, &outwatcher, rearm_type);
+        }
+        else {
+            post_dispatch(loop, this, &outwatcher, rearm_type);
         }
     }
 };
@@ -2077,6 +3245,13 @@ class child_proc_watcher : private dprivate::base_child_watcher
     {
         eloop.deregister(this, child);
     }
+
+    // Deregister the watcher without waiting for other threads polling the event loop (see
+    // fd_watcher::deregister_async).
+    void deregister_async(event_loop_t &eloop, pid_t child) noexcept
+    {
+        eloop.deregister_async(this, child);
+    }
     
     // Stop watching the currently watched child, but retain watch reservation.
     void stop_watch(event_loop_t &eloop) noexcept
@@ -2186,23 +3361,35 @@ class child_proc_watcher_impl : public child_proc_watcher<EventLoop>
         EventLoop &loop = *static_cast<EventLoop *>(loop_ptr);
         loop_access::get_base_lock(loop).unlock();
 
-        auto rearm_type = static_cast<Derived *>(this)->status_change(loop, this->watch_pid, this->child_status);
+        auto rearm_type = child_proc_watcher_impl::dispatch_callback(loop_ptr, 0);
 
         loop_access::get_base_lock(loop).lock();
 
         if (rearm_type != rearm::REMOVED) {
+            child_proc_watcher_impl::dispatch_complete(loop_ptr, rearm_type);
+        }
+    }
 
-            this->active = false;
-            if (this->deleteme) {
-                // We don't want a watch that is marked "deleteme" to re-arm itself.
-                rearm_type = rearm::REMOVE;
-            }
+    rearm dispatch_callback(void *loop_ptr, int arg) noexcept override
+    {
+        EventLoop &loop = *static_cast<EventLoop *>(loop_ptr);
+        return static_cast<Derived *>(this)->status_change(loop, this->watch_pid, this->child_status);
+    }
 
-            loop_access::process_child_watch_rearm(loop, this, rearm_type);
+    void dispatch_complete(void *loop_ptr, rearm rearm_type) noexcept override
+    {
+        EventLoop &loop = *static_cast<EventLoop *>(loop_ptr);
 
-            // rearm_type = loop.process??;
-            post_dispatch(loop, this, rearm_type);
+        this->active = false;
+        if (this->deleteme) {
+            // We don't want a watch that is marked "deleteme" to re-arm itself.
+            rearm_type = rearm::REMOVE;
         }
+
+        loop_access::process_child_watch_rearm(loop, this, rearm_type);
+
+        // rearm_type = loop.process??;
+        post_dispatch(loop, this, rearm_type);
     }
 };
 
@@ -2252,6 +3439,12 @@ class timer : private base_timer_watcher
         eloop.stop_timer(this, base_t::clock);
     }
 
+    // Set the slack (tolerance) for the timer; takes effect when the timer is next armed.
+    void set_slack(event_loop_t &eloop, const timespec &slack) noexcept
+    {
+        eloop.set_timer_slack(this, slack, base_t::clock);
+    }
+
     void set_enabled(event_loop_t &eloop, clock_type clock, bool enabled) noexcept
     {
         std::lock_guard<mutex_t> guard(eloop.get_base_lock());
@@ -2266,6 +3459,13 @@ class timer : private base_timer_watcher
         eloop.deregister(this, this->clock);
     }
 
+    // Deregister the timer without waiting for other threads polling the event loop (see
+    // fd_watcher::deregister_async).
+    void deregister_async(event_loop_t &eloop) noexcept
+    {
+        eloop.deregister_async(this, this->clock);
+    }
+
     template <typename T>
     static timer<EventLoop> *add_timer(EventLoop &eloop, clock_type clock, bool relative,
             const timespec &timeout, const timespec &interval, T watch_hndlr)
@@ -2315,26 +3515,176 @@ class timer_impl : public timer<EventLoop>
     void dispatch(void *loop_ptr) noexcept override
     {
         EventLoop &loop = *static_cast<EventLoop *>(loop_ptr);
+        int arg = timer_impl::dispatch_prepare(loop_ptr);
         loop_access::get_base_lock(loop).unlock();
 
+        auto rearm_type = timer_impl::dispatch_callback(loop_ptr, arg);
+
+        loop_access::get_base_lock(loop).lock();
+
+        if (rearm_type != rearm::REMOVED) {
+            timer_impl::dispatch_complete(loop_ptr, rearm_type);
+        }
+    }
+
+    int dispatch_prepare(void *loop_ptr) noexcept override
+    {
         auto intervals_report = this->intervals;
         this->intervals = 0;
-        auto rearm_type = static_cast<Derived *>(this)->timer_expiry(loop, intervals_report);
+        return intervals_report;
+    }
+
+    rearm dispatch_callback(void *loop_ptr, int intervals_report) noexcept override
+    {
+        EventLoop &loop = *static_cast<EventLoop *>(loop_ptr);
+        return static_cast<Derived *>(this)->timer_expiry(loop, intervals_report);
+    }
+
+    void dispatch_complete(void *loop_ptr, rearm rearm_type) noexcept override
+    {
+        EventLoop &loop = *static_cast<EventLoop *>(loop_ptr);
+
+        this->active = false;
+        if (this->deleteme) {
+            // We don't want a watch that is marked "deleteme" to re-arm itself.
+            rearm_type = rearm::REMOVE;
+        }
+
+        loop_access::process_timer_rearm(loop, this, rearm_type);
+
+        post_dispatch(loop, this, rearm_type);
+    }
+};
+
+// User notification watcher. A notifier can be notified from any thread (or from a signal handler)
+// via notify(); the loop then dispatches the notification. Multiple notifications received before
+// the notification is dispatched are coalesced into a single dispatch.
+template <typename EventLoop>
+class notifier : private base_notifier
+{
+    template <typename, typename> friend class notifier_impl;
+    using mutex_t = typename EventLoop::mutex_t;
+
+    public:
+    using event_loop_t = EventLoop;
+
+    // Register the notifier with an event loop.
+    // Can fail with std::bad_alloc.
+    void add_watch(event_loop_t &eloop, int prio = DEFAULT_PRIORITY)
+    {
+        base_watcher::init();
+        this->priority = prio;
+        eloop.register_notifier(this);
+    }
+
+    // Notify. This function is lock-free and async-signal-safe, and may be called from any thread.
+    // For a single-threaded event loop (with null_mutex), it does not interrupt a wait that is in
+    // progress, so should be called only from the thread running the event loop.
+    void notify(event_loop_t &eloop) noexcept
+    {
+        eloop.notify(this);
+    }
+
+    // Enable or disable the notifier. Notifications received while disabled are retained (and
+    // dispatched once the notifier is re-enabled).
+    void set_enabled(event_loop_t &eloop, bool enable) noexcept
+    {
+        std::lock_guard<mutex_t> guard(eloop.get_base_lock());
+        eloop.set_notifier_enabled_nolock(this, enable);
+    }
+
+    // Deregister the notifier. The notifier must not be notified after or concurrently with
+    // deregistration.
+    void deregister(event_loop_t &eloop) noexcept
+    {
+        eloop.deregister(this);
+    }
+
+    // Deregister the notifier without waiting for other threads polling the event loop (see
+    // fd_watcher::deregister_async).
+    void deregister_async(event_loop_t &eloop) noexcept
+    {
+        eloop.deregister_async(this);
+    }
+
+    template <typename T>
+    static notifier<EventLoop> *add_watch(event_loop_t &eloop, T watch_hndlr)
+    {
+        class lambda_notifier : public notifier_impl<event_loop_t, lambda_notifier>
+        {
+            private:
+            T watch_hndlr;
+
+            public:
+            lambda_notifier(T watch_handlr_a) : watch_hndlr(watch_handlr_a)
+            {
+                //
+            }
+
+            rearm notified(event_loop_t &eloop)
+            {
+                return watch_hndlr(eloop);
+            }
+
+            void watch_removed() noexcept override
+            {
+                delete this;
+            }
+        };
+
+        lambda_notifier * ln = new lambda_notifier(watch_hndlr);
+        ln->add_watch(eloop);
+        return ln;
+    }
+
+    // Notification received:
+    // virtual rearm notified(event_loop_t &eloop) = 0;
+};
+
+template <typename EventLoop, typename Derived>
+class notifier_impl : public notifier<EventLoop>
+{
+    void dispatch(void *loop_ptr) noexcept override
+    {
+        EventLoop &loop = *static_cast<EventLoop *>(loop_ptr);
+        int arg = notifier_impl::dispatch_prepare(loop_ptr);
+        loop_access::get_base_lock(loop).unlock();
+
+        auto rearm_type = notifier_impl::dispatch_callback(loop_ptr, arg);
 
         loop_access::get_base_lock(loop).lock();
 
         if (rearm_type != rearm::REMOVED) {
+            notifier_impl::dispatch_complete(loop_ptr, rearm_type);
+        }
+    }
 
-            this->active = false;
-            if (this->deleteme) {
-                // We don't want a watch that is marked "deleteme" to re-arm itself.
-                rearm_type = rearm::REMOVE;
-            }
+    int dispatch_prepare(void *loop_ptr) noexcept override
+    {
+        // Clear the notified state before running the handler; a notification received while the
+        // handler runs will cause another dispatch.
+        this->is_notified.store(false);
+        return 0;
+    }
 
-            loop_access::process_timer_rearm(loop, this, rearm_type);
+    rearm dispatch_callback(void *loop_ptr, int arg) noexcept override
+    {
+        EventLoop &loop = *static_cast<EventLoop *>(loop_ptr);
+        return static_cast<Derived *>(this)->notified(loop);
+    }
+
+    void dispatch_complete(void *loop_ptr, rearm rearm_type) noexcept override
+    {
+        EventLoop &loop = *static_cast<EventLoop *>(loop_ptr);
 
-            post_dispatch(loop, this, rearm_type);
+        this->active = false;
+        if (this->deleteme) {
+            rearm_type = rearm::REMOVE;
         }
+
+        rearm_type = loop_access::process_notifier_rearm(loop, this, rearm_type);
+
+        post_dispatch(loop, this, rearm_type);
     }
 };
 
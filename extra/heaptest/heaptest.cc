@@ -4,31 +4,31 @@
 #include "dasynq-binaryheap.h"
 #include "dasynq-naryheap.h"
 #include "dasynq-daryheap.h"
+#include "dasynq-soaheap.h"
+#include "dasynq-bucketqueue.h"
 
 #include <functional>
 #include <random>
 #include <chrono>
 #include <algorithm>
+#include <cstdlib>
+#include <cstring>
 
 #include <iostream>
 
 template <typename A, typename B, typename C> using Nary = dasynq::nary_heap<A,B,C, 16>;
-template <typename A, typename B, typename C> using Dary = dasynq::dary_heap<A,B,C, 4>;
 
-int main(int argc, char **argv)
+// D-ary heaps with fan-out N:
+template <int N> struct dary_n
+{
+    template <typename A, typename B, typename C> using heap = dasynq::dary_heap<A,B,C, N>;
+    template <typename A, typename B, typename C> using soa_heap = dasynq::soa_dary_heap<A,B,C, N>;
+};
+
+// Run the tests against a queue. If few_prios is true, the queue is only suitable for a small number of
+// distinct priorities (eg. bucket_queue), and only the "flat priority" test is run.
+template <typename Heap> void run_tests(Heap &heap, bool few_prios)
 {
-    // Template arguments are: data type, priority type, comparator
-    // dasynq::BinaryHeap<int, int, std::less<int>> heap;
-    // dasynq::nary_heap<int, int> heap;
-    // dasynq::dary_heap<int, int, std::less<int>, 4> heap;
-    // dasynq::PairingHeap<int, int> heap;
-    // dasynq::btree_queue<int, int, std::less<int>, 16> heap;
-    
-    // dasynq::stable_heap<Dary, int, int> heap;
-    // dasynq::stable_heap<dasynq::BinaryHeap, int, int> heap;
-    // dasynq::stable_heap<Nary, int, int> heap;
-    dasynq::stable_heap<dasynq::pairing_heap, int, int> heap;
-    
     constexpr int NUM = 10000000;
     // constexpr int NUM = 5;
     // constexpr int NUM = 100000;
@@ -36,32 +36,39 @@ int main(int argc, char **argv)
     std::mt19937 gen(0);
     std::uniform_int_distribution<> r(0, NUM);
     
-    // Ordered fill/dequeue
-    
-    auto starttime = std::chrono::high_resolution_clock::now();
-    
-    using handle_t = decltype(heap)::handle_t;
-    using handle_t_r = decltype(heap)::handle_t_r;
+    using handle_t = typename Heap::handle_t;
+    using handle_t_r = typename Heap::handle_t_r;
     
     handle_t *indexes = new handle_t[NUM];
-    for (int i = 0; i < NUM; i++) {
-        heap.allocate(indexes[i], i);
-        heap.insert(indexes[i], i);
-    }
-    
-    for (int i = 0; i < NUM; i++) {
-        handle_t_r r = heap.get_root();
-        // std::cout << heap.get_data(r) << std::endl;
-        heap.pull_root();
-        heap.deallocate(r);
+
+    auto starttime = std::chrono::high_resolution_clock::now();
+    auto endtime = starttime;
+    long millis;
+
+    // Ordered fill/dequeue
+
+    if (! few_prios) {
+        starttime = std::chrono::high_resolution_clock::now();
+
+        for (int i = 0; i < NUM; i++) {
+            heap.allocate(indexes[i], i);
+            heap.insert(indexes[i], i);
+        }
+
+        for (int i = 0; i < NUM; i++) {
+            handle_t_r r = heap.get_root();
+            // std::cout << heap.get_data(r) << std::endl;
+            heap.pull_root();
+            heap.deallocate(r);
+        }
+
+        endtime = std::chrono::high_resolution_clock::now();
+        millis = std::chrono::duration_cast<std::chrono::milliseconds>(endtime - starttime).count();
+
+        std::cout << "Ordered fill/dequeue: " << millis << std::endl;
+
+        if (! heap.empty()) abort();
     }
-    
-    auto endtime = std::chrono::high_resolution_clock::now();
-    auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(endtime - starttime).count();
-    
-    std::cout << "Ordered fill/dequeue: " << millis << std::endl;
-    
-    if (! heap.empty()) abort();
 
     // Flat priority fill/dequeue
     
@@ -85,6 +92,11 @@ int main(int argc, char **argv)
     std::cout << "Flat priority fill/dequeue: " << millis << std::endl;
 
     if (! heap.empty()) abort();
+
+    if (few_prios) {
+        delete[] indexes;
+        return;
+    }
     
     // Random fill/dequeue
     
@@ -219,5 +231,95 @@ int main(int argc, char **argv)
 
     if (! heap.empty()) abort();
 
+    delete[] indexes;
+}
+
+// Run the tests against a d-ary heap with fan-out N (returns false if qtype is not a d-ary heap):
+template <int N> bool run_dary_tests(const char *qtype)
+{
+    if (strcmp(qtype, "dary") == 0) {
+        dasynq::dary_heap<int, int, std::less<int>, N> heap;
+        run_tests(heap, false);
+    }
+    else if (strcmp(qtype, "soa-dary") == 0) {
+        dasynq::soa_dary_heap<int, int, std::less<int>, N> heap;
+        run_tests(heap, false);
+    }
+    else if (strcmp(qtype, "stable-dary") == 0) {
+        dasynq::stable_heap<dary_n<N>::template heap, int, int> heap;
+        run_tests(heap, false);
+    }
+    else if (strcmp(qtype, "compact-stable-dary") == 0) {
+        dasynq::compact_stable_heap<dary_n<N>::template heap, int, int> heap;
+        run_tests(heap, false);
+    }
+    else if (strcmp(qtype, "compact-stable-soa-dary") == 0) {
+        dasynq::compact_stable_heap<dary_n<N>::template soa_heap, int, int> heap;
+        run_tests(heap, false);
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    // Template arguments are: data type, priority type, comparator
+    // The queue is selected by the (optional) argument, and the fan-out of d-ary heaps by a second:
+    const char *qtype = (argc > 1) ? argv[1] : "stable-pairing";
+    int fan_out = (argc > 2) ? atoi(argv[2]) : 4;
+
+    // Size of the priority as stored in each node of a stable heap (the node also has a handle pointer):
+    std::cout << "sizeof(stable_prio<int>): " << sizeof(dasynq::stable_prio<int>) << ", "
+            << "sizeof(compact_stable_prio<int,uint32_t>): "
+            << sizeof(dasynq::compact_stable_prio<int,uint32_t>) << std::endl;
+
+    if (fan_out != 4 && fan_out != 8 && fan_out != 16) {
+        std::cerr << "Fan-out must be 4, 8 or 16" << std::endl;
+        return 1;
+    }
+
+    if (fan_out == 4 ? run_dary_tests<4>(qtype) : fan_out == 8 ? run_dary_tests<8>(qtype)
+            : run_dary_tests<16>(qtype)) {
+        // done
+    }
+    else if (strcmp(qtype, "binary") == 0) {
+        dasynq::binary_heap<int, int> heap;
+        run_tests(heap, false);
+    }
+    else if (strcmp(qtype, "nary") == 0) {
+        dasynq::nary_heap<int, int> heap;
+        run_tests(heap, false);
+    }
+    else if (strcmp(qtype, "pairing") == 0) {
+        dasynq::pairing_heap<int, int> heap;
+        run_tests(heap, false);
+    }
+    else if (strcmp(qtype, "btree") == 0) {
+        dasynq::btree_queue<int, int, std::less<int>, 16> heap;
+        run_tests(heap, false);
+    }
+    else if (strcmp(qtype, "stable-binary") == 0) {
+        dasynq::stable_heap<dasynq::binary_heap, int, int> heap;
+        run_tests(heap, false);
+    }
+    else if (strcmp(qtype, "stable-nary") == 0) {
+        dasynq::stable_heap<Nary, int, int> heap;
+        run_tests(heap, false);
+    }
+    else if (strcmp(qtype, "stable-pairing") == 0) {
+        dasynq::stable_heap<dasynq::pairing_heap, int, int> heap;
+        run_tests(heap, false);
+    }
+    else if (strcmp(qtype, "bucket") == 0) {
+        dasynq::bucket_queue<int, int> heap;
+        run_tests(heap, true);
+    }
+    else {
+        std::cerr << "Unknown queue type: " << qtype << std::endl;
+        return 1;
+    }
+
     return 0;
 }
@@ -70,21 +70,34 @@ static int set_prios;
 
 using namespace dasynq;
 
-event_loop_n eloop;
+#if DBENCH_SINGLE_PRIORITY
+// A loop which ignores watcher priorities (and so the -p option), using a FIFO event queue:
+class bench_traits : public default_traits<null_mutex>
+{
+    public:
+    constexpr static bool single_priority = true;
+};
+
+using bench_loop_t = event_loop<null_mutex, bench_traits>;
+#else
+using bench_loop_t = event_loop_n;
+#endif
+
+bench_loop_t eloop;
 
 
-class Pipeio : public event_loop_n::fd_watcher_impl<Pipeio>
+class Pipeio : public bench_loop_t::fd_watcher_impl<Pipeio>
 {
     public:
     int idx;
 
-    rearm fd_event(event_loop_n &eloop, int fd, int flags);
+    rearm fd_event(bench_loop_t &eloop, int fd, int flags);
 };
 
-class PTimer : public event_loop_n::timer_impl<PTimer>
+class PTimer : public bench_loop_t::timer_impl<PTimer>
 {
     public:
-    rearm timer_expiry(event_loop_n &eloop, int intervals)
+    rearm timer_expiry(bench_loop_t &eloop, int intervals)
     {
         return rearm::DISARM;
     }
@@ -94,7 +107,7 @@ class PTimer : public event_loop_n::timer_impl<PTimer>
 static Pipeio *evio;
 static PTimer *evto;
 
-rearm Pipeio::fd_event(event_loop_n &eloop, int fd, int flags)
+rearm Pipeio::fd_event(bench_loop_t &eloop, int fd, int flags)
 {
     int widx = idx + 1;
     if (timers) {
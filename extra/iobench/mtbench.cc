@@ -0,0 +1,204 @@
+/*
+ * Multi-threaded dispatch benchmark for Dasynq.
+ *
+ * A number of pipes are watched by a thread-safe event loop, which is run by several threads at
+ * once. Each watcher, when its pipe becomes readable, reads the byte, does a (simulated) fixed
+ * amount of work, and writes a byte to the next pipe, so that a number of "messages" (set by -m)
+ * circulate through the pipes. The benchmark measures how the rate at which messages are handled
+ * scales with the number of threads. With -s, the work is simulated by sleeping rather than spinning
+ * (as if handlers performed blocking operations), which shows how well handlers run in parallel even
+ * on a machine with few processors. With -c, the loop allows concurrent polling (several threads
+ * may wait for events at once). With -a, the loop uses adaptive_mutex (which spins briefly before
+ * blocking) rather than std::mutex. With -b, events are dispatched in batches (of up to 16).
+ */
+
+#include <sys/time.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "dasynq.h"
+
+using namespace dasynq;
+
+template <typename T_Mutex, bool Concurrent, int Batch>
+class bench_traits : public default_traits<T_Mutex>
+{
+    public:
+    constexpr static bool concurrent_polling = Concurrent;
+    constexpr static int dispatch_batch = Batch;
+};
+
+static int num_pipes = 200;
+static int num_messages = 50;
+static int num_threads = 4;
+static int work_ns = 5000;
+static long num_events = 200000;
+static bool sleep_work = false;
+static bool concurrent_poll = false;
+static bool adaptive = false;
+static bool batch = false;
+
+static int *pipes;
+static std::atomic<long> events_handled {0};
+static std::atomic<bool> done {false};
+
+// Spin (or sleep) for the given number of nanoseconds:
+static void do_work(int ns)
+{
+    if (sleep_work) {
+        struct timespec req = { 0, ns };
+        nanosleep(&req, nullptr);
+        return;
+    }
+
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    } while ((now.tv_sec - start.tv_sec) * 1000000000L + (now.tv_nsec - start.tv_nsec) < ns);
+}
+
+template <typename Loop>
+class pipe_watcher : public Loop::template fd_watcher_impl<pipe_watcher<Loop>>
+{
+    public:
+    int index;
+
+    rearm fd_event(Loop &eloop, int fd, int flags)
+    {
+        char buf;
+        if (read(fd, &buf, 1) != 1) return rearm::REARM;
+        do_work(work_ns);
+        int next = (index + 1) % num_pipes;
+        write(pipes[next * 2 + 1], &buf, 1);
+        if (events_handled.fetch_add(1, std::memory_order_relaxed) + 1 >= num_events) {
+            done.store(true, std::memory_order_relaxed);
+        }
+        return rearm::REARM;
+    }
+};
+
+template <typename Loop>
+static void run_bench()
+{
+    Loop eloop;
+
+    pipes = new int[num_pipes * 2];
+    pipe_watcher<Loop> *watchers = new pipe_watcher<Loop>[num_pipes];
+    for (int i = 0; i < num_pipes; i++) {
+        if (pipe2(&pipes[i * 2], O_NONBLOCK) == -1) {
+            perror("pipe");
+            exit(1);
+        }
+        watchers[i].index = i;
+        watchers[i].add_watch(eloop, pipes[i * 2], IN_EVENTS);
+    }
+
+    // Start the messages, spread evenly over the pipes:
+    for (int i = 0; i < num_messages; i++) {
+        char buf = 0;
+        write(pipes[(i * num_pipes / num_messages) * 2 + 1], &buf, 1);
+    }
+
+    struct timeval ts, te;
+    gettimeofday(&ts, NULL);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; i++) {
+        threads.emplace_back([&eloop]() {
+            while (! done.load(std::memory_order_relaxed)) {
+                eloop.run();
+            }
+        });
+    }
+
+    // (The messages continue to circulate until all threads have stopped).
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    gettimeofday(&te, NULL);
+
+    long elapsed = (te.tv_sec - ts.tv_sec) * 1000000L + (te.tv_usec - ts.tv_usec);
+    fprintf(stdout, "%8ld us  %8.0f events/s\n", elapsed, events_handled.load() * 1000000.0 / elapsed);
+
+    for (int i = 0; i < num_pipes; i++) {
+        watchers[i].deregister(eloop);
+    }
+}
+
+template <typename T_Mutex, bool Concurrent>
+static void select_bench_batch()
+{
+    if (batch) {
+        run_bench<event_loop<T_Mutex, bench_traits<T_Mutex, Concurrent, 16>>>();
+    }
+    else {
+        run_bench<event_loop<T_Mutex, bench_traits<T_Mutex, Concurrent, 1>>>();
+    }
+}
+
+template <typename T_Mutex>
+static void select_bench()
+{
+    if (concurrent_poll) {
+        select_bench_batch<T_Mutex, true>();
+    }
+    else {
+        select_bench_batch<T_Mutex, false>();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int c;
+    while ((c = getopt(argc, argv, "n:m:t:w:e:scab")) != -1) {
+        switch (c) {
+            case 'n':
+                num_pipes = atoi(optarg);
+                break;
+            case 'm':
+                num_messages = atoi(optarg);
+                break;
+            case 't':
+                num_threads = atoi(optarg);
+                break;
+            case 'w':
+                work_ns = atoi(optarg);
+                break;
+            case 'e':
+                num_events = atol(optarg);
+                break;
+            case 's':
+                sleep_work = true;
+                break;
+            case 'c':
+                concurrent_poll = true;
+                break;
+            case 'a':
+                adaptive = true;
+                break;
+            case 'b':
+                batch = true;
+                break;
+            default:
+                fprintf(stderr, "Illegal argument \"%c\"\n", c);
+                exit(1);
+        }
+    }
+
+    if (adaptive) {
+        select_bench<adaptive_mutex>();
+    }
+    else {
+        select_bench<std::mutex>();
+    }
+
+    return 0;
+}
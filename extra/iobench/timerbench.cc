@@ -0,0 +1,155 @@
+/*
+ * Timer re-arm benchmark for Dasynq.
+ *
+ * Sets up a number of (idle) timers, and then repeatedly re-arms all of them with a relative timeout
+ * from within an event handler, as a server might do when resetting per-connection idle timeouts
+ * after each round of I/O. With -u, the timeout for each timer is instead calculated from a fresh
+ * (uncached) clock read, which is what re-arming relative timers cost before clock times were cached.
+ * With -r, timers are re-armed in a random order (rather than the order in which they were added),
+ * and with -w a timing wheel is used as the timer queue instead of the default heap.
+ */
+
+#include <sys/time.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "dasynq.h"
+
+using namespace dasynq;
+
+static int num_timers = 10000;
+static int num_iterations = 100;
+static bool uncached = false;
+static bool random_order = false;
+static bool use_wheel = false;
+
+class wheel_traits : public default_traits<null_mutex>
+{
+    public:
+    using timer_queue_t = timer_wheel_queue_t<>;
+};
+
+template <typename Loop>
+class PTimer : public Loop::template timer_impl<PTimer<Loop>>
+{
+    public:
+    rearm timer_expiry(Loop &eloop, int intervals)
+    {
+        return rearm::DISARM;
+    }
+};
+
+// Watches the (always writable) write end of a pipe, so that each poll of the loop returns an event:
+template <typename Loop>
+class Rearmer : public Loop::template fd_watcher_impl<Rearmer<Loop>>
+{
+    public:
+    PTimer<Loop> *timers;
+    std::vector<int> order;
+    int iterations = 0;
+
+    rearm fd_event(Loop &eloop, int fd, int flags)
+    {
+        for (int j = 0; j < num_timers; j++) {
+            int i = order[j];
+            time_val timeout {60, (j * 1000) % 1000000000};
+            if (uncached) {
+                time_val now;
+                eloop.get_time(now, clock_type::MONOTONIC, true);
+                timers[i].arm_timer(eloop, now + timeout);
+            }
+            else {
+                timers[i].arm_timer_rel(eloop, timeout);
+            }
+        }
+        iterations++;
+        return (iterations == num_iterations) ? rearm::DISARM : rearm::REARM;
+    }
+};
+
+template <typename Loop>
+static void run_bench(int fd)
+{
+    Loop eloop;
+
+    PTimer<Loop> *timers = new PTimer<Loop>[num_timers];
+    for (int i = 0; i < num_timers; i++) {
+        timers[i].add_timer(eloop);
+    }
+
+    Rearmer<Loop> rearmer;
+    rearmer.timers = timers;
+    for (int i = 0; i < num_timers; i++) {
+        rearmer.order.push_back(i);
+    }
+    if (random_order) {
+        srand48(1);
+        for (int i = num_timers - 1; i > 0; i--) {
+            std::swap(rearmer.order[i], rearmer.order[lrand48() % (i + 1)]);
+        }
+    }
+    rearmer.add_watch(eloop, fd, OUT_EVENTS);
+
+    struct timeval ts, te;
+    gettimeofday(&ts, NULL);
+    while (rearmer.iterations < num_iterations) {
+        eloop.run();
+    }
+    gettimeofday(&te, NULL);
+
+    long elapsed = (te.tv_sec - ts.tv_sec) * 1000000L + (te.tv_usec - ts.tv_usec);
+    fprintf(stdout, "%8ld us  %6.1f ns/arm\n", elapsed,
+            elapsed * 1000.0 / ((double)num_timers * num_iterations));
+
+    rearmer.deregister(eloop);
+    for (int i = 0; i < num_timers; i++) {
+        timers[i].deregister(eloop);
+    }
+    delete[] timers;
+}
+
+int main(int argc, char **argv)
+{
+    int c;
+    while ((c = getopt(argc, argv, "n:i:urw")) != -1) {
+        switch (c) {
+            case 'n':
+                num_timers = atoi(optarg);
+                break;
+            case 'i':
+                num_iterations = atoi(optarg);
+                break;
+            case 'u':
+                uncached = true;
+                break;
+            case 'r':
+                random_order = true;
+                break;
+            case 'w':
+                use_wheel = true;
+                break;
+            default:
+                fprintf(stderr, "Illegal argument \"%c\"\n", c);
+                exit(1);
+        }
+    }
+
+    int pipefds[2];
+    if (pipe(pipefds) == -1) {
+        perror("pipe");
+        exit(1);
+    }
+
+    if (use_wheel) {
+        run_bench<event_loop<null_mutex, wheel_traits>>(pipefds[1]);
+    }
+    else {
+        run_bench<event_loop_n>(pipefds[1]);
+    }
+
+    return 0;
+}
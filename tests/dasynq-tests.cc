@@ -1,12 +1,20 @@
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <pthread.h>
 
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <thread>
+#include <vector>
 
 #include "testbackend.h"
 #include "dasynq.h"
+#include "dasynq-loopgroup.h"
 
 class checking_mutex
 {
@@ -35,6 +43,12 @@ class test_traits : public dasynq::default_traits<checking_mutex>
 
 using Loop_t = dasynq::event_loop<checking_mutex, test_traits>;
 
+class test_wheel_traits : public test_traits
+{
+    public:
+    using timer_queue_t = dasynq::timer_wheel_queue_t<>;
+};
+
 using dasynq::rearm;
 using dasynq::test_io_engine;
 
@@ -500,6 +514,495 @@ static void test_timers_1()
     timer_2.deregister(my_loop);
 }
 
+static void test_timer_wheel()
+{
+    using dasynq::time_val;
+    using queue_t = dasynq::timer_wheel_queue_t<1000000>; // 1ms granularity
+    using handle_t = queue_t::handle_t;
+
+    constexpr int NUM = 1000;
+    queue_t queue;
+    handle_t *handles = new handle_t[NUM];
+    std::vector<time_val> expiry(NUM);
+    std::vector<bool> fired(NUM, false);
+
+    // Times spread over 100 seconds, except for one which is beyond the range of the wheel:
+    unsigned rnd = 12345;
+    for (int i = 0; i < NUM; i++) {
+        rnd = rnd * 1103515245u + 12345u;
+        expiry[i] = time_val((rnd >> 8) % 100, (rnd % 1000) * 1000000 + 123);
+        queue.allocate(handles[i], (void *)(uintptr_t)i);
+        queue.insert(handles[i], expiry[i]);
+    }
+    expiry[NUM - 1] = time_val(200 * 24 * 60 * 60, 0);
+    queue.set_priority(handles[NUM - 1], expiry[NUM - 1]);
+
+    // Re-prioritise and remove some:
+    for (int i = 0; i < NUM / 2; i += 2) {
+        expiry[i] = expiry[i] + time_val(1, 0);
+        queue.set_priority(handles[i], expiry[i]);
+    }
+    for (int i = 1; i < NUM / 2; i += 10) {
+        queue.remove(handles[i]);
+        fired[i] = true;
+    }
+
+    // Advance time in 7ms steps; each timer must fire at (or after) its expiry time, and no
+    // later than the end of the step in which its (rounded up) expiry falls:
+    time_val step {0, 7000000};
+    time_val now {0, 0};
+    while (now < time_val(102, 0)) {
+        now = now + step;
+        queue.advance(now);
+        while (! queue.empty() && queue.get_root_priority() <= now) {
+            handle_t &h = queue.get_root();
+            int i = (int)(uintptr_t) queue.node_data(h).userdata;
+            assert(! fired[i]);
+            assert(expiry[i] <= now);
+            assert(now < expiry[i] + step + time_val(0, 1000000));
+            fired[i] = true;
+            queue.pull_root();
+        }
+    }
+
+    for (int i = 0; i < NUM - 1; i++) {
+        assert(fired[i]);
+    }
+    assert(! queue.empty());
+    assert(! (queue.get_root_priority() < expiry[NUM - 1]));
+
+    now = time_val(300 * 24 * 60 * 60, 0);
+    queue.advance(now);
+    assert(&queue.get_root() == &handles[NUM - 1]);
+    queue.pull_root();
+    assert(queue.empty());
+
+    // If the time moves backwards, timers are still ordered correctly:
+    queue.insert(handles[0], time_val(300 * 24 * 60 * 60 + 10, 0));
+    queue.advance(time_val(5, 0));
+    queue.insert(handles[2], time_val(6, 0));
+    assert(queue.get_root_priority() <= time_val(6, 0));
+    queue.advance(time_val(6, 0));
+    assert(&queue.get_root() == &handles[2]);
+    assert(queue.get_root_priority() == time_val(6, 0));
+    queue.remove(handles[2]);
+    queue.remove(handles[0]);
+
+    for (int i = 0; i < NUM; i++) {
+        queue.deallocate(handles[i]);
+    }
+    delete[] handles;
+
+    // A node inserted into the overflow list, after the list was emptied by removing its earliest
+    // node, becomes the root (with 1us granularity, the wheel covers less than 3 hours):
+    {
+        using wheel_t = dasynq::timer_wheel<int, time_val, 1000>;
+        wheel_t wheel;
+        wheel_t::handle_t a, b;
+        wheel.allocate(a, 1);
+        wheel.allocate(b, 2);
+
+        time_val start {100, 0};
+        time_val later = start + time_val(3 * 60 * 60, 0);
+        wheel.advance(start);
+        assert(wheel.insert(a, later));
+        wheel.remove(a);
+        assert(wheel.insert(b, later));
+        assert(wheel.get_root_priority() == later);
+        assert(&wheel.get_root() == &b);
+        wheel.remove(b);
+
+        wheel.deallocate(a);
+        wheel.deallocate(b);
+    }
+}
+
+template <typename A, typename B, typename C> using dary_heap_4 = dasynq::dary_heap<A,B,C,4>;
+
+// The order in which check_queue expects a queue to return its elements:
+enum class queue_order
+{
+    PRIORITY,   // by priority (the root may be any element with the lowest priority)
+    STABLE,     // by priority, and in insertion order for elements of the same priority
+    FIFO        // in insertion order, regardless of priority
+};
+
+template <typename Queue, typename P>
+static void queue_set_priority(Queue &queue, typename Queue::handle_t &hnd, const P &p, std::true_type)
+{
+    queue.set_priority(hnd, p);
+}
+
+template <typename Queue, typename P>
+static void queue_set_priority(Queue &queue, typename Queue::handle_t &hnd, const P &p, std::false_type)
+{
+}
+
+// Check a queue against a simple search for the expected root, over a pseudo-random sequence of
+// insertions, removals of arbitrary elements, priority changes (if SetPriority is true; a changed element
+// keeps its place in the insertion order) and pulls of the root. The queue's elements are ints (num of
+// them are allocated, and deallocated once the queue is empty again); priorities are drawn from num_prios
+// distinct values, and converted to the queue's priority type by make_prio.
+template <bool SetPriority, typename Queue, typename MakeP>
+static void check_queue(Queue &queue, MakeP make_prio, queue_order qorder, int num_prios, int num = 200,
+        int steps = 20000)
+{
+    using handle_t = typename Queue::handle_t;
+    handle_t *handles = new handle_t[num];
+
+    // For each element: priority and insertion order (0 if not queued):
+    std::vector<int> prio(num);
+    std::vector<unsigned long> order(num, 0);
+    unsigned long next_order = 1;
+
+    for (int i = 0; i < num; i++) {
+        queue.allocate(handles[i], i);
+    }
+
+    auto expected_root = [&]() -> int {
+        int r = -1;
+        for (int i = 0; i < num; i++) {
+            if (order[i] == 0) continue;
+            if (r == -1) {
+                r = i;
+                continue;
+            }
+            bool before = (qorder == queue_order::FIFO) ? order[i] < order[r]
+                    : (prio[i] < prio[r] || (prio[i] == prio[r] && order[i] < order[r]));
+            if (before) r = i;
+        }
+        return r;
+    };
+
+    auto check_root = [&]() -> int {
+        int r = queue.node_data(queue.get_root());
+        int e = expected_root();
+        assert(order[r] != 0);
+        if (qorder == queue_order::PRIORITY) {
+            assert(prio[r] == prio[e]);
+        }
+        else {
+            assert(r == e);
+        }
+        return r;
+    };
+
+    unsigned rnd = 12345;
+    for (int step = 0; step < steps; step++) {
+        rnd = rnd * 1103515245u + 12345u;
+        int i = (rnd >> 8) % num;
+        int op = (rnd >> 28) % 4;
+        if (order[i] == 0) {
+            prio[i] = (rnd >> 12) % num_prios;
+            queue.insert(handles[i], make_prio(prio[i]));
+            order[i] = next_order++;
+        }
+        else if (op == 0) {
+            queue.remove(handles[i]);
+            order[i] = 0;
+        }
+        else if (op == 1 && SetPriority) {
+            prio[i] = (rnd >> 12) % num_prios;
+            queue_set_priority(queue, handles[i], make_prio(prio[i]),
+                    std::integral_constant<bool, SetPriority>());
+        }
+        else {
+            int r = check_root();
+            queue.pull_root();
+            order[r] = 0;
+        }
+        assert(queue.is_queued(handles[i]) == (order[i] != 0));
+    }
+
+    while (! queue.empty()) {
+        int r = check_root();
+        queue.pull_root();
+        order[r] = 0;
+    }
+    assert(expected_root() == -1);
+
+    for (int i = 0; i < num; i++) {
+        queue.deallocate(handles[i]);
+    }
+    delete[] handles;
+}
+
+// Test the compact stable heap, with an 8-bit sequence number so that the queued elements are frequently
+// renumbered: elements must still be dequeued in priority order, and in insertion order for elements of
+// the same priority.
+static void test_compact_stable_heap()
+{
+    dasynq::compact_stable_heap<dary_heap_4, int, int, std::less<int>, uint8_t> queue;
+    check_queue<false>(queue, [](int p) { return p; }, queue_order::STABLE, 4);
+}
+
+template <int N> struct soa_dary_heap_n
+{
+    template <typename A, typename B, typename C> using heap = dasynq::soa_dary_heap<A,B,C,N>;
+};
+
+// Test the structure-of-arrays d-ary heap with int priorities, compact stable priorities (with an 8-bit
+// sequence, so that the heap is frequently sorted for renumbering) and timer expiry times (for which a
+// SIMD child search may be used). With a fan-out of 8 or 16 (multiples of 4), the SIMD child search (if
+// enabled) compares several groups of children.
+template <int N> static void test_soa_dary_heap_n()
+{
+    {
+        dasynq::soa_dary_heap<int, int, std::less<int>, N> queue;
+        check_queue<true>(queue, [](int p) { return p; }, queue_order::PRIORITY, 16);
+    }
+    {
+        dasynq::compact_stable_heap<soa_dary_heap_n<N>::template heap, int, int, std::less<int>, uint8_t> queue;
+        check_queue<false>(queue, [](int p) { return p; }, queue_order::STABLE, 16);
+    }
+    {
+        // (the full key is used, with the nanoseconds field also significant):
+        dasynq::soa_dary_heap<int, dasynq::time_val, dasynq::compare_timespec, N> queue;
+        check_queue<true>(queue, [](int p) { return dasynq::time_val(p / 4, (p % 4) * 250000000); },
+                queue_order::PRIORITY, 16);
+    }
+}
+
+static void test_soa_dary_heap()
+{
+    test_soa_dary_heap_n<4>();
+    test_soa_dary_heap_n<8>();
+    test_soa_dary_heap_n<16>();
+}
+
+// Test the d-ary heap, with removal of arbitrary elements (after which the node moved into the vacated
+// position may need to move towards the root) and priority changes.
+static void test_dary_heap()
+{
+    dasynq::dary_heap<int, int> queue;
+    check_queue<true>(queue, [](int p) { return p; }, queue_order::PRIORITY, 1000, 200, 50000);
+}
+
+// Test the bucket queue: elements are dequeued in priority order, and in insertion order for elements of
+// the same priority, including after removal of arbitrary elements and re-use of priorities (with a few
+// distinct priorities, and with many).
+static void test_bucket_queue()
+{
+    using queue_t = dasynq::bucket_queue<int, int>;
+    using handle_t = queue_t::handle_t;
+
+    queue_t queue;
+    check_queue<false>(queue, [](int p) { return p - 2; }, queue_order::STABLE, 5, 1000);
+    check_queue<false>(queue, [](int p) { return p - 2; }, queue_order::STABLE, 250, 1000);
+
+    // Insert returns true when an element becomes the root:
+    handle_t handles[4];
+    for (int i = 0; i < 4; i++) {
+        queue.allocate(handles[i], i);
+    }
+    assert(queue.insert(handles[0], 10));
+    assert(! queue.insert(handles[1], 10));
+    assert(queue.insert(handles[2], 5));
+    assert(! queue.insert(handles[3], 20));
+    assert(&queue.get_root() == &handles[2]);
+    assert(queue.get_root_priority() == 5);
+    queue.remove(handles[2]);
+    assert(&queue.get_root() == &handles[0]);
+    queue.pull_root();
+    queue.pull_root();
+    assert(&queue.get_root() == &handles[3]);
+    queue.pull_root();
+    assert(queue.empty());
+
+    for (int i = 0; i < 4; i++) {
+        queue.deallocate(handles[i]);
+    }
+}
+
+// Test the FIFO queue: elements are dequeued in insertion order, regardless of priority, including after
+// removal of arbitrary elements and when the storage is compacted.
+static void test_fifo_queue()
+{
+    using queue_t = dasynq::fifo_queue<int, int>;
+    using handle_t = queue_t::handle_t;
+
+    constexpr int NUM = 1000;
+    queue_t queue;
+    check_queue<false>(queue, [](int p) { return p; }, queue_order::FIFO, 100, NUM);
+
+    handle_t *handles = new handle_t[NUM];
+    for (int i = 0; i < NUM; i++) {
+        queue.allocate(handles[i], i);
+    }
+
+    // Queue and remove an element repeatedly while others remain queued, so that the storage fills with
+    // removed elements and must be compacted:
+    for (int i = 0; i < NUM; i++) {
+        queue.insert(handles[i], NUM - i);
+    }
+    for (int i = 0; i < NUM; i++) {
+        assert(queue.node_data(queue.get_root()) == i);
+        queue.pull_root();
+        assert(! queue.is_queued(handles[i]));
+        if (i < NUM / 2) {
+            for (int j = 0; j < 8; j++) {
+                queue.insert(handles[i]);
+                queue.remove(handles[i]);
+            }
+        }
+    }
+    assert(queue.empty());
+
+    // Insert returns true when an element becomes the root:
+    assert(queue.insert(handles[0], 10));
+    assert(! queue.insert(handles[1], 5));
+    assert(! queue.insert(handles[2], 1));
+    queue.remove(handles[0]);
+    assert(&queue.get_root() == &handles[1]);
+    queue.remove(handles[2]);
+    assert(&queue.get_root() == &handles[1]);
+    queue.pull_root();
+    assert(queue.empty());
+
+    for (int i = 0; i < NUM; i++) {
+        queue.deallocate(handles[i]);
+    }
+    delete[] handles;
+}
+
+// As test_timers_1, but with a timer wheel as the timer queue:
+static void test_timers_wheel()
+{
+    using dasynq::clock_type;
+    using dasynq::time_val;
+    using loop_t = dasynq::event_loop<checking_mutex, test_wheel_traits>;
+    loop_t my_loop;
+
+    class my_timer : public loop_t::timer_impl<my_timer>
+    {
+        public:
+        rearm timer_expiry(loop_t &loop, int expiry_count)
+        {
+            expiries += expiry_count;
+            return rearm::REARM;
+        }
+
+        int expiries = 0;
+    };
+
+    // First timer is a one-shot timer expiring at 3 seconds:
+    my_timer timer_1;
+    struct timespec timeout_1 = { .tv_sec = 3, .tv_nsec = 0 };
+    timer_1.add_timer(my_loop, clock_type::MONOTONIC);
+    timer_1.arm_timer(my_loop, timeout_1);
+
+    // Second timer expires at 4 seconds and then every 1 second after:
+    my_timer timer_2;
+    struct timespec timeout_2 = { .tv_sec = 4, .tv_nsec = 0 };
+    struct timespec interval_2 = { .tv_sec = 1, .tv_nsec = 0 };
+    timer_2.add_timer(my_loop, clock_type::MONOTONIC);
+    timer_2.arm_timer(my_loop, timeout_2, interval_2);
+
+    test_io_engine::cur_mono_time = time_val(0, 0);
+    my_loop.poll();
+    assert(timer_1.expiries == 0);
+    assert(timer_2.expiries == 0);
+
+    test_io_engine::cur_mono_time = time_val(2, 999000000);
+    my_loop.poll();
+    assert(timer_1.expiries == 0);
+    assert(timer_2.expiries == 0);
+
+    test_io_engine::cur_mono_time = time_val(3, 0);
+    my_loop.poll();
+    assert(timer_1.expiries == 1);
+    assert(timer_2.expiries == 0);
+
+    test_io_engine::cur_mono_time = time_val(4, 500000000);
+    my_loop.poll();
+    assert(timer_1.expiries == 1);
+    assert(timer_2.expiries == 1);
+
+    test_io_engine::cur_mono_time = time_val(5, 500000000);
+    my_loop.poll();
+    assert(timer_1.expiries == 1);
+    assert(timer_2.expiries == 2);
+
+    // Re-arming the first timer moves it:
+    timer_1.arm_timer(my_loop, time_val(7, 0));
+    timer_1.arm_timer(my_loop, time_val(6, 0));
+    test_io_engine::cur_mono_time = time_val(6, 0);
+    my_loop.poll();
+    assert(timer_1.expiries == 2);
+    assert(timer_2.expiries == 3);
+
+    timer_1.deregister(my_loop);
+    timer_2.deregister(my_loop);
+}
+
+static void test_timer_slack()
+{
+    using dasynq::clock_type;
+    using dasynq::time_val;
+    using loop_t = Loop_t;
+    loop_t my_loop;
+
+    class my_timer : public loop_t::timer_impl<my_timer>
+    {
+        public:
+        rearm timer_expiry(loop_t &loop, int expiry_count)
+        {
+            expiries += expiry_count;
+            return rearm::REARM;
+        }
+
+        int expiries = 0;
+    };
+
+    test_io_engine::cur_mono_time = time_val(0, 0);
+
+    // Timer 1 expires at 3 seconds, but may be delayed by up to 2 seconds:
+    my_timer timer_1;
+    timer_1.add_timer(my_loop, clock_type::MONOTONIC);
+    timer_1.set_slack(my_loop, time_val(2, 0));
+    timer_1.arm_timer(my_loop, time_val(3, 0));
+
+    // Timer 2 expires at 4 seconds, with no slack:
+    my_timer timer_2;
+    timer_2.add_timer(my_loop, clock_type::MONOTONIC);
+    timer_2.arm_timer(my_loop, time_val(4, 0));
+
+    // Timer 1 is delayed, and expires together with timer 2:
+    test_io_engine::cur_mono_time = time_val(3, 500000000);
+    my_loop.poll();
+    assert(timer_1.expiries == 0);
+    assert(timer_2.expiries == 0);
+
+    test_io_engine::cur_mono_time = time_val(4, 0);
+    my_loop.poll();
+    assert(timer_1.expiries == 1);
+    assert(timer_2.expiries == 1);
+
+    // With only timer 1 queued, it expires at its timeout (if the loop is polled then):
+    timer_1.arm_timer(my_loop, time_val(6, 0));
+    test_io_engine::cur_mono_time = time_val(6, 0);
+    my_loop.poll();
+    assert(timer_1.expiries == 2);
+
+    // Periodic timer with slack: the slack does not accumulate over intervals.
+    timer_1.set_slack(my_loop, time_val(0, 500000000));
+    timer_1.arm_timer(my_loop, time_val(10, 0), time_val(1, 0));
+    test_io_engine::cur_mono_time = time_val(10, 200000000);
+    my_loop.poll();
+    assert(timer_1.expiries == 3);
+
+    test_io_engine::cur_mono_time = time_val(10, 900000000);
+    my_loop.poll();
+    assert(timer_1.expiries == 3);
+
+    test_io_engine::cur_mono_time = time_val(11, 0);
+    my_loop.poll();
+    assert(timer_1.expiries == 4);
+
+    timer_1.deregister(my_loop);
+    timer_2.deregister(my_loop);
+}
+
 static void test_timers_2()
 {
     using dasynq::clock_type;
@@ -757,73 +1260,315 @@ void ftest_fd_watch1()
     close(pipe2[1]);
 }
 
-void ftest_bidi_fd_watch1()
+// Check that a sequence of enable/disable operations between polls has the effect of the last operation
+void ftest_fd_watch2()
 {
     using Loop_t = dasynq::event_loop<checking_mutex>;
     Loop_t my_loop;
 
-    bool flags1[3] = { false, false, false };  // in, out, removed
+    int seen = 0;
 
     int pipe1[2];
-    create_bidi_pipe(pipe1);
-
-    class MyBidiWatcher : public Loop_t::bidi_fd_watcher_impl<MyBidiWatcher> {
-        bool (&flags)[3];
-
-        public:
-        MyBidiWatcher(bool (&flags_a)[3]) : flags(flags_a)
-        {
-        }
-
-        rearm read_ready(Loop_t &eloop, int fd) noexcept
-        {
-            flags[0] = true;
-            char rbuf;
-            read(fd, &rbuf, 1);
-            return rearm::REMOVE;
-        }
-
-        rearm write_ready(Loop_t &eloop, int fd) noexcept
-        {
-            flags[1] = true;
-            return rearm::REMOVE;
-        }
+    create_pipe(pipe1);
 
-        void watch_removed() noexcept override
-        {
-            flags[2] = true;
-        }
-    };
+    auto *watcher = Loop_t::fd_watcher::add_watch(my_loop, pipe1[0], dasynq::IN_EVENTS,
+            [&seen](Loop_t &eloop, int fd, int flags) -> rearm {
+        seen++;
+        return rearm::REARM;
+    });
 
-    MyBidiWatcher watch {flags1};
+    char wbuf[1] = {'a'};
+    write(pipe1[1], wbuf, 1);
 
-    // Both read and write trigger remove. Once both have triggered, the watch should auto-remove.
+    watcher->set_enabled(my_loop, false);
+    watcher->set_enabled(my_loop, true);
+    my_loop.poll();
+    assert(seen == 1);
 
-    char wbuf = 'a';
-    write(pipe1[1], &wbuf, 1);
+    // Watch remains enabled (REARM):
+    my_loop.poll();
+    assert(seen == 2);
 
-    watch.add_watch(my_loop, pipe1[0], dasynq::IN_EVENTS | dasynq::OUT_EVENTS);
+    watcher->set_enabled(my_loop, false);
+    watcher->set_enabled(my_loop, true);
+    watcher->set_enabled(my_loop, false);
+    my_loop.poll();
+    assert(seen == 2);
 
-    my_loop.run();
+    watcher->set_enabled(my_loop, true);
+    my_loop.poll();
+    assert(seen == 3);
 
-    assert(flags1[0] && flags1[1]);   // in and out flag should be set
-    assert(flags1[2]);
+    watcher->deregister(my_loop);
 
     close(pipe1[0]);
     close(pipe1[1]);
 }
 
-void ftest_bidi_fd_watch2()
+// Check that a watch change cancelled by removal of the watch (leaving its fd in the list of pending
+// changes) doesn't cause the fd to be listed twice when a new watch for the same fd is changed
+void ftest_fd_watch_relink()
 {
     using Loop_t = dasynq::event_loop<checking_mutex>;
     Loop_t my_loop;
 
-    bool flags1[3] = { false, false, false };  // in, out, removed
+    int seen1 = 0;
+    int seen2 = 0;
 
     int pipe1[2];
-    create_bidi_pipe(pipe1);
-
-    class MyBidiWatcher : public Loop_t::bidi_fd_watcher_impl<MyBidiWatcher> {
+    int pipe2[2];
+    create_pipe(pipe1);
+    create_pipe(pipe2);
+
+    auto *watcher1 = Loop_t::fd_watcher::add_watch(my_loop, pipe1[0], dasynq::IN_EVENTS,
+            [&seen1](Loop_t &eloop, int fd, int flags) -> rearm {
+        seen1++;
+        return rearm::REARM;
+    });
+
+    auto *watcher2 = Loop_t::fd_watcher::add_watch(my_loop, pipe2[0], dasynq::IN_EVENTS,
+            [](Loop_t &eloop, int fd, int flags) -> rearm {
+        return rearm::REARM;
+    });
+
+    watcher2->set_enabled(my_loop, false);
+    watcher1->set_enabled(my_loop, false);
+    watcher2->deregister(my_loop);
+
+    watcher2 = Loop_t::fd_watcher::add_watch(my_loop, pipe2[0], dasynq::IN_EVENTS,
+            [&seen2](Loop_t &eloop, int fd, int flags) -> rearm {
+        seen2++;
+        return rearm::REARM;
+    });
+    watcher2->set_enabled(my_loop, false);
+
+    char wbuf[1] = {'a'};
+    write(pipe1[1], wbuf, 1);
+    write(pipe2[1], wbuf, 1);
+
+    my_loop.poll();
+    assert(seen1 == 0 && seen2 == 0);
+
+    watcher1->set_enabled(my_loop, true);
+    watcher2->set_enabled(my_loop, true);
+    my_loop.poll();
+    assert(seen1 == 1 && seen2 == 1);
+
+    watcher1->deregister(my_loop);
+    watcher2->deregister(my_loop);
+
+    close(pipe1[0]);
+    close(pipe1[1]);
+    close(pipe2[0]);
+    close(pipe2[1]);
+}
+
+// Check that events are delivered for a large number of simultaneously ready descriptors
+void ftest_fd_watch3()
+{
+    using Loop_t = dasynq::event_loop<checking_mutex>;
+    Loop_t my_loop;
+
+    constexpr int num_pipes = 200;
+    int pipes[num_pipes][2];
+    int seen = 0;
+
+    for (int i = 0; i < num_pipes; i++) {
+        create_pipe(pipes[i]);
+        Loop_t::fd_watcher::add_watch(my_loop, pipes[i][0], dasynq::IN_EVENTS,
+                [&seen](Loop_t &eloop, int fd, int flags) -> rearm {
+            seen++;
+            return rearm::REMOVE;
+        });
+    }
+
+    char wbuf[1] = {'a'};
+    for (int i = 0; i < num_pipes; i++) {
+        write(pipes[i][1], wbuf, 1);
+    }
+
+    while (seen < num_pipes) {
+        my_loop.run();
+    }
+
+#if DASYNQ_HAVE_EPOLL && ! DASYNQ_HAVE_IO_URING
+    // full batches should have caused the batch size to grow
+    assert(my_loop.get_backend().get_event_batch_size() > 16);
+#endif
+
+    for (int i = 0; i < num_pipes; i++) {
+        close(pipes[i][0]);
+        close(pipes[i][1]);
+    }
+}
+
+class fixed_batch_traits : public dasynq::default_traits<checking_mutex>
+{
+    public:
+    constexpr static int event_batch = 4;
+    constexpr static int max_event_batch = 4;
+};
+
+// Check that the event batch size can be fixed via the loop traits
+void ftest_fd_watch_fixed_batch()
+{
+    using Loop_t = dasynq::event_loop<checking_mutex, fixed_batch_traits>;
+    Loop_t my_loop;
+
+    constexpr int num_pipes = 20;
+    int pipes[num_pipes][2];
+    int seen = 0;
+
+    for (int i = 0; i < num_pipes; i++) {
+        create_pipe(pipes[i]);
+        Loop_t::fd_watcher::add_watch(my_loop, pipes[i][0], dasynq::IN_EVENTS,
+                [&seen](Loop_t &eloop, int fd, int flags) -> rearm {
+            seen++;
+            return rearm::REMOVE;
+        });
+    }
+
+    char wbuf[1] = {'a'};
+    for (int i = 0; i < num_pipes; i++) {
+        write(pipes[i][1], wbuf, 1);
+    }
+
+    while (seen < num_pipes) {
+        my_loop.run();
+    }
+
+#if DASYNQ_HAVE_EPOLL && ! DASYNQ_HAVE_IO_URING
+    assert(my_loop.get_backend().get_event_batch_size() == 4);
+#endif
+
+    for (int i = 0; i < num_pipes; i++) {
+        close(pipes[i][0]);
+        close(pipes[i][1]);
+    }
+}
+
+// Edge-triggered fd watch
+void ftest_fd_watch_edge()
+{
+    using Loop_t = dasynq::event_loop<checking_mutex>;
+    Loop_t my_loop;
+
+    int seen = 0;
+    bool disarm = false;
+
+    int pipe1[2];
+    create_pipe(pipe1);
+    fcntl(pipe1[0], F_SETFL, O_NONBLOCK);
+
+    auto *watcher = Loop_t::fd_watcher::add_watch(my_loop, pipe1[0], dasynq::IN_EVENTS | dasynq::EDGE_TRIGGERED,
+            [&seen, &disarm](Loop_t &eloop, int fd, int flags) -> rearm {
+        seen++;
+        char rbuf[16];
+        while (read(fd, rbuf, 16) > 0) { }
+        return disarm ? rearm::DISARM : rearm::REARM;
+    });
+
+    char wbuf[1] = {'a'};
+    write(pipe1[1], wbuf, 1);
+    my_loop.run();
+    assert(seen == 1);
+
+    // Drained; no further events until more data arrives:
+    my_loop.poll();
+    assert(seen == 1);
+
+    write(pipe1[1], wbuf, 1);
+    write(pipe1[1], wbuf, 1);
+    my_loop.run();
+    assert(seen == 2);
+
+    disarm = true;
+    write(pipe1[1], wbuf, 1);
+    my_loop.run();
+    assert(seen == 3);
+
+    write(pipe1[1], wbuf, 1);
+    my_loop.poll();
+    assert(seen == 3);
+
+    disarm = false;
+    watcher->set_enabled(my_loop, true);
+    my_loop.run();
+    assert(seen == 4);
+
+    watcher->deregister(my_loop);
+
+    close(pipe1[0]);
+    close(pipe1[1]);
+}
+
+void ftest_bidi_fd_watch1()
+{
+    using Loop_t = dasynq::event_loop<checking_mutex>;
+    Loop_t my_loop;
+
+    bool flags1[3] = { false, false, false };  // in, out, removed
+
+    int pipe1[2];
+    create_bidi_pipe(pipe1);
+
+    class MyBidiWatcher : public Loop_t::bidi_fd_watcher_impl<MyBidiWatcher> {
+        bool (&flags)[3];
+
+        public:
+        MyBidiWatcher(bool (&flags_a)[3]) : flags(flags_a)
+        {
+        }
+
+        rearm read_ready(Loop_t &eloop, int fd) noexcept
+        {
+            flags[0] = true;
+            char rbuf;
+            read(fd, &rbuf, 1);
+            return rearm::REMOVE;
+        }
+
+        rearm write_ready(Loop_t &eloop, int fd) noexcept
+        {
+            flags[1] = true;
+            return rearm::REMOVE;
+        }
+
+        void watch_removed() noexcept override
+        {
+            flags[2] = true;
+        }
+    };
+
+    MyBidiWatcher watch {flags1};
+
+    // Both read and write trigger remove. Once both have triggered, the watch should auto-remove.
+
+    char wbuf = 'a';
+    write(pipe1[1], &wbuf, 1);
+
+    watch.add_watch(my_loop, pipe1[0], dasynq::IN_EVENTS | dasynq::OUT_EVENTS);
+
+    my_loop.run();
+
+    assert(flags1[0] && flags1[1]);   // in and out flag should be set
+    assert(flags1[2]);
+
+    close(pipe1[0]);
+    close(pipe1[1]);
+}
+
+void ftest_bidi_fd_watch2()
+{
+    using Loop_t = dasynq::event_loop<checking_mutex>;
+    Loop_t my_loop;
+
+    bool flags1[3] = { false, false, false };  // in, out, removed
+
+    int pipe1[2];
+    create_bidi_pipe(pipe1);
+
+    class MyBidiWatcher : public Loop_t::bidi_fd_watcher_impl<MyBidiWatcher> {
         bool (&flags)[3];
 
         public:
@@ -1248,6 +1993,107 @@ void ftest_timers4()
     timer_2.deregister(my_loop);
 }
 
+// function test for timers with a timing wheel as the timer queue
+void ftest_timers_wheel()
+{
+    class wheel_traits : public dasynq::default_traits<checking_mutex>
+    {
+        public:
+        using timer_queue_t = dasynq::timer_wheel_queue_t<>;
+    };
+
+    using loop_t = dasynq::event_loop<checking_mutex, wheel_traits>;
+    using clock_type = dasynq::clock_type;
+    using dasynq::time_val;
+    loop_t my_loop;
+
+    class my_timer : public loop_t::timer_impl<my_timer>
+    {
+        public:
+        rearm timer_expiry(loop_t &loop, int expiry_count)
+        {
+            expiries += expiry_count;
+            return rearm::DISARM;
+        }
+
+        int expiries = 0;
+    };
+
+    my_timer timers[3];
+    for (int i = 0; i < 3; i++) {
+        timers[i].add_timer(my_loop, clock_type::MONOTONIC);
+    }
+
+    time_val start;
+    my_loop.get_time(start, clock_type::MONOTONIC, true);
+
+    // Timer 0 is re-armed (later) before it expires, and timer 2 is stopped:
+    timers[0].arm_timer_rel(my_loop, time_val(0, 20000000));
+    timers[1].arm_timer_rel(my_loop, time_val(0, 50000000));
+    timers[2].arm_timer_rel(my_loop, time_val(0, 30000000));
+    timers[0].arm_timer_rel(my_loop, time_val(0, 60000000));
+    timers[2].stop_timer(my_loop);
+
+    while (timers[0].expiries == 0) {
+        my_loop.run();
+    }
+
+    time_val now;
+    my_loop.get_time(now, clock_type::MONOTONIC, true);
+    assert(! (now < start + time_val(0, 60000000)));
+    assert(timers[1].expiries == 1);
+    assert(timers[2].expiries == 0);
+
+    for (int i = 0; i < 3; i++) {
+        timers[i].deregister(my_loop);
+    }
+}
+
+void ftest_timer_slack()
+{
+    using loop_t = dasynq::event_loop<checking_mutex>;
+    using clock_type = dasynq::clock_type;
+    using dasynq::time_val;
+    loop_t my_loop;
+
+    class my_timer : public loop_t::timer_impl<my_timer>
+    {
+        public:
+        time_val expiry_time;
+        int expiries = 0;
+
+        rearm timer_expiry(loop_t &loop, int expiry_count)
+        {
+            loop.get_time(expiry_time, clock_type::MONOTONIC, true);
+            expiries += expiry_count;
+            return rearm::DISARM;
+        }
+    };
+
+    my_timer timer_1;
+    my_timer timer_2;
+    timer_1.add_timer(my_loop, clock_type::MONOTONIC);
+    timer_2.add_timer(my_loop, clock_type::MONOTONIC);
+
+    time_val start;
+    my_loop.get_time(start, clock_type::MONOTONIC, true);
+
+    // Timer 1 (at 20ms, with 50ms slack) should expire along with timer 2 (at 40ms):
+    timer_1.set_slack(my_loop, time_val(0, 50000000));
+    timer_1.arm_timer(my_loop, start + time_val(0, 20000000));
+    timer_2.arm_timer(my_loop, start + time_val(0, 40000000));
+
+    while (timer_1.expiries == 0 || timer_2.expiries == 0) {
+        my_loop.run();
+    }
+
+    assert(! (timer_1.expiry_time < start + time_val(0, 40000000)));
+    assert(! (timer_2.expiry_time < start + time_val(0, 40000000)));
+
+    timer_1.deregister(my_loop);
+    timer_2.deregister(my_loop);
+}
+
 void ftest_multi_thread1()
 {
     using Loop_t = dasynq::event_loop<std::mutex>;
@@ -1470,25 +2316,1422 @@ void ftest_multi_thread4()
     fwatch1.deregister(my_loop);
 }
 
-void ftest_child_watch()
+// Test adaptive_mutex under contention, and waiting on an adaptive_condvar.
+void test_adaptive_mutex()
 {
-    using loop_t = dasynq::event_loop<std::mutex>;
-    loop_t my_loop;
+    dasynq::adaptive_mutex m;
+    dasynq::adaptive_condvar cv;
+
+    const int num_threads = 4;
+    const int iterations = 10000;
+    int count = 0;
+    int finished = 0;
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; i++) {
+        threads.emplace_back([&]() {
+            for (int j = 0; j < iterations; j++) {
+                std::lock_guard<dasynq::adaptive_mutex> guard(m);
+                count++;
+            }
+            std::lock_guard<dasynq::adaptive_mutex> guard(m);
+            finished++;
+            cv.notify_one();
+        });
+    }
 
-    class my_child_proc_watcher : public loop_t::child_proc_watcher_impl<my_child_proc_watcher>
     {
-        public:
-        bool did_exit = false;
-
-        rearm status_change(loop_t &, pid_t child, int status)
-        {
-            did_exit = true;
-            return rearm::DISARM;
+        std::unique_lock<dasynq::adaptive_mutex> lock(m);
+        while (finished != num_threads) {
+            cv.wait(lock);
         }
-    };
+        assert(lock.owns_lock());
+        assert(count == num_threads * iterations);
+    }
 
-    pid_t child_pid;
-    my_child_proc_watcher my_child_watcher;
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    assert(m.try_lock());
+    m.unlock();
+}
+
+// Test the wait queue used for the loop's internal locks: ownership is handed directly from one
+// thread to the next (wait_handoff), and only one thread holds the lock at a time.
+void test_waitqueue_handoff()
+{
+    using namespace dasynq::dprivate;
+
+    std::mutex m;
+    waitqueue<std::mutex> queue;
+
+    const int num_threads = 4;
+    const int iterations = 2000;
+    int holders = 0;
+    int count = 0;
+
+    auto acquire = [&](waitqueue_node<std::mutex> &qnode) {
+        std::unique_lock<std::mutex> ulock(m);
+        queue.queue(&qnode);
+        if (! queue.check_head(qnode)) {
+            qnode.wait_handoff(ulock);
+        }
+    };
+
+    auto release = [&]() {
+        std::lock_guard<std::mutex> guard(m);
+        waitqueue_node<std::mutex> *nhead = queue.unqueue();
+        if (nhead != nullptr) {
+            nhead->signal();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; i++) {
+        threads.emplace_back([&]() {
+            for (int j = 0; j < iterations; j++) {
+                waitqueue_node<std::mutex> qnode;
+                acquire(qnode);
+                // (holders and count are protected by the queue itself, not by m):
+                assert(++holders == 1);
+                count++;
+                holders--;
+                release();
+            }
+        });
+    }
+
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    assert(count == num_threads * iterations);
+    assert(queue.is_empty());
+}
+
+// Test that watchers are dispatched in parallel when the loop is run by multiple threads: in each
+// round, two watchers become ready at (about) the same time, and each waits for the other to be
+// running.
+template <typename T_Mutex = std::mutex>
+void ftest_parallel_dispatch()
+{
+    using Loop_t = dasynq::event_loop<T_Mutex>;
+    Loop_t my_loop;
+
+    const int rounds = 20;
+
+    std::mutex m;
+    std::condition_variable cv;
+    int running = 0;
+    int completed = 0;
+    int timeouts = 0;
+    bool done = false;
+
+    auto wait_for_other = [&]() {
+        std::unique_lock<std::mutex> lock(m);
+        int round = completed / 2;
+        running++;
+        cv.notify_all();
+        if (! cv.wait_for(lock, std::chrono::seconds(1), [&]() { return running >= (round + 1) * 2; })) {
+            timeouts++;
+        }
+        completed++;
+        cv.notify_all();
+    };
+
+    int pipe1[2];
+    int pipe2[2];
+    create_pipe(pipe1);
+    create_pipe(pipe2);
+
+    auto handler = [&](Loop_t &eloop, int fd, int flags) -> rearm {
+        {
+            // Once done, leave the pipe readable, so that both threads return from run():
+            std::lock_guard<std::mutex> guard(m);
+            if (done) return rearm::REARM;
+        }
+        char rbuf[1];
+        read(fd, rbuf, 1);
+        wait_for_other();
+        return rearm::REARM;
+    };
+
+    auto fwatch1 = Loop_t::fd_watcher::add_watch(my_loop, pipe1[0], dasynq::IN_EVENTS, handler);
+    auto fwatch2 = Loop_t::fd_watcher::add_watch(my_loop, pipe2[0], dasynq::IN_EVENTS, handler);
+
+    auto run_loop = [&]() -> void {
+        while (true) {
+            {
+                std::lock_guard<std::mutex> guard(m);
+                if (done) break;
+            }
+            my_loop.run();
+        }
+    };
+
+    std::thread t1(run_loop);
+    std::thread t2(run_loop);
+
+    char wbuf[1] = {'a'};
+    for (int i = 0; i < rounds; i++) {
+        write(pipe1[1], wbuf, 1);
+        write(pipe2[1], wbuf, 1);
+
+        std::unique_lock<std::mutex> lock(m);
+        cv.wait(lock, [&]() { return completed == (i + 1) * 2; });
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(m);
+        done = true;
+    }
+    // Wake the threads:
+    write(pipe1[1], wbuf, 1);
+    write(pipe2[1], wbuf, 1);
+
+    t1.join();
+    t2.join();
+
+    assert(timeouts == 0);
+
+    fwatch1->deregister(my_loop);
+    fwatch2->deregister(my_loop);
+
+    close(pipe1[0]);
+    close(pipe1[1]);
+    close(pipe2[0]);
+    close(pipe2[1]);
+}
+
+// Test a loop group: watchers are distributed amongst the loops, child watches are confined to one
+// loop, and an idle thread processes events queued in another loop (two watchers in the first loop
+// are ready at once, and each waits for the other to be running).
+void ftest_loop_group()
+{
+    using Loop_t = dasynq::event_loop<std::mutex>;
+    dasynq::loop_group<Loop_t> group(2);
+
+    assert(group.size() == 2);
+    assert(&group.next_loop() != &group.next_loop());
+    assert(&group.get_loop(3) == &group.get_loop(1));
+    assert(&group.child_loop() == &group.get_loop(0));
+
+    Loop_t::child_proc_watcher cwatch;
+    bool threw = false;
+    try {
+        cwatch.reserve_watch(group.get_loop(1));
+    }
+    catch (std::system_error &) {
+        threw = true;
+    }
+    assert(threw);
+    cwatch.reserve_watch(group.child_loop());
+    cwatch.unreserve(group.child_loop());
+
+    std::mutex m;
+    std::condition_variable cv;
+    int running = 0;
+    int completed = 0;
+    int timeouts = 0;
+
+    int pipe1[2];
+    int pipe2[2];
+    int wake_pipe[2];
+    create_pipe(pipe1);
+    create_pipe(pipe2);
+    create_pipe(wake_pipe);
+
+    Loop_t &loop0 = group.get_loop(0);
+    Loop_t &loop1 = group.get_loop(1);
+
+    auto handler = [&](Loop_t &eloop, int fd, int flags) -> rearm {
+        char rbuf[1];
+        read(fd, rbuf, 1);
+        // Wake the other thread, which should then run the other watcher:
+        write(wake_pipe[1], rbuf, 1);
+        std::unique_lock<std::mutex> lock(m);
+        running++;
+        cv.notify_all();
+        if (! cv.wait_for(lock, std::chrono::seconds(1), [&]() { return running == 2; })) {
+            timeouts++;
+        }
+        completed++;
+        cv.notify_all();
+        return rearm::DISARM;
+    };
+
+    auto fwatch1 = Loop_t::fd_watcher::add_watch(loop0, pipe1[0], dasynq::IN_EVENTS, handler);
+    auto fwatch2 = Loop_t::fd_watcher::add_watch(loop0, pipe2[0], dasynq::IN_EVENTS, handler);
+    auto wwatch = Loop_t::fd_watcher::add_watch(loop1, wake_pipe[0], dasynq::IN_EVENTS,
+            [](Loop_t &eloop, int fd, int flags) -> rearm {
+                char rbuf[1];
+                read(fd, rbuf, 1);
+                return rearm::REARM;
+            });
+
+    // Make both watchers ready before the threads start, so that they are received together:
+    char wbuf[1] = {'a'};
+    write(pipe1[1], wbuf, 1);
+    write(pipe2[1], wbuf, 1);
+
+    group.start(false);
+
+    {
+        std::unique_lock<std::mutex> lock(m);
+        cv.wait(lock, [&]() { return completed == 2; });
+    }
+
+    group.stop();
+
+    assert(timeouts == 0);
+
+    fwatch1->deregister(loop0);
+    fwatch2->deregister(loop0);
+    wwatch->deregister(loop1);
+
+    close(pipe1[0]);
+    close(pipe1[1]);
+    close(pipe2[0]);
+    close(pipe2[1]);
+    close(wake_pipe[0]);
+    close(wake_pipe[1]);
+}
+
+void ftest_notifier()
+{
+    using Loop_t = dasynq::event_loop<std::mutex>;
+    Loop_t my_loop;
+
+    int seen = 0;
+
+    auto *n = Loop_t::notifier::add_watch(my_loop, [&seen](Loop_t &eloop) -> rearm {
+        seen++;
+        return rearm::REARM;
+    });
+
+    // Multiple notifications are coalesced:
+    n->notify(my_loop);
+    n->notify(my_loop);
+    my_loop.run();
+    assert(seen == 1);
+
+    my_loop.poll();
+    assert(seen == 1);
+
+    // Notification retained while disabled:
+    n->set_enabled(my_loop, false);
+    n->notify(my_loop);
+    my_loop.poll();
+    assert(seen == 1);
+    n->set_enabled(my_loop, true);
+    my_loop.poll();
+    assert(seen == 2);
+
+    // Notification from another thread wakes the loop:
+    std::thread t([&my_loop]() -> void {
+        my_loop.run();
+    });
+
+    n->notify(my_loop);
+    t.join();
+    assert(seen == 3);
+
+    n->deregister(my_loop);
+}
+
+// Test asynchronous deregistration: watchers are deregistered (without blocking) while another thread
+// is waiting for events, and are removed by that thread.
+void ftest_deregister_async()
+{
+    using Loop_t = dasynq::event_loop<std::mutex>;
+    Loop_t my_loop;
+
+    std::mutex m;
+    std::condition_variable cv;
+    int removed = 0;
+
+    class my_fd_watcher : public Loop_t::fd_watcher_impl<my_fd_watcher>
+    {
+        public:
+        std::function<void()> on_removed;
+
+        rearm fd_event(Loop_t &eloop, int fd, int flags)
+        {
+            return rearm::REARM;
+        }
+
+        void watch_removed() noexcept override
+        {
+            on_removed();
+        }
+    };
+
+    class my_timer : public Loop_t::timer_impl<my_timer>
+    {
+        public:
+        std::function<void()> on_removed;
+
+        rearm timer_expiry(Loop_t &eloop, int expiry_count)
+        {
+            return rearm::REARM;
+        }
+
+        void watch_removed() noexcept override
+        {
+            on_removed();
+        }
+    };
+
+    auto on_removed = [&]() {
+        std::lock_guard<std::mutex> guard(m);
+        removed++;
+        cv.notify_all();
+    };
+
+    int pipe1[2];
+    create_pipe(pipe1);
+
+    my_fd_watcher fwatch;
+    fwatch.on_removed = on_removed;
+    fwatch.add_watch(my_loop, pipe1[0], dasynq::IN_EVENTS);
+
+    my_timer timer1;
+    timer1.on_removed = on_removed;
+    timer1.add_timer(my_loop);
+    timer1.arm_timer_rel(my_loop, timespec {60, 0});
+
+    bool done = false;
+    auto *n = Loop_t::notifier::add_watch(my_loop, [&](Loop_t &eloop) -> rearm {
+        done = true;
+        return rearm::REARM;
+    });
+
+    std::thread t([&]() -> void {
+        while (! done) {
+            my_loop.run();
+        }
+    });
+
+    // Allow the thread to start waiting:
+    struct timespec t100ms;
+    t100ms.tv_sec = 0;
+    t100ms.tv_nsec = 100 * 1000 * 1000;
+    nanosleep(&t100ms, nullptr);
+
+    fwatch.deregister_async(my_loop);
+    timer1.deregister_async(my_loop);
+
+    {
+        std::unique_lock<std::mutex> lock(m);
+        bool ok = cv.wait_for(lock, std::chrono::seconds(5), [&]() { return removed == 2; });
+        assert(ok);
+    }
+
+    n->notify(my_loop);
+    t.join();
+
+    // With no other thread polling, deregistration completes immediately:
+    n->deregister_async(my_loop);
+    my_fd_watcher fwatch2;
+    fwatch2.on_removed = on_removed;
+    fwatch2.add_watch(my_loop, pipe1[0], dasynq::IN_EVENTS);
+    fwatch2.deregister_async(my_loop);
+    assert(removed == 3);
+
+    close(pipe1[0]);
+    close(pipe1[1]);
+}
+
+// Traits for a loop with concurrent polling (if supported by the backend):
+class concurrent_poll_traits : public dasynq::default_traits<std::mutex>
+{
+    public:
+    constexpr static bool concurrent_polling = dasynq::loop_traits_t::supports_concurrent_polling;
+};
+
+// Test an event loop run by several threads which may poll concurrently: events are processed, and
+// watchers can be deregistered (synchronously and asynchronously) while threads are polling.
+void ftest_concurrent_polling()
+{
+    using Loop_t = dasynq::event_loop<std::mutex, concurrent_poll_traits>;
+    Loop_t my_loop;
+
+    const int num_threads = 3;
+    const int num_pipes = 4;
+    const int rounds = 50;
+
+    std::mutex m;
+    std::condition_variable cv;
+    int handled = 0;
+    int removed = 0;
+    bool done = false;
+
+    int pipes[num_pipes][2];
+    Loop_t::fd_watcher *watchers[num_pipes];
+    for (int i = 0; i < num_pipes; i++) {
+        create_pipe(pipes[i]);
+        watchers[i] = Loop_t::fd_watcher::add_watch(my_loop, pipes[i][0], dasynq::IN_EVENTS,
+                [&](Loop_t &eloop, int fd, int flags) -> rearm {
+                    char rbuf[1];
+                    read(fd, rbuf, 1);
+                    std::lock_guard<std::mutex> guard(m);
+                    handled++;
+                    cv.notify_all();
+                    return rearm::REARM;
+                });
+    }
+
+    // Once done, this pipe is left readable so that all threads return from run():
+    int stop_pipe[2];
+    create_pipe(stop_pipe);
+    auto swatch = Loop_t::fd_watcher::add_watch(my_loop, stop_pipe[0], dasynq::IN_EVENTS,
+            [](Loop_t &eloop, int fd, int flags) -> rearm {
+                return rearm::REARM;
+            });
+
+    auto run_loop = [&]() -> void {
+        while (true) {
+            {
+                std::lock_guard<std::mutex> guard(m);
+                if (done) break;
+            }
+            my_loop.run();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; i++) {
+        threads.emplace_back(run_loop);
+    }
+
+    char wbuf[1] = {'a'};
+    for (int i = 0; i < rounds; i++) {
+        for (int j = 0; j < num_pipes; j++) {
+            write(pipes[j][1], wbuf, 1);
+        }
+        std::unique_lock<std::mutex> lock(m);
+        cv.wait(lock, [&]() { return handled == (i + 1) * num_pipes; });
+    }
+
+    // Allow the threads to start waiting:
+    struct timespec t100ms;
+    t100ms.tv_sec = 0;
+    t100ms.tv_nsec = 100 * 1000 * 1000;
+    nanosleep(&t100ms, nullptr);
+
+    // Deregister while threads are polling:
+    watchers[0]->deregister(my_loop);
+
+    class my_fd_watcher : public Loop_t::fd_watcher_impl<my_fd_watcher>
+    {
+        public:
+        std::function<void()> on_removed;
+
+        rearm fd_event(Loop_t &eloop, int fd, int flags)
+        {
+            return rearm::REARM;
+        }
+
+        void watch_removed() noexcept override
+        {
+            on_removed();
+        }
+    };
+
+    my_fd_watcher awatch;
+    awatch.on_removed = [&]() {
+        std::lock_guard<std::mutex> guard(m);
+        removed++;
+        cv.notify_all();
+    };
+    awatch.add_watch(my_loop, pipes[0][0], dasynq::IN_EVENTS);
+    nanosleep(&t100ms, nullptr);
+    awatch.deregister_async(my_loop);
+
+    {
+        std::unique_lock<std::mutex> lock(m);
+        bool ok = cv.wait_for(lock, std::chrono::seconds(5), [&]() { return removed == 1; });
+        assert(ok);
+        done = true;
+    }
+
+    write(stop_pipe[1], wbuf, 1);
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    assert(handled == rounds * num_pipes);
+
+    swatch->deregister(my_loop);
+    for (int i = 1; i < num_pipes; i++) {
+        watchers[i]->deregister(my_loop);
+    }
+    for (int i = 0; i < num_pipes; i++) {
+        close(pipes[i][0]);
+        close(pipes[i][1]);
+    }
+    close(stop_pipe[0]);
+    close(stop_pipe[1]);
+}
+
+// Test asynchronous deregistration of watchers with pending events, repeatedly, while other threads
+// continuously poll: each deregistration must complete (once no polling thread can still receive an
+// event for the watcher), and must not prevent other events from being processed.
+void ftest_concurrent_dereg_async()
+{
+    using Loop_t = dasynq::event_loop<std::mutex, concurrent_poll_traits>;
+    Loop_t my_loop;
+
+    const int num_threads = 3;
+    const int num_watchers = 200;
+
+    std::mutex m;
+    std::condition_variable cv;
+    int handled = 0;
+    int removed = 0;
+    bool done = false;
+
+    class my_fd_watcher : public Loop_t::fd_watcher_impl<my_fd_watcher>
+    {
+        public:
+        std::function<void()> on_removed;
+
+        rearm fd_event(Loop_t &eloop, int fd, int flags)
+        {
+            return rearm::REARM;
+        }
+
+        void watch_removed() noexcept override
+        {
+            on_removed();
+        }
+    };
+
+    // A pipe which is kept readable throughout, so that the threads are continually polling:
+    int busy_pipe[2];
+    create_pipe(busy_pipe);
+    auto bwatch = Loop_t::fd_watcher::add_watch(my_loop, busy_pipe[0], dasynq::IN_EVENTS,
+            [&](Loop_t &eloop, int fd, int flags) -> rearm {
+                std::lock_guard<std::mutex> guard(m);
+                handled++;
+                return rearm::REARM;
+            });
+    char wbuf[1] = {'a'};
+    write(busy_pipe[1], wbuf, 1);
+
+    auto run_loop = [&]() -> void {
+        while (true) {
+            {
+                std::lock_guard<std::mutex> guard(m);
+                if (done) break;
+            }
+            my_loop.run();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; i++) {
+        threads.emplace_back(run_loop);
+    }
+
+    // A pipe which is readable, so that each watcher has an event pending when it is deregistered:
+    int ready_pipe[2];
+    create_pipe(ready_pipe);
+    write(ready_pipe[1], wbuf, 1);
+
+    std::vector<std::unique_ptr<my_fd_watcher>> watchers;
+    for (int i = 0; i < num_watchers; i++) {
+        watchers.emplace_back(new my_fd_watcher());
+        my_fd_watcher *w = watchers.back().get();
+        w->on_removed = [&]() {
+            std::lock_guard<std::mutex> guard(m);
+            removed++;
+            cv.notify_all();
+        };
+        w->add_watch(my_loop, ready_pipe[0], dasynq::IN_EVENTS);
+        w->deregister_async(my_loop);
+    }
+
+    int handled_before;
+    {
+        std::unique_lock<std::mutex> lock(m);
+        bool ok = cv.wait_for(lock, std::chrono::seconds(5), [&]() { return removed == num_watchers; });
+        assert(ok);
+        handled_before = handled;
+    }
+
+    // Events continue to be processed:
+    while (true) {
+        struct timespec t10ms;
+        t10ms.tv_sec = 0;
+        t10ms.tv_nsec = 10 * 1000 * 1000;
+        nanosleep(&t10ms, nullptr);
+        std::lock_guard<std::mutex> guard(m);
+        if (handled > handled_before) {
+            done = true;
+            break;
+        }
+    }
+
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    bwatch->deregister(my_loop);
+    close(busy_pipe[0]);
+    close(busy_pipe[1]);
+    close(ready_pipe[0]);
+    close(ready_pipe[1]);
+}
+
+class batch_traits : public dasynq::default_traits<checking_mutex>
+{
+    public:
+    constexpr static int dispatch_batch = 4;
+};
+
+// Test batched dispatch: events for each type of watcher are dispatched, watchers are re-armed or
+// removed according to the results of their callbacks, and the event limit is respected.
+void ftest_dispatch_batch()
+{
+    using Loop_t = dasynq::event_loop<checking_mutex, batch_traits>;
+    Loop_t my_loop;
+
+    class my_fd_watcher : public Loop_t::fd_watcher_impl<my_fd_watcher>
+    {
+        public:
+        int *total;
+        int count = 0;
+        int removed = 0;
+        bool remove_next = false;
+
+        rearm fd_event(Loop_t &eloop, int fd, int flags)
+        {
+            char rbuf[1];
+            read(fd, rbuf, 1);
+            count++;
+            (*total)++;
+            return remove_next ? rearm::REMOVE : rearm::REARM;
+        }
+
+        void watch_removed() noexcept override
+        {
+            removed++;
+        }
+    };
+
+    const int num_pipes = 6;
+    int pipes[num_pipes][2];
+    int total = 0;
+    my_fd_watcher watchers[num_pipes];
+    for (int i = 0; i < num_pipes; i++) {
+        create_pipe(pipes[i]);
+        watchers[i].total = &total;
+        watchers[i].add_watch(my_loop, pipes[i][0], dasynq::IN_EVENTS);
+    }
+
+    char wbuf[1] = {'a'};
+    auto write_all = [&]() {
+        for (int i = 0; i < num_pipes; i++) {
+            write(pipes[i][1], wbuf, 1);
+        }
+    };
+
+    write_all();
+    my_loop.run(3);
+    assert(total == 3);
+    my_loop.run();
+    assert(total == 6);
+    for (int i = 0; i < num_pipes; i++) {
+        assert(watchers[i].count == 1);
+    }
+
+    watchers[5].remove_next = true;
+    write_all();
+    while (total < 12) {
+        my_loop.run();
+    }
+    assert(watchers[5].removed == 1);
+
+    write_all();
+    while (total < 17) {
+        my_loop.run();
+    }
+    my_loop.poll();
+    assert(total == 17);
+    assert(watchers[5].count == 2);
+
+    // Other watcher types, including a bidirectional watcher (both halves ready):
+    class my_bidi_watcher : public Loop_t::bidi_fd_watcher_impl<my_bidi_watcher>
+    {
+        public:
+        bool in = false;
+        bool out = false;
+
+        rearm read_ready(Loop_t &eloop, int fd) noexcept
+        {
+            char rbuf[1];
+            read(fd, rbuf, 1);
+            in = true;
+            return rearm::REARM;
+        }
+
+        rearm write_ready(Loop_t &eloop, int fd) noexcept
+        {
+            out = true;
+            return rearm::DISARM;
+        }
+    };
+
+    int bidi_pipe[2];
+    create_bidi_pipe(bidi_pipe);
+    write(bidi_pipe[1], wbuf, 1);
+    my_bidi_watcher bwatch;
+    bwatch.add_watch(my_loop, bidi_pipe[0], dasynq::IN_EVENTS | dasynq::OUT_EVENTS);
+
+    bool timer_expired = false;
+    bool notified = false;
+    bool task_run = false;
+    auto *t = Loop_t::timer::add_timer(my_loop, dasynq::clock_type::MONOTONIC, true,
+            timespec {0, 1000000}, timespec {0, 0}, [&](Loop_t &eloop, int intervals) -> rearm {
+                timer_expired = true;
+                return rearm::REMOVE;
+            });
+    (void)t;
+    auto *n = Loop_t::notifier::add_watch(my_loop, [&](Loop_t &eloop) -> rearm {
+        notified = true;
+        return rearm::REARM;
+    });
+    n->notify(my_loop);
+    my_loop.post([&](Loop_t &eloop) { task_run = true; });
+
+    while (! (timer_expired && notified && task_run && bwatch.in && bwatch.out)) {
+        my_loop.run();
+    }
+
+    // A watcher deregistered by an earlier callback in the same batch is not dispatched; its removal
+    // is completed immediately, so that it can be deleted (this includes both halves of a
+    // bidirectional watcher):
+    class victim_watcher : public Loop_t::fd_watcher_impl<victim_watcher>
+    {
+        public:
+        bool ran = false;
+        bool removed = false;
+
+        rearm fd_event(Loop_t &eloop, int fd, int flags)
+        {
+            ran = true;
+            return rearm::REARM;
+        }
+
+        void watch_removed() noexcept override
+        {
+            removed = true;
+        }
+    };
+
+    class victim_bidi_watcher : public Loop_t::bidi_fd_watcher_impl<victim_bidi_watcher>
+    {
+        public:
+        bool ran = false;
+        bool removed = false;
+
+        rearm read_ready(Loop_t &eloop, int fd) noexcept
+        {
+            ran = true;
+            return rearm::REARM;
+        }
+
+        rearm write_ready(Loop_t &eloop, int fd) noexcept
+        {
+            ran = true;
+            return rearm::REARM;
+        }
+
+        void watch_removed() noexcept override
+        {
+            removed = true;
+        }
+    };
+
+    class killer_watcher : public Loop_t::fd_watcher_impl<killer_watcher>
+    {
+        public:
+        victim_watcher *victim;
+        victim_bidi_watcher *bidi_victim;
+        bool victims_ran = true;
+
+        rearm fd_event(Loop_t &eloop, int fd, int flags)
+        {
+            char rbuf[1];
+            read(fd, rbuf, 1);
+
+            victim->deregister(eloop);
+            assert(victim->removed);
+            victims_ran = victim->ran;
+            delete victim;
+
+            bidi_victim->deregister(eloop);
+            assert(bidi_victim->removed);
+            victims_ran = victims_ran || bidi_victim->ran;
+            delete bidi_victim;
+
+            return rearm::REMOVE;
+        }
+    };
+
+    int kpipe[2];
+    int vpipe[2];
+    int vbidi_pipe[2];
+    create_pipe(kpipe);
+    create_pipe(vpipe);
+    create_bidi_pipe(vbidi_pipe);
+    write(kpipe[1], wbuf, 1);
+    write(vpipe[1], wbuf, 1);
+    write(vbidi_pipe[1], wbuf, 1);
+
+    killer_watcher killer;
+    killer.victim = new victim_watcher();
+    killer.victim->add_watch(my_loop, vpipe[0], dasynq::IN_EVENTS);
+    killer.bidi_victim = new victim_bidi_watcher();
+    killer.bidi_victim->add_watch(my_loop, vbidi_pipe[0], dasynq::IN_EVENTS | dasynq::OUT_EVENTS);
+    killer.add_watch(my_loop, kpipe[0], dasynq::IN_EVENTS, true, dasynq::DEFAULT_PRIORITY - 10);
+
+    my_loop.run();
+    assert(! killer.victims_ran);
+    my_loop.poll();
+
+    close(kpipe[0]);
+    close(kpipe[1]);
+    close(vpipe[0]);
+    close(vpipe[1]);
+    close(vbidi_pipe[0]);
+    close(vbidi_pipe[1]);
+
+    bwatch.deregister(my_loop);
+    n->deregister(my_loop);
+    for (int i = 0; i < num_pipes - 1; i++) {
+        watchers[i].deregister(my_loop);
+    }
+    for (int i = 0; i < num_pipes; i++) {
+        close(pipes[i][0]);
+        close(pipes[i][1]);
+    }
+    close(bidi_pipe[0]);
+    close(bidi_pipe[1]);
+}
+
+// Allocator which counts allocations, for checking that the loop allocates its internal structures
+// using the allocator from the loop traits:
+static long counted_allocs = 0;
+static long counted_live = 0;
+
+template <typename T> class counting_allocator
+{
+    public:
+    using value_type = T;
+
+    counting_allocator() noexcept { }
+    template <typename U> counting_allocator(const counting_allocator<U> &) noexcept { }
+
+    T *allocate(std::size_t n)
+    {
+        counted_allocs++;
+        counted_live++;
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T *p, std::size_t n) noexcept
+    {
+        counted_live--;
+        std::allocator<T>().deallocate(p, n);
+    }
+
+    template <typename U> bool operator==(const counting_allocator<U> &) const noexcept { return true; }
+    template <typename U> bool operator!=(const counting_allocator<U> &) const noexcept { return false; }
+};
+
+class counting_alloc_traits : public dasynq::default_traits<std::mutex>
+{
+    public:
+    using allocator_t = counting_allocator<char>;
+
+    // (no posted task pool, which would reserve event queue storage when the loop is constructed):
+    constexpr static unsigned post_pool_size = 0;
+};
+
+class counting_pool_traits : public counting_alloc_traits
+{
+    public:
+    constexpr static unsigned post_pool_size = 8;
+};
+
+void ftest_loop_allocator()
+{
+    using Loop_t = dasynq::event_loop<std::mutex, counting_alloc_traits>;
+
+    class my_fd_watcher : public Loop_t::fd_watcher_impl<my_fd_watcher>
+    {
+        public:
+        rearm fd_event(Loop_t &eloop, int fd, int flags)
+        {
+            return rearm::DISARM;
+        }
+    };
+
+    class my_timer : public Loop_t::timer_impl<my_timer>
+    {
+        public:
+        rearm timer_expiry(Loop_t &eloop, int expiry_count)
+        {
+            return rearm::DISARM;
+        }
+    };
+
+    class my_child_watcher : public Loop_t::child_proc_watcher_impl<my_child_watcher>
+    {
+        public:
+        rearm status_change(Loop_t &eloop, pid_t child, int status)
+        {
+            return rearm::DISARM;
+        }
+    };
+
+    counted_allocs = 0;
+    counted_live = 0;
+
+    {
+        Loop_t my_loop;
+        long allocs = counted_allocs;
+
+        int pipefds[2];
+        pipe2(pipefds, O_NONBLOCK);
+
+        // Adding watchers allocates event queue, timer queue and child process map nodes:
+        my_fd_watcher fwatch;
+        fwatch.add_watch(my_loop, pipefds[0], dasynq::IN_EVENTS);
+        assert(counted_allocs > allocs);
+        allocs = counted_allocs;
+
+        my_timer timer1;
+        timer1.add_timer(my_loop);
+        assert(counted_allocs > allocs);
+        allocs = counted_allocs;
+
+        my_child_watcher cwatch;
+        cwatch.reserve_watch(my_loop);
+        assert(counted_allocs > allocs);
+
+        cwatch.unreserve(my_loop);
+        timer1.deregister(my_loop);
+        fwatch.deregister(my_loop);
+
+        close(pipefds[0]);
+        close(pipefds[1]);
+    }
+
+    assert(counted_live == 0);
+
+    // The posted task pool, and the event queue storage reserved for it, are allocated with the loop;
+    // posting and running as many tasks as the pool holds then doesn't allocate:
+    {
+        using Pool_loop_t = dasynq::event_loop<std::mutex, counting_pool_traits>;
+        long allocs = counted_allocs;
+        Pool_loop_t my_loop;
+        assert(counted_allocs > allocs);
+        allocs = counted_allocs;
+
+        int ran = 0;
+        for (unsigned i = 0; i < counting_pool_traits::post_pool_size; i++) {
+            my_loop.post([&ran](Pool_loop_t &eloop) { ran++; });
+        }
+        my_loop.run();
+        assert(ran == (int)counting_pool_traits::post_pool_size);
+        assert(counted_allocs == allocs);
+    }
+
+    assert(counted_live == 0);
+}
+
+#if DASYNQ_HAVE_PTHREAD_SETAFFINITY
+
+// Test that a loop constructed with a processor affinity restricts the constructing thread and the
+// threads that run it.
+void ftest_loop_affinity()
+{
+    using Loop_t = dasynq::event_loop_th;
+
+    cpu_set_t allowed;
+    int r = sched_getaffinity(0, sizeof(allowed), &allowed);
+    assert(r == 0);
+    unsigned first_cpu = 0;
+    while (! CPU_ISSET(first_cpu, &allowed)) first_cpu++;
+
+    // (Run in other threads, so as not to restrict the main thread):
+    std::unique_ptr<Loop_t> my_loop;
+    std::thread([&]() {
+        my_loop.reset(new Loop_t(dasynq::cpu_affinity::for_cpu(first_cpu)));
+        cpu_set_t cur;
+        int r = pthread_getaffinity_np(pthread_self(), sizeof(cur), &cur);
+        assert(r == 0 && CPU_COUNT(&cur) == 1 && CPU_ISSET(first_cpu, &cur));
+    }).join();
+
+    assert(my_loop->get_affinity().contains(first_cpu));
+
+    bool ran = false;
+    my_loop->post([&ran](Loop_t &eloop) {
+        ran = true;
+    });
+
+    std::thread([&]() {
+        my_loop->run();
+        cpu_set_t cur;
+        int r = pthread_getaffinity_np(pthread_self(), sizeof(cur), &cur);
+        assert(r == 0 && CPU_COUNT(&cur) == 1 && CPU_ISSET(first_cpu, &cur));
+    }).join();
+    assert(ran);
+    my_loop.reset();
+
+    // A default-constructed loop has no affinity:
+    Loop_t other_loop;
+    assert(other_loop.get_affinity().empty());
+
+    // NUMA node 0, if the system reports NUMA nodes, includes at least one processor:
+    try {
+        dasynq::cpu_affinity node0 = dasynq::cpu_affinity::for_numa_node(0);
+        assert(! node0.empty());
+    }
+    catch (std::system_error &e) {
+        assert(e.code().value() == ENOENT);
+    }
+}
+
+#endif
+
+// Test run_busy(): an event arriving while the thread spins is processed, as is one arriving after the
+// spin period (once the thread waits).
+void ftest_run_busy()
+{
+    using Loop_t = dasynq::event_loop_n;
+    using dasynq::time_val;
+    Loop_t my_loop;
+
+    class my_fd_watcher : public Loop_t::fd_watcher_impl<my_fd_watcher>
+    {
+        public:
+        int count = 0;
+
+        rearm fd_event(Loop_t &eloop, int fd, int flags)
+        {
+            char buf[1];
+            read(fd, buf, 1);
+            count++;
+            return rearm::REARM;
+        }
+    };
+
+    int pipefds[2];
+    pipe2(pipefds, O_NONBLOCK);
+    my_fd_watcher fwatch;
+    fwatch.add_watch(my_loop, pipefds[0], dasynq::IN_EVENTS);
+
+    auto write_after = [&](int usecs) {
+        return std::thread([&pipefds, usecs]() {
+            usleep(usecs);
+            char wbuf[1] = {'a'};
+            write(pipefds[1], wbuf, 1);
+        });
+    };
+
+    // Event arrives while spinning:
+    std::thread t1 = write_after(2000);
+    my_loop.run_busy(time_val(10, 0));
+    assert(fwatch.count == 1);
+    t1.join();
+
+    // Event arrives after spinning:
+    std::thread t2 = write_after(20000);
+    my_loop.run_busy(time_val(0, 1000000));
+    assert(fwatch.count == 2);
+    t2.join();
+
+    // Event already pending:
+    char wbuf[1] = {'a'};
+    write(pipefds[1], wbuf, 1);
+    my_loop.run_busy(time_val(0, 0));
+    assert(fwatch.count == 3);
+
+#if DASYNQ_HAVE_EPOLL && ! DASYNQ_HAVE_IO_URING
+    // Kernel busy polling may not be supported by the running kernel:
+    try {
+        my_loop.get_backend().set_busy_poll(50);
+        my_loop.get_backend().set_busy_poll(0);
+    }
+    catch (std::system_error &e) {
+        assert(e.code().value() == ENOTTY || e.code().value() == EPERM);
+    }
+#endif
+
+    fwatch.deregister(my_loop);
+    close(pipefds[0]);
+    close(pipefds[1]);
+}
+
+class single_prio_traits : public dasynq::default_traits<checking_mutex>
+{
+    public:
+    constexpr static bool single_priority = true;
+};
+
+// Test a loop with the single_priority trait: events are dispatched in the order queued, ignoring
+// watcher priorities, and queued watchers can be removed.
+void ftest_single_priority()
+{
+    using Loop_t = dasynq::event_loop<checking_mutex, single_prio_traits>;
+    Loop_t my_loop;
+
+    std::vector<int> order;
+    my_loop.post([&order](Loop_t &eloop) { order.push_back(1); }, 10);
+    my_loop.post([&order](Loop_t &eloop) { order.push_back(2); }, 5);
+    my_loop.post([&order](Loop_t &eloop) { order.push_back(3); }, 10);
+    my_loop.run();
+
+    assert(order.size() == 3);
+    assert(order[0] == 1);
+    assert(order[1] == 2);
+    assert(order[2] == 3);
+
+    class my_fd_watcher : public Loop_t::fd_watcher_impl<my_fd_watcher>
+    {
+        public:
+        int count = 0;
+
+        rearm fd_event(Loop_t &eloop, int fd, int flags)
+        {
+            char rbuf[1];
+            read(fd, rbuf, 1);
+            count++;
+            return rearm::REARM;
+        }
+    };
+
+    const int num_pipes = 6;
+    int pipes[num_pipes][2];
+    my_fd_watcher watchers[num_pipes];
+    for (int i = 0; i < num_pipes; i++) {
+        create_pipe(pipes[i]);
+        watchers[i].add_watch(my_loop, pipes[i][0], dasynq::IN_EVENTS, true, i * 10);
+    }
+
+    char wbuf[1] = {'a'};
+    for (int i = 0; i < num_pipes; i++) {
+        write(pipes[i][1], wbuf, 1);
+    }
+
+    // Process two events, then remove all but one of the watchers whose events remain queued:
+    my_loop.run(2);
+    int remaining = -1;
+    for (int i = 0; i < num_pipes; i++) {
+        if (watchers[i].count == 0) {
+            if (remaining == -1) {
+                remaining = i;
+            }
+            else {
+                watchers[i].deregister(my_loop);
+            }
+        }
+    }
+    assert(remaining != -1);
+
+    my_loop.run();
+    my_loop.poll();
+    assert(watchers[remaining].count == 1);
+
+    int total = 0;
+    for (int i = 0; i < num_pipes; i++) {
+        total += watchers[i].count;
+    }
+    assert(total == 3);
+
+    for (int i = 0; i < num_pipes; i++) {
+        if (i == remaining || watchers[i].count != 0) {
+            watchers[i].deregister(my_loop);
+        }
+        close(pipes[i][0]);
+        close(pipes[i][1]);
+    }
+}
+
+void ftest_post()
+{
+    using Loop_t = dasynq::event_loop<std::mutex>;
+
+    {
+        Loop_t my_loop;
+        std::vector<int> order;
+
+        my_loop.post([&order](Loop_t &eloop) { order.push_back(1); }, 10);
+        my_loop.post([&order](Loop_t &eloop) { order.push_back(2); }, 5);
+        my_loop.post([&order](Loop_t &eloop) { order.push_back(3); }, 10);
+        my_loop.run();
+
+        assert(order.size() == 3);
+        assert(order[0] == 2);
+        assert(order[1] == 1);
+        assert(order[2] == 3);
+
+        // Post from another thread wakes the loop:
+        std::thread t([&my_loop]() -> void {
+            my_loop.run();
+        });
+
+        my_loop.post([&order](Loop_t &eloop) { order.push_back(4); });
+        t.join();
+        assert(order.size() == 4);
+        assert(order[3] == 4);
+
+        // A task not run before the loop is destroyed is deleted:
+        my_loop.post([&order](Loop_t &eloop) { order.push_back(5); });
+    }
+
+    // More tasks than the pool holds, and tasks too large for the pool, are allocated individually;
+    // all are run in order, and the callables of tasks not run are destroyed with the loop:
+    auto tracker = std::make_shared<int>(0);
+    {
+        Loop_t my_loop;
+        std::vector<int> order;
+        constexpr int num_tasks = dasynq::default_traits<std::mutex>::post_pool_size * 2 + 5;
+        char big[dasynq::default_traits<std::mutex>::post_inline_size + 16] = {};
+
+        for (int round = 0; round < 2; round++) {
+            order.clear();
+            for (int i = 0; i < num_tasks; i++) {
+                if (i % 7 == 3) {
+                    my_loop.post([&order, i, big](Loop_t &eloop) { order.push_back(i + big[0]); });
+                }
+                else {
+                    my_loop.post([&order, i, tracker](Loop_t &eloop) { order.push_back(i); });
+                }
+            }
+            my_loop.run();
+            assert(order.size() == (size_t)num_tasks);
+            for (int i = 0; i < num_tasks; i++) {
+                assert(order[i] == i);
+            }
+            assert(tracker.use_count() == 1);
+        }
+
+        for (int i = 0; i < num_tasks; i++) {
+            my_loop.post([tracker](Loop_t &eloop) { });
+        }
+        assert(tracker.use_count() == num_tasks + 1);
+    }
+    assert(tracker.use_count() == 1);
+}
+
+// Test that an interrupt raised from another thread while the loop is clearing its interrupt channel
+// is not lost. A task is posted and, after a short random delay, a notifier is notified; each
+// raises an interrupt of its own (the post and notify lists are separate), so the second may land
+// while the loop is handling the first. If the pending flag were left set with no wakeup queued,
+// no later interrupt would wake the loop, and the next round would not complete.
+void ftest_interrupt_race()
+{
+    using Loop_t = dasynq::event_loop<std::mutex>;
+    Loop_t my_loop;
+
+    std::atomic<int> posts_run {0};
+    std::atomic<int> notifies_seen {0};
+    std::atomic<bool> stop {false};
+
+    auto *n = Loop_t::notifier::add_watch(my_loop, [&notifies_seen](Loop_t &eloop) -> rearm {
+        notifies_seen++;
+        return rearm::REARM;
+    });
+
+    std::thread t([&my_loop, &stop]() -> void {
+#ifdef SCHED_IDLE
+        // With a single CPU, let the interrupting thread preempt the loop at any point:
+        sched_param param = {};
+        pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+        while (! stop.load()) {
+            my_loop.run();
+        }
+    });
+
+    unsigned rnd = 1;
+    for (int i = 1; i <= 1000; i++) {
+        my_loop.post([&posts_run](Loop_t &eloop) { posts_run++; });
+        rnd = rnd * 1103515245u + 12345u;
+        std::this_thread::sleep_for(std::chrono::nanoseconds((rnd >> 8) % 30000));
+        n->notify(my_loop);
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while (posts_run.load() < i || notifies_seen.load() < i) {
+            assert(std::chrono::steady_clock::now() < deadline);
+            std::this_thread::sleep_for(std::chrono::microseconds(1));
+        }
+    }
+
+    stop = true;
+    my_loop.post([](Loop_t &eloop) { });
+    t.join();
+
+    n->deregister(my_loop);
+}
+
+void ftest_cached_time()
+{
+    using dasynq::time_val;
+    using dasynq::clock_type;
+    using Loop_t = dasynq::event_loop_n;
+    Loop_t my_loop;
+
+    // While processing events, the clock is read only once:
+    bool ran = false;
+    my_loop.post([&ran](Loop_t &eloop) {
+        time_val t1, t2, t3;
+        eloop.get_time(t1, clock_type::MONOTONIC);
+        usleep(2000);
+        eloop.get_time(t2, clock_type::MONOTONIC);
+        assert(t1 == t2);
+        eloop.get_time(t3, clock_type::MONOTONIC, true);
+        assert(t1 < t3);
+        eloop.get_time(t2, clock_type::MONOTONIC);
+        assert(t2 == t3);
+        ran = true;
+    });
+    my_loop.run();
+    assert(ran);
+
+    // Outside of event processing, the time is not cached:
+    time_val t1, t2;
+    my_loop.get_time(t1, clock_type::MONOTONIC);
+    usleep(2000);
+    my_loop.get_time(t2, clock_type::MONOTONIC);
+    assert(t1 < t2);
+}
+
+void ftest_child_watch()
+{
+    using loop_t = dasynq::event_loop<std::mutex>;
+    loop_t my_loop;
+
+    class my_child_proc_watcher : public loop_t::child_proc_watcher_impl<my_child_proc_watcher>
+    {
+        public:
+        bool did_exit = false;
+
+        rearm status_change(loop_t &, pid_t child, int status)
+        {
+            did_exit = true;
+            return rearm::DISARM;
+        }
+    };
+
+    pid_t child_pid;
+    my_child_proc_watcher my_child_watcher;
 
     if ((child_pid = my_child_watcher.fork(my_loop, false)) == 0) {
         // child
@@ -1542,6 +3785,38 @@ int main(int argc, char **argv)
     test_timers_1();
     std::cout << "PASSED" << std::endl;
 
+    std::cout << "test_timer_wheel... ";
+    test_timer_wheel();
+    std::cout << "PASSED" << std::endl;
+
+    std::cout << "test_compact_stable_heap... ";
+    test_compact_stable_heap();
+    std::cout << "PASSED" << std::endl;
+
+    std::cout << "test_soa_dary_heap... ";
+    test_soa_dary_heap();
+    std::cout << "PASSED" << std::endl;
+
+    std::cout << "test_dary_heap... ";
+    test_dary_heap();
+    std::cout << "PASSED" << std::endl;
+
+    std::cout << "test_bucket_queue... ";
+    test_bucket_queue();
+    std::cout << "PASSED" << std::endl;
+
+    std::cout << "test_fifo_queue... ";
+    test_fifo_queue();
+    std::cout << "PASSED" << std::endl;
+
+    std::cout << "test_timers_wheel... ";
+    test_timers_wheel();
+    std::cout << "PASSED" << std::endl;
+
+    std::cout << "test_timer_slack... ";
+    test_timer_slack();
+    std::cout << "PASSED" << std::endl;
+
     std::cout << "test_timers_2... ";
     test_timers_2();
     std::cout << "PASSED" << std::endl;
@@ -1558,6 +3833,26 @@ int main(int argc, char **argv)
     ftest_fd_watch1();
     std::cout << "PASSED" << std::endl;
 
+    std::cout << "ftest_fd_watch2... ";
+    ftest_fd_watch2();
+    std::cout << "PASSED" << std::endl;
+
+    std::cout << "ftest_fd_watch_relink... ";
+    ftest_fd_watch_relink();
+    std::cout << "PASSED" << std::endl;
+
+    std::cout << "ftest_fd_watch3... ";
+    ftest_fd_watch3();
+    std::cout << "PASSED" << std::endl;
+
+    std::cout << "ftest_fd_watch_fixed_batch... ";
+    ftest_fd_watch_fixed_batch();
+    std::cout << "PASSED" << std::endl;
+
+    std::cout << "ftest_fd_watch_edge... ";
+    ftest_fd_watch_edge();
+    std::cout << "PASSED" << std::endl;
+
     std::cout << "ftest_bidi_fd_watch1... ";
     ftest_bidi_fd_watch1();
     std::cout << "PASSED" << std::endl;
@@ -1594,6 +3889,14 @@ int main(int argc, char **argv)
     ftest_timers3();
     std::cout << "PASSED" << std::endl;
 
+    std::cout << "ftest_timers_wheel... ";
+    ftest_timers_wheel();
+    std::cout << "PASSED" << std::endl;
+
+    std::cout << "ftest_timer_slack... ";
+    ftest_timer_slack();
+    std::cout << "PASSED" << std::endl;
+
     std::cout << "ftest_multi_thread1... ";
     ftest_multi_thread1();
     std::cout << "PASSED" << std::endl;
@@ -1610,6 +3913,76 @@ int main(int argc, char **argv)
     ftest_multi_thread4();
     std::cout << "PASSED" << std::endl;
 
+    std::cout << "ftest_parallel_dispatch... ";
+    ftest_parallel_dispatch();
+    std::cout << "PASSED" << std::endl;
+
+    std::cout << "test_adaptive_mutex... ";
+    test_adaptive_mutex();
+    std::cout << "PASSED" << std::endl;
+
+    std::cout << "test_waitqueue_handoff... ";
+    test_waitqueue_handoff();
+    std::cout << "PASSED" << std::endl;
+
+    std::cout << "ftest_parallel_dispatch (adaptive_mutex)... ";
+    ftest_parallel_dispatch<dasynq::adaptive_mutex>();
+    std::cout << "PASSED" << std::endl;
+
+    std::cout << "ftest_loop_group... ";
+    ftest_loop_group();
+    std::cout << "PASSED" << std::endl;
+
+    std::cout << "ftest_notifier... ";
+    ftest_notifier();
+    std::cout << "PASSED" << std::endl;
+
+    std::cout << "ftest_deregister_async... ";
+    ftest_deregister_async();
+    std::cout << "PASSED" << std::endl;
+
+    std::cout << "ftest_concurrent_polling... ";
+    ftest_concurrent_polling();
+    std::cout << "PASSED" << std::endl;
+
+    std::cout << "ftest_concurrent_dereg_async... ";
+    ftest_concurrent_dereg_async();
+    std::cout << "PASSED" << std::endl;
+
+    std::cout << "ftest_dispatch_batch... ";
+    ftest_dispatch_batch();
+    std::cout << "PASSED" << std::endl;
+
+    std::cout << "ftest_loop_allocator... ";
+    ftest_loop_allocator();
+    std::cout << "PASSED" << std::endl;
+
+#if DASYNQ_HAVE_PTHREAD_SETAFFINITY
+    std::cout << "ftest_loop_affinity... ";
+    ftest_loop_affinity();
+    std::cout << "PASSED" << std::endl;
+#endif
+
+    std::cout << "ftest_run_busy... ";
+    ftest_run_busy();
+    std::cout << "PASSED" << std::endl;
+
+    std::cout << "ftest_single_priority... ";
+    ftest_single_priority();
+    std::cout << "PASSED" << std::endl;
+
+    std::cout << "ftest_post... ";
+    ftest_post();
+    std::cout << "PASSED" << std::endl;
+
+    std::cout << "ftest_interrupt_race... ";
+    ftest_interrupt_race();
+    std::cout << "PASSED" << std::endl;
+
+    std::cout << "ftest_cached_time... ";
+    ftest_cached_time();
+    std::cout << "PASSED" << std::endl;
+
     std::cout << "ftest_child_watch... ";
     ftest_child_watch();
     std::cout << "PASSED" << std::endl;
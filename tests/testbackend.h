@@ -108,6 +108,9 @@ class test_loop_traits
     
     constexpr static bool has_separate_rw_fd_watches = false;
     constexpr static bool interrupt_after_fd_add = false;
+    constexpr static bool supports_non_oneshot_fd = false;
+    constexpr static bool supports_concurrent_polling = false;
+    constexpr static bool supports_edge_triggered = false;
     
     class fd_r;
 
@@ -254,16 +257,8 @@ template <class Base> class test_loop : public timer_base<Base>, io_receiver
         ts.expiry_count = 0;
         ts.enabled = enable;
 
-        if (timer_queue.is_queued(timer_id)) {
-            // Already queued; alter timeout
-            if (timer_queue.set_priority(timer_id, timeout)) {
-                // set_timer_from_queue();
-            }
-        }
-        else {
-            if (timer_queue.insert(timer_id, timeout)) {
-                // set_timer_from_queue();
-            }
+        if (this->queue_timer_nolock(timer_queue, timer_id, timeout)) {
+            // set_timer_from_queue();
         }
     }
 